@@ -19,11 +19,14 @@
 
 #include "util/Config.hh"
 #include "util/ProgressBar.hh"
+#include "util/Watcher.hh"
 
 #include "base/Drive.hh"
 #include "drive2/Syncer2.hh"
 
 #include "http/CurlAgent.hh"
+#include "http/CurlMultiAgent.hh"
+#include "http/CurlShare.hh"
 #include "protocol/AuthAgent.hh"
 #include "protocol/OAuth2.hh"
 #include "json/Val.hh"
@@ -35,20 +38,27 @@
 #include "util/log/DefaultLog.hh"
 
 // boost header
+#include <boost/bind.hpp>
 #include <boost/exception/all.hpp>
 #include <boost/program_options.hpp>
 
 // initializing libgcrypt, must be done in executable
 #include <gcrypt.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
+#include <set>
 #include <unistd.h>
 
 const std::string default_id            = APP_ID ;
 const std::string default_secret        = APP_SECRET ;
 
+// in daemon mode, files are synced once they haven't changed for this long
+const unsigned quiet_ms = 2000 ;
+const unsigned default_poll_secs = 60 ;
+
 using namespace gr ;
 namespace po = boost::program_options;
 
@@ -101,6 +111,67 @@ void InitLog( const po::variables_map& vm )
 	LogBase::Inst( comp_log.release() ) ;
 }
 
+// downloads split into ranges need an agent with an event loop to transfer them in parallel
+http::Agent* NewAgent( unsigned ranges, http::CurlShare *share )
+{
+	if ( ranges > 1 )
+		return new http::CurlMultiAgent( share ) ;
+	return new http::CurlAgent( share ) ;
+}
+
+void Sync( Drive& drive, ProgressBar *pb )
+{
+	// The progress bar should just be enabled when actual file transfers take place
+	if ( pb )
+		pb->setShowProgressBar( true ) ;
+	drive.Update() ;
+	if ( pb )
+		pb->setShowProgressBar( false ) ;
+
+	drive.SaveState() ;
+}
+
+// Keeps the tree and the index in memory and syncs again whenever something
+// changes: local directories are watched, and the changes feed is checked
+// every poll_secs. Only the directories which changed are read again.
+void Listen( Drive& drive, const fs::path& root, ProgressBar *pb, unsigned poll_secs )
+{
+	// started first, so that nothing changed during the first sync is missed
+	Watcher watcher( root, boost::bind( &Drive::IsIgnored, &drive, _1 ) ) ;
+
+	// everything may have changed since the last run
+	std::set<std::string> dirty ;
+	dirty.insert( "" ) ;
+	while ( true )
+	{
+		try
+		{
+			if ( drive.DetectChanges( dirty ) )
+			{
+				Sync( drive, pb ) ;
+				Log( "Finished! Waiting for changes", log::info ) ;
+			}
+			dirty.clear() ;
+		}
+		catch ( Exception& e )
+		{
+			// most likely the network. the changes are tried again later
+			Log( "sync failed: %1%", boost::diagnostic_information(e), log::error ) ;
+		}
+		catch ( std::exception& e )
+		{
+			// e.g. a file which can't be read or written
+			Log( "sync failed: %1%", e.what(), log::error ) ;
+		}
+
+		// the changes made during the sync are mostly the downloads of the sync
+		// itself. their directories are read again with the next changes, or
+		// after poll_secs at the latest, but they don't start a sync on their own
+		watcher.Drain( dirty ) ;
+		watcher.Wait( dirty, poll_secs * 1000, quiet_ms ) ;
+	}
+}
+
 int Main( int argc, char **argv )
 {
 	InitGCrypt() ;
@@ -130,6 +201,12 @@ int Main( int argc, char **argv )
 		( "upload-speed,U", po::value<unsigned>(), "Limit upload speed in kbytes per second" )
 		( "download-speed,D", po::value<unsigned>(), "Limit download speed in kbytes per second" )
 		( "progress-bar,P", "Enable progress bar for upload/download of files")
+		( "jobs,j", po::value<unsigned>(), "Number of files to upload/download in parallel" )
+		( "download-ranges", po::value<unsigned>(), "Split downloads of large files into this many ranges "
+						"transferred in parallel" )
+		( "daemon",		"Keep running and sync again whenever files change locally or in Google Drive" )
+		( "poll-interval", po::value<unsigned>(), "In daemon mode, check Google Drive for changes "
+						"every this many seconds (default 60)" )
 	;
 	
 	po::variables_map vm;
@@ -164,7 +241,14 @@ int Main( int argc, char **argv )
 	
 	Log( "config file name %1%", config.Filename(), log::verbose );
 
-	std::unique_ptr<http::Agent> http( new http::CurlAgent );
+	// ranges of a download are transferred in parallel by the event loop of CurlMultiAgent
+	unsigned ranges = vm.count( "download-ranges" ) > 0 ? std::max( vm["download-ranges"].as<unsigned>(), 1u ) : 1 ;
+
+	// all agents share DNS and TLS sessions, so that a new connection of one of
+	// them resumes the TLS session of another. It must outlive them.
+	http::CurlShare share ;
+
+	std::unique_ptr<http::Agent> http( NewAgent( ranges, &share ) );
 	if ( vm.count( "log-http" ) )
 		http->SetLog( new http::ResponseLog( vm["log-http"].as<std::string>(), ".txt" ) );
 
@@ -230,29 +314,58 @@ int Main( int argc, char **argv )
 		return -1;
 	}
 
-	OAuth2 token( http.get(), refresh_token, id, secret ) ;
+	unsigned jobs = vm.count( "jobs" ) > 0 ? std::max( vm["jobs"].as<unsigned>(), 1u ) : 1 ;
+
+	// curl handles can't be shared between threads, so with parallel jobs the token
+	// is refreshed through a connection of its own. So it is with ranges, as the
+	// token may need to be refreshed from within the event loop.
+	std::unique_ptr<http::Agent> token_http( jobs > 1 || ranges > 1 ? new http::CurlAgent( &share ) : NULL );
+	OAuth2 token( token_http ? token_http.get() : http.get(), refresh_token, id, secret ) ;
 	AuthAgent agent( token, http.get() ) ;
 	v2::Syncer2 syncer( &agent );
+	syncer.SetDownloadRanges( ranges );
+
+	// each transfer worker has its own connection and syncer
+	std::vector< std::shared_ptr<http::Agent> > worker_agents ;
+	std::vector< std::shared_ptr<Syncer> > worker_syncers ;
+	std::vector<Syncer*> workers ;
+	for ( unsigned i = 0 ; jobs > 1 && i < jobs ; i++ )
+	{
+		worker_agents.push_back( std::shared_ptr<http::Agent>( NewAgent( ranges, &share ) ) ) ;
+		worker_agents.push_back( std::shared_ptr<http::Agent>( new AuthAgent( token, worker_agents.back().get() ) ) ) ;
+		worker_syncers.push_back( std::shared_ptr<Syncer>( new v2::Syncer2( worker_agents.back().get() ) ) ) ;
+		worker_syncers.back()->SetDownloadRanges( ranges ) ;
+		workers.push_back( worker_syncers.back().get() ) ;
+	}
 
 	if ( vm.count( "upload-speed" ) > 0 )
+	{
 		agent.SetUploadSpeed( vm["upload-speed"].as<unsigned>() * 1000 );
+		for ( unsigned i = 0 ; i < workers.size() ; i++ )
+			workers[i]->Agent()->SetUploadSpeed( vm["upload-speed"].as<unsigned>() * 1000 );
+	}
 	if ( vm.count( "download-speed" ) > 0 )
+	{
 		agent.SetDownloadSpeed( vm["download-speed"].as<unsigned>() * 1000 );
+		for ( unsigned i = 0 ; i < workers.size() ; i++ )
+			workers[i]->Agent()->SetDownloadSpeed( vm["download-speed"].as<unsigned>() * 1000 );
+	}
 
-	Drive drive( &syncer, config.GetAll() ) ;
-	drive.DetectChanges() ;
+	Drive drive( &syncer, config.GetAll(), workers ) ;
 
-	if ( vm.count( "dry-run" ) == 0 )
+	if ( vm.count( "daemon" ) > 0 && vm.count( "dry-run" ) == 0 )
 	{
-		// The progress bar should just be enabled when actual file transfers take place
-		if ( pb )
-			pb->setShowProgressBar( true ) ;
-		drive.Update() ;
-		if ( pb )
-			pb->setShowProgressBar( false ) ;
-
-		drive.SaveState() ;
+		unsigned poll_secs = vm.count( "poll-interval" ) > 0 ?
+			std::max( vm["poll-interval"].as<unsigned>(), 1u ) : default_poll_secs ;
+
+		config.Save() ;
+		Listen( drive, config.GetAll()["path"].Str(), pb.get(), poll_secs ) ;
 	}
+
+	drive.DetectChanges() ;
+
+	if ( vm.count( "dry-run" ) == 0 )
+		Sync( drive, pb.get() ) ;
 	else
 		drive.DryRun() ;
 		
@@ -21,9 +21,12 @@
 
 #include "Entry.hh"
 #include "Feed.hh"
+#include "FeedPrefetcher.hh"
 #include "Syncer.hh"
+#include "TransferPool.hh"
 
 #include "http/Agent.hh"
+#include "http/Error.hh"
 #include "util/Destroy.hh"
 #include "util/log/Log.hh"
 
@@ -41,28 +44,19 @@
 
 namespace gr {
 
-Drive::Drive( Syncer *syncer, const Val& options ) :
+Drive::Drive( Syncer *syncer, const Val& options, const std::vector<Syncer*>& workers ) :
 	m_syncer	( syncer ),
+	m_workers	( workers ),
 	m_root		( options["path"].Str() ),
 	m_state		( m_root, options ),
-	m_options	( options )
+	m_options	( options ),
+	m_next_cstamp	( -1 )
 {
 	assert( m_syncer ) ;
-}
-
-void Drive::FromRemote( const Entry& entry )
-{
-	m_state.FromRemote( entry ) ;
-}
 
-void Drive::FromChange( const Entry& entry )
-{
-	if ( entry.IsRemoved() )
-		Log( "file \"%1%\" represents a deletion, ignored", entry.Title(), log::verbose ) ;
-	
-	// folders go directly
-	else
-		m_state.FromRemote( entry ) ;
+	m_syncer->SetUploadSessions( m_state.Uploads() ) ;
+	for ( std::vector<Syncer*>::iterator i = m_workers.begin() ; i != m_workers.end() ; ++i )
+		(*i)->SetUploadSessions( m_state.Uploads() ) ;
 }
 
 void Drive::SaveState()
@@ -75,41 +69,108 @@ void Drive::DetectChanges()
 	Log( "Reading local directories", log::info ) ;
 	m_state.FromLocal( m_root ) ;
 
+	// remember the change stamp before reading anything: changes made from now on,
+	// including the ones made by this sync, will be read by the next sync
+	m_next_cstamp = m_syncer->GetChangeStamp( -1 ) ;
+
+	ReadRemote() ;
+}
+
+/// Same as DetectChanges(), for syncing again with the same Drive. Only the local
+/// directories in \a dirty, e.g. the ones reported by Watcher, are read again.
+/// Returns false if nothing changed since the last sync, on either side.
+bool Drive::DetectChanges( const std::set<std::string>& dirty )
+{
+	long cstamp = m_syncer->GetChangeStamp( -1 ) ;
+	if ( dirty.empty() && cstamp == m_state.ChangeStamp() )
+		return false ;
+
+	Log( "Reading changed local directories", log::verbose ) ;
+	m_state.FromLocal( m_root, dirty ) ;
+	m_next_cstamp = cstamp ;
+
+	ReadRemote() ;
+	return true ;
+}
+
+/// Checks if changes to \a path, relative to the root, are ignored by the sync.
+bool Drive::IsIgnored( const std::string& path )
+{
+	return m_state.IsIgnore( path ) ;
+}
+
+void Drive::ReadRemote()
+{
+	if ( !ReadChanges() )
+		ReadAll() ;
+
+	m_state.FromRemoteIndex() ;
+	m_state.ResolveEntry() ;
+}
+
+void Drive::ReadAll()
+{
 	Log( "Reading remote server file list", log::info ) ;
-	std::unique_ptr<Feed> feed = m_syncer->GetAll() ;
+	m_state.ClearRemote() ;
+
+	// the workers are idle until the sync, so their connections can read parts of
+	// the list at the same time
+	std::vector<http::Agent*> agents( 1, m_syncer->Agent() ) ;
+	for ( std::vector<Syncer*>::iterator i = m_workers.begin() ; i != m_workers.end() ; ++i )
+		agents.push_back( (*i)->Agent() ) ;
+
+	// the list only replaces the one in the state once it's complete
+	Val remote( Val::object_type ) ;
+	ReadFeeds( m_syncer->GetAllParts( agents.size() ), agents, remote ) ;
+	m_state.SetRemote( std::move( remote ) ) ;
+}
+
+/// Applies the entries of \a feeds to the file list \a remote, while the next pages
+/// are being requested.
+void Drive::ReadFeeds( std::vector< std::unique_ptr<Feed> > feeds, const std::vector<http::Agent*>& agents, Val& remote )
+{
+	FeedPrefetcher prefetcher( std::move( feeds ), agents ) ;
 
-	while ( feed->GetNext( m_syncer->Agent() ) )
+	Feed::Entries page ;
+	while ( prefetcher.GetNext( page ) )
 	{
 		std::for_each(
-			feed->begin(), feed->end(),
-			boost::bind( &Drive::FromRemote, this, _1 ) ) ;
+			page.begin(), page.end(),
+			boost::bind( &State::UpdateRemote, boost::ref( remote ), _1 ) ) ;
 	}
-	m_state.ResolveEntry() ;
 }
 
-// pull the changes feed
-// FIXME: unused until Grive will use the feed-based sync instead of reading full tree
-void Drive::ReadChanges()
+/// Apply the changes feed since the last sync to the remote file list saved in the
+/// state. Returns false if there is nothing to apply them to, or if the server can't
+/// give us the changes any more, i.e. when a full listing is needed.
+bool Drive::ReadChanges()
 {
 	long prev_stamp = m_state.ChangeStamp() ;
-	if ( prev_stamp != -1 )
+	if ( prev_stamp == -1 || !m_state.HasRemote() )
+		return false ;
+
+	Trace( "previous change stamp is %1%", prev_stamp ) ;
+	Log( "Detecting changes from last sync", log::info ) ;
+	try
+	{
+		// changes must be applied in order, so there is only one feed
+		std::vector< std::unique_ptr<Feed> > feeds ;
+		feeds.push_back( m_syncer->GetChanges( prev_stamp+1 ) ) ;
+		ReadFeeds( std::move( feeds ), std::vector<http::Agent*>( 1, m_syncer->Agent() ), m_state.Remote() ) ;
+	}
+	catch ( http::Error& )
 	{
-		Trace( "previous change stamp is %1%", prev_stamp ) ;
-		Log( "Detecting changes from last sync", log::info ) ;
-		std::unique_ptr<Feed> feed = m_syncer->GetChanges( prev_stamp+1 ) ;
-		while ( feed->GetNext( m_syncer->Agent() ) )
-		{
-			std::for_each(
-				feed->begin(), feed->end(),
-				boost::bind( &Drive::FromChange, this, _1 ) ) ;
-		}
+		Log( "Cannot read changes since last sync, falling back to full listing", log::warning ) ;
+		return false ;
 	}
+	return true ;
 }
 
 void Drive::Update()
 {
 	Log( "Synchronizing files", log::info ) ;
-	m_state.Sync( m_syncer, m_options ) ;
+	TransferPool pool( m_workers ) ;
+	m_state.Sync( m_syncer, &pool, m_options ) ;
 	
 	UpdateChangeStamp( ) ;
 }
@@ -117,14 +178,14 @@ void Drive::Update()
 void Drive::DryRun()
 {
 	Log( "Synchronizing files (dry-run)", log::info ) ;
-	m_state.Sync( NULL, m_options ) ;
+	m_state.Sync( NULL, NULL, m_options ) ;
 }
 
 void Drive::UpdateChangeStamp( )
 {
-	// FIXME: we should go through the changes to see if it was really Grive to made that change
-	// maybe by recording the updated timestamp and compare it?
-	m_state.ChangeStamp( m_syncer->GetChangeStamp( m_state.ChangeStamp()+1 ) );
+	// our own changes are read back from the feed by the next sync. they match the
+	// local files, so they are simply found to be in sync.
+	m_state.ChangeStamp( m_next_cstamp );
 }
 
 } // end of namespace gr
@@ -24,11 +24,20 @@
 #include "json/Val.hh"
 #include "util/Exception.hh"
 
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 namespace gr {
 
+namespace http
+{
+	class Agent ;
+}
+
+class Feed ;
+
 class Syncer ;
 
 class Entry ;
@@ -38,9 +47,12 @@ class State ;
 class Drive
 {
 public :
-	Drive( Syncer *syncer, const Val& options ) ;
+	Drive( Syncer *syncer, const Val& options,
+		const std::vector<Syncer*>& workers = std::vector<Syncer*>() ) ;
 
 	void DetectChanges() ;
+	bool DetectChanges( const std::set<std::string>& dirty ) ;
+	bool IsIgnored( const std::string& path ) ;
 	void Update() ;
 	void DryRun() ;
 	void SaveState() ;
@@ -48,16 +60,19 @@ public :
 	struct Error : virtual Exception {} ;
 	
 private :
-	void ReadChanges() ;
-	void FromRemote( const Entry& entry ) ;
-	void FromChange( const Entry& entry ) ;
+	void ReadRemote() ;
+	void ReadAll() ;
+	bool ReadChanges() ;
+	void ReadFeeds( std::vector< std::unique_ptr<Feed> > feeds, const std::vector<http::Agent*>& agents, Val& remote ) ;
 	void UpdateChangeStamp( ) ;
 	
 private :
 	Syncer			*m_syncer ;
+	std::vector<Syncer*>	m_workers ;
 	fs::path		m_root ;
 	State			m_state ;
 	Val				m_options ;
+	long			m_next_cstamp ;
 } ;
 
 } // end of namespace gr
@@ -19,6 +19,7 @@
 
 #include "Entry.hh"
 
+#include "json/Val.hh"
 #include "util/Crypt.hh"
 #include "util/log/Log.hh"
 #include "util/OS.hh"
@@ -30,6 +31,19 @@
 
 namespace gr {
 
+namespace
+{
+	/// Returns the member \a key of \a index like Val::operator[], but with
+	/// Get(), so that a record still in a mapped state file is not decoded.
+	Val Member( const Val& index, const std::string& key )
+	{
+		Val v ;
+		if ( !index.Get( key, v ) )
+			BOOST_THROW_EXCEPTION( Val::Error() << Val::NoKey_( key ) ) ;
+		return v ;
+	}
+}
+
 /// construct an entry for the root folder
 Entry::Entry( ) :
 	m_title			( "." ),
@@ -41,6 +55,64 @@ Entry::Entry( ) :
 {
 }
 
+/// construct an entry from the record saved by Index(), i.e. the copy of a
+/// remote entry kept in the state file between syncs
+Entry::Entry( const Val& index ) :
+	m_title			( Member( index, "title" ).Str() ),
+	m_filename		( Member( index, "filename" ).Str() ),
+	m_is_dir		( Member( index, "dir" ).Bool() ),
+	m_resource_id	( Member( index, "id" ).Str() ),
+	m_self_href		( Member( index, "href" ).Str() ),
+	m_is_editable	( Member( index, "editable" ).Bool() ),
+	m_change_stamp	( -1 ),
+	m_mtime			( Member( index, "mtime" ).U64(), Member( index, "mtime_ns" ).U64() ),
+	m_is_removed	( false ),
+	m_size			( 0 )
+{
+	Val v ;
+	if ( index.Get( "etag", v ) )
+		m_etag = v.Str() ;
+	if ( index.Get( "md5", v ) )
+		m_md5 = v.Str() ;
+	if ( index.Get( "content", v ) )
+		m_content_src = v.Str() ;
+	if ( index.Get( "size", v ) )
+		m_size = v.U64() ;
+
+	const Val parents_val = Member( index, "parents" ) ;
+	const Val::Array& parents = parents_val.AsArray() ;
+	for ( Val::Array::const_iterator i = parents.begin() ; i != parents.end() ; ++i )
+		m_parent_hrefs.push_back( i->Str() ) ;
+}
+
+/// save the attributes needed to rebuild the entry without asking the server
+Val Entry::Index() const
+{
+	Val parents( Val::array_type ) ;
+	for ( std::vector<std::string>::const_iterator i = m_parent_hrefs.begin() ; i != m_parent_hrefs.end() ; ++i )
+		parents.Add( Val( *i ) ) ;
+
+	Val index ;
+	index.Add( "title",		Val( m_title ) ) ;
+	index.Add( "filename",	Val( m_filename ) ) ;
+	index.Add( "dir",		Val( m_is_dir ) ) ;
+	index.Add( "id",		Val( m_resource_id ) ) ;
+	index.Add( "href",		Val( m_self_href ) ) ;
+	index.Add( "editable",	Val( m_is_editable ) ) ;
+	index.Add( "mtime",		Val( m_mtime.Sec() ) ) ;
+	index.Add( "mtime_ns",	Val( m_mtime.NanoSec() ) ) ;
+	index.Add( "parents",	parents ) ;
+	if ( !m_etag.empty() )
+		index.Add( "etag",		Val( m_etag ) ) ;
+	if ( !m_is_dir )
+	{
+		index.Add( "md5",		Val( m_md5 ) ) ;
+		index.Add( "content",	Val( m_content_src ) ) ;
+		index.Add( "size",		Val( m_size ) ) ;
+	}
+	return index ;
+}
+
 const std::vector<std::string>& Entry::ParentHrefs() const
 {
 	return m_parent_hrefs ;
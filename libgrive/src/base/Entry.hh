@@ -29,6 +29,8 @@
 
 namespace gr {
 
+class Val ;
+
 /*!	\brief	corresponds to an "entry" in the resource feed
 
 	This class is decodes an entry in the resource feed. It will stored the properties like
@@ -39,6 +41,9 @@ class Entry
 {
 public :
 	Entry( ) ;
+	explicit Entry( const Val& index ) ;
+	
+	Val Index() const ;
 	
 	std::string Title() const ;
 	std::string Filename() const ;
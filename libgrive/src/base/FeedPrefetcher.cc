@@ -0,0 +1,134 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "FeedPrefetcher.hh"
+
+#include "util/log/Log.hh"
+
+#include <cassert>
+
+namespace gr {
+
+// pages received but not processed yet, at most
+const std::size_t max_prefetched_pages = 8 ;
+
+FeedPrefetcher::FeedPrefetcher( std::vector< std::unique_ptr<Feed> > feeds, const std::vector<http::Agent*>& agents ) :
+	m_feeds		( std::move( feeds ) ),
+	m_next_feed	( 0 ),
+	m_running	( 0 ),
+	m_stop		( false )
+{
+	assert( !agents.empty() ) ;
+
+	// more threads than feeds would have nothing to do
+	for ( std::size_t i = 0 ; i < agents.size() && i < m_feeds.size() ; i++ )
+	{
+		m_running++ ;
+		m_threads.push_back( std::thread( &FeedPrefetcher::Run, this, agents[i] ) ) ;
+	}
+}
+
+FeedPrefetcher::~FeedPrefetcher()
+{
+	Stop() ;
+}
+
+/// Waits for the next page of any of the feeds. Returns false when all of them
+/// are read. If reading a feed has failed, its error is thrown here.
+bool FeedPrefetcher::GetNext( Feed::Entries& entries )
+{
+	std::unique_lock<std::mutex> lock( m_mutex ) ;
+	while ( m_pages.empty() && !m_error && m_running > 0 )
+		m_ready.wait( lock ) ;
+
+	if ( m_pages.empty() )
+	{
+		if ( !m_error )
+			return false ;
+
+		// the pages read before the error are returned first
+		std::exception_ptr error = m_error ;
+		m_error = std::exception_ptr() ;
+		lock.unlock() ;
+		Stop() ;
+		std::rethrow_exception( error ) ;
+	}
+
+	entries.swap( m_pages.front() ) ;
+	m_pages.pop_front() ;
+	m_room.notify_one() ;
+	return true ;
+}
+
+void FeedPrefetcher::Run( http::Agent *agent )
+{
+	std::unique_lock<std::mutex> lock( m_mutex ) ;
+	while ( !m_stop && m_next_feed < m_feeds.size() )
+	{
+		Feed *feed = m_feeds[m_next_feed++].get() ;
+		lock.unlock() ;
+
+		try
+		{
+			while ( feed->GetNext( agent ) )
+			{
+				Feed::Entries page( feed->begin(), feed->end() ) ;
+
+				lock.lock() ;
+				while ( !m_stop && m_pages.size() >= max_prefetched_pages )
+					m_room.wait( lock ) ;
+				if ( m_stop )
+					break ;
+				m_pages.push_back( Feed::Entries() ) ;
+				m_pages.back().swap( page ) ;
+				m_ready.notify_one() ;
+				lock.unlock() ;
+			}
+			if ( !lock.owns_lock() )
+				lock.lock() ;
+		}
+		catch ( ... )
+		{
+			if ( !lock.owns_lock() )
+				lock.lock() ;
+			if ( !m_error )
+				m_error = std::current_exception() ;
+			m_stop = true ;
+			m_room.notify_all() ;
+		}
+	}
+	m_running-- ;
+	m_ready.notify_all() ;
+}
+
+void FeedPrefetcher::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		m_stop = true ;
+	}
+	m_room.notify_all() ;
+
+	for ( std::vector<std::thread>::iterator i = m_threads.begin() ; i != m_threads.end() ; ++i )
+		i->join() ;
+	m_threads.clear() ;
+}
+
+} // end of namespace gr
@@ -0,0 +1,77 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "base/Feed.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gr {
+
+namespace http
+{
+	class Agent ;
+}
+
+/*!	\brief	Reads feeds in background threads
+
+	There is a thread for each agent, which takes the next feed not being read yet,
+	and requests its pages one after another. Pages are kept in a queue until the
+	caller takes them with GetNext(), so the next page is already being requested
+	while the last one is processed.
+
+	The pages of a feed are returned in order, but the pages of different feeds may
+	be mixed. The agents must not be used by anything else until the prefetcher is
+	destroyed.
+*/
+class FeedPrefetcher
+{
+public :
+	FeedPrefetcher( std::vector< std::unique_ptr<Feed> > feeds, const std::vector<http::Agent*>& agents ) ;
+	~FeedPrefetcher() ;
+
+	bool GetNext( Feed::Entries& entries ) ;
+
+private :
+	void Run( http::Agent *agent ) ;
+	void Stop() ;
+
+private :
+	std::vector< std::unique_ptr<Feed> >	m_feeds ;
+	std::size_t								m_next_feed ;
+
+	std::vector<std::thread>	m_threads ;
+	std::mutex					m_mutex ;
+	std::condition_variable		m_ready ;
+	std::condition_variable		m_room ;
+	std::deque<Feed::Entries>	m_pages ;
+	std::size_t					m_running ;
+	bool						m_stop ;
+	std::exception_ptr			m_error ;
+} ;
+
+} // end of namespace gr
@@ -0,0 +1,252 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "HashCache.hh"
+
+#include "util/Crypt.hh"
+#include "json/Val.hh"
+
+#include <cstdlib>
+#include <sys/stat.h>
+
+namespace gr {
+
+// hashing is limited by the disk rather than the CPU, but several reads in
+// flight let the disk (and the kernel) schedule them
+const unsigned hash_threads = 4 ;
+
+HashCache::HashCache() :
+	m_hits		( 0 ),
+	m_misses	( 0 ),
+	m_stop		( false )
+{
+}
+
+HashCache::~HashCache()
+{
+	// checksums still in the queue are dropped, their futures are broken
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		m_stop = true ;
+	}
+	m_wake.notify_all() ;
+
+	for ( std::vector<std::thread>::iterator i = m_threads.begin() ; i != m_threads.end() ; ++i )
+		i->join() ;
+}
+
+/// The cache used by Resource::GetMD5(). It's loaded and saved by State.
+HashCache* HashCache::Inst()
+{
+	static HashCache inst ;
+	return &inst ;
+}
+
+void HashCache::Read( const Val& cache )
+{
+	if ( cache.Type() != Val::object_type )
+		return ;
+
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	const Val::Object& items = cache.AsObject() ;
+	for ( Val::Object::const_iterator i = items.begin() ; i != items.end() ; ++i )
+	{
+		// the key is "dev:inode"
+		std::size_t sep = i->first.find( ':' ) ;
+		if ( sep == std::string::npos )
+			continue ;
+
+		ID id( std::strtoull( i->first.c_str(), 0, 10 ), std::strtoull( i->first.c_str() + sep + 1, 0, 10 ) ) ;
+		Item& item	= m_items[id] ;
+		item.size	= i->second["size"].U64() ;
+		item.mtime	= DateTime( i->second["mtime"].U64(), i->second["mtime_ns"].U64() ) ;
+		item.md5	= i->second["md5"].Str() ;
+		item.used	= false ;
+	}
+}
+
+Val HashCache::Write() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Val cache( Val::object_type ) ;
+	for ( Map::const_iterator i = m_items.begin() ; i != m_items.end() ; ++i )
+	{
+		if ( !i->second.used )
+			continue ;
+
+		Val item( Val::object_type ) ;
+		item.Add( "size",		Val( i->second.size ) ) ;
+		item.Add( "mtime",		Val( i->second.mtime.Sec() ) ) ;
+		item.Add( "mtime_ns",	Val( i->second.mtime.NanoSec() ) ) ;
+		item.Add( "md5",		Val( i->second.md5 ) ) ;
+		cache.Add( std::to_string( i->first.first ) + ":" + std::to_string( i->first.second ), item ) ;
+	}
+	return cache ;
+}
+
+/// Returns the MD5 of the file, reading it only if the cache has no checksum for
+/// its current content. Returns an empty string if the file can't be read.
+std::string HashCache::Get( const fs::path& file )
+{
+	std::shared_future<std::string> pending ;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		Pending::iterator i = m_pending.find( file.string() ) ;
+		if ( i != m_pending.end() )
+		{
+			pending = i->second ;
+			m_pending.erase( i ) ;
+		}
+	}
+
+	return pending.valid() ? pending.get() : Compute( file ) ;
+}
+
+/// Queues the file to be hashed by the thread pool. The next Get() of the same
+/// path waits for the result.
+std::shared_future<std::string> HashCache::Async( const fs::path& file )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Pending::iterator i = m_pending.find( file.string() ) ;
+	if ( i != m_pending.end() )
+		return i->second ;
+
+	Job job ;
+	job.file	= file ;
+	job.result.reset( new std::promise<std::string> ) ;
+	std::shared_future<std::string> result = job.result->get_future().share() ;
+
+	m_pending[file.string()] = result ;
+	m_queue.push_back( job ) ;
+
+	if ( m_threads.empty() )
+	{
+		for ( unsigned n = 0 ; n < hash_threads ; n++ )
+			m_threads.push_back( std::thread( &HashCache::Run, this ) ) ;
+	}
+	m_wake.notify_one() ;
+
+	return result ;
+}
+
+/// Forgets the results of Async() which were never asked for with Get(). The
+/// files may be changed before the next Get().
+void HashCache::Discard()
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	m_pending.clear() ;
+}
+
+void HashCache::Run()
+{
+	std::unique_lock<std::mutex> lock( m_mutex ) ;
+	while ( true )
+	{
+		while ( !m_stop && m_queue.empty() )
+			m_wake.wait( lock ) ;
+
+		if ( m_stop )
+			break ;
+
+		Job job = m_queue.front() ;
+		m_queue.pop_front() ;
+		lock.unlock() ;
+
+		try
+		{
+			job.result->set_value( Compute( job.file ) ) ;
+		}
+		catch ( ... )
+		{
+			job.result->set_exception( std::current_exception() ) ;
+		}
+
+		lock.lock() ;
+	}
+}
+
+std::string HashCache::Compute( const fs::path& file )
+{
+	Key key ;
+	if ( !Stat( file, key ) )
+		return crypt::MD5::Get( file ) ;
+
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		Map::iterator i = m_items.find( ID( key.dev, key.ino ) ) ;
+		if ( i != m_items.end() && i->second.size == key.size && i->second.mtime == key.mtime )
+		{
+			m_hits++ ;
+			i->second.used = true ;
+			return i->second.md5 ;
+		}
+		m_misses++ ;
+	}
+
+	std::string md5 = crypt::MD5::Get( file ) ;
+
+	// don't remember the checksum if the file was written while it was read
+	Key after ;
+	if ( !md5.empty() && Stat( file, after ) &&
+		after.dev == key.dev && after.ino == key.ino && after.size == key.size && after.mtime == key.mtime )
+		Put( key, md5 ) ;
+
+	return md5 ;
+}
+
+void HashCache::Put( const Key& key, const std::string& md5 )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Item& item	= m_items[ID( key.dev, key.ino )] ;
+	item.size	= key.size ;
+	item.mtime	= key.mtime ;
+	item.md5	= md5 ;
+	item.used	= true ;
+}
+
+bool HashCache::Stat( const fs::path& file, Key& key )
+{
+	struct stat s ;
+	if ( ::stat( file.string().c_str(), &s ) != 0 || !S_ISREG( s.st_mode ) )
+		return false ;
+
+	key.dev		= s.st_dev ;
+	key.ino		= s.st_ino ;
+	key.size	= s.st_size ;
+#if defined __NetBSD__ || ( defined __APPLE__ && defined __DARWIN_64_BIT_INO_T )
+	key.mtime	= DateTime( s.st_mtimespec.tv_sec, s.st_mtimespec.tv_nsec ) ;
+#else
+	key.mtime	= DateTime( s.st_mtim.tv_sec, s.st_mtim.tv_nsec ) ;
+#endif
+	return true ;
+}
+
+u64_t HashCache::Hits() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	return m_hits ;
+}
+
+u64_t HashCache::Misses() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	return m_misses ;
+}
+
+} // end of namespace
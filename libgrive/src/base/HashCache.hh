@@ -0,0 +1,120 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "util/DateTime.hh"
+#include "util/FileSystem.hh"
+#include "util/Types.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gr {
+
+class Val ;
+
+/*!	\brief	MD5 checksums of local files which survive across runs
+
+	A checksum is reused for as long as the file has the same device, inode,
+	size and modification time, whatever its path. The ctime is deliberately
+	not part of the key: chmod, chown and backup tools change it without
+	touching the data, and renames are found by their inode.
+
+	The cache is saved in the state file. Only the entries of files seen by the
+	current run are saved, so the entries of deleted files don't accumulate.
+
+	Checksums which are known to be needed can be requested in advance with
+	Async(). They are computed by a pool of threads, so that many files are
+	read at the same time, and Get() waits for them instead of reading the
+	file again. All functions may be called from several threads.
+*/
+class HashCache
+{
+public :
+	struct Key
+	{
+		u64_t		dev ;
+		u64_t		ino ;
+		u64_t		size ;
+		DateTime	mtime ;
+	} ;
+
+public :
+	HashCache() ;
+	~HashCache() ;
+
+	static HashCache* Inst() ;
+
+	void Read( const Val& cache ) ;
+	Val Write() const ;
+
+	std::string Get( const fs::path& file ) ;
+	std::shared_future<std::string> Async( const fs::path& file ) ;
+	void Discard() ;
+	void Put( const Key& key, const std::string& md5 ) ;
+
+	static bool Stat( const fs::path& file, Key& key ) ;
+
+	u64_t Hits() const ;
+	u64_t Misses() const ;
+
+private :
+	struct Item
+	{
+		u64_t		size ;
+		DateTime	mtime ;
+		std::string	md5 ;
+		bool		used ;
+	} ;
+	typedef std::pair<u64_t, u64_t> ID ;
+	typedef std::map<ID, Item> Map ;
+
+	struct Job
+	{
+		fs::path									file ;
+		std::shared_ptr<std::promise<std::string> >	result ;
+	} ;
+	typedef std::map<std::string, std::shared_future<std::string> > Pending ;
+
+	std::string Compute( const fs::path& file ) ;
+	void Run() ;
+
+private :
+	mutable std::mutex	m_mutex ;
+	Map					m_items ;
+	u64_t				m_hits ;
+	u64_t				m_misses ;
+
+	std::deque<Job>				m_queue ;
+	Pending						m_pending ;
+	std::vector<std::thread>	m_threads ;
+	std::condition_variable		m_wake ;
+	bool						m_stop ;
+} ;
+
+} // end of namespace
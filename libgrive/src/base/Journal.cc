@@ -0,0 +1,123 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Journal.hh"
+
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "json/Val.hh"
+#include "util/log/Log.hh"
+
+#include <fstream>
+
+namespace gr {
+
+Journal::Journal( const fs::path& file ) :
+	m_file( file )
+{
+}
+
+Journal::~Journal()
+{
+}
+
+/// Apply the records of the journal to the state read from the state file.
+/// Returns the number of records applied.
+std::size_t Journal::Replay( Val& st ) const
+{
+	std::ifstream in( m_file.string().c_str() ) ;
+	std::size_t count = 0 ;
+	std::string line ;
+	while ( std::getline( in, line ) )
+	{
+		Val rec ;
+		try
+		{
+			rec = ParseJson( line ) ;
+		}
+		catch ( Exception& )
+		{
+			Log( "Ignoring incomplete record %1% of the state journal", count+1, log::warning ) ;
+			break ;
+		}
+
+		const Val::Array& path = rec["path"].AsArray() ;
+		if ( path.empty() )
+			continue ;
+
+		// the root entry is the state itself and its children are in "tree"
+		Val *folder = &st ;
+		for ( std::size_t i = 0 ; i + 1 < path.size() ; i++ )
+			folder = &folder->Item( "tree" ).Item( path[i].Str() ) ;
+		Val& tree = folder->Item( "tree" ) ;
+		std::string name = path.back().Str() ;
+
+		Val index ;
+		if ( rec.Get( "index", index ) )
+		{
+			// the children of a folder have records of their own
+			Val& entry = tree.Item( name ) ;
+			if ( index.Has( "tree" ) && entry.Has( "tree" ) )
+				index.Set( "tree", entry["tree"] ) ;
+			entry.Swap( index ) ;
+		}
+		else
+			tree.Del( name ) ;
+
+		count++ ;
+	}
+	return count ;
+}
+
+/// Append the index entry of the resource at \a path, relative to the root folder.
+/// \a index is NULL if the resource has been removed from the index.
+void Journal::Record( const fs::path& path, const Val *index )
+{
+	if ( !m_out.IsOpened() )
+		m_out.OpenForAppend( m_file ) ;
+
+	Val components( Val::array_type ) ;
+	for ( fs::path::iterator i = path.begin() ; i != path.end() ; ++i )
+		components.Add( Val( i->string() ) ) ;
+
+	Val rec ;
+	rec.Add( "path", components ) ;
+	if ( index )
+	{
+		// only record the attributes. the children of a folder are recorded separately
+		Val attr ;
+		const Val::Object& obj = index->AsObject() ;
+		for ( Val::Object::const_iterator i = obj.begin() ; i != obj.end() ; ++i )
+			attr.Add( i->first, i->first == "tree" ? Val() : i->second ) ;
+		rec.Add( "index", attr ) ;
+	}
+
+	// one write() per record, so a crash can only cut the last line short
+	std::string line = WriteJson( rec ) + "\n" ;
+	m_out.Write( line.c_str(), line.size() ) ;
+}
+
+/// Remove the journal, once all its records are saved in the state file.
+void Journal::Clear()
+{
+	m_out.Close() ;
+	fs::remove( m_file ) ;
+}
+
+} // end of namespace gr
@@ -0,0 +1,58 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "util/File.hh"
+#include "util/FileSystem.hh"
+
+#include <cstddef>
+
+namespace gr {
+
+class Val ;
+
+/*!	\brief	Append-only log of the changes to the state index
+
+	Every change made to the index entry of a resource while syncing is appended
+	to the journal right away. If grive is interrupted before the state file is
+	written, the next run replays the journal over the last state file, so the work
+	already done is not lost.
+
+	Each line of the journal holds one record in JSON: the path of the resource
+	and its new index entry, or no entry if it was removed from the index. A line
+	cut short by a crash is ignored, as well as everything after it.
+*/
+class Journal
+{
+public :
+	explicit Journal( const fs::path& file ) ;
+	~Journal() ;
+
+	std::size_t Replay( Val& st ) const ;
+
+	void Record( const fs::path& path, const Val *index ) ;
+	void Clear() ;
+
+private :
+	fs::path		m_file ;
+	File			m_out ;
+} ;
+
+} // end of namespace gr
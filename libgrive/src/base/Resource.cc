@@ -20,11 +20,13 @@
 #include "Resource.hh"
 #include "ResourceTree.hh"
 #include "Entry.hh"
+#include "HashCache.hh"
+#include "Journal.hh"
 #include "Syncer.hh"
+#include "TransferPool.hh"
 
 #include "json/Val.hh"
 #include "util/CArray.hh"
-#include "util/Crypt.hh"
 #include "util/log/Log.hh"
 #include "util/OS.hh"
 #include "util/File.hh"
@@ -43,30 +45,92 @@
 
 namespace gr {
 
+namespace
+{
+	/// the attributes of an index entry, i.e. the entry without the children of a folder
+	Val Attributes( const Val *index )
+	{
+		Val attr ;
+		if ( index )
+		{
+			const Val::Object& obj = index->AsObject() ;
+			for ( Val::Object::const_iterator i = obj.begin() ; i != obj.end() ; ++i )
+				if ( i->first != "tree" )
+					attr.Add( i->first, i->second ) ;
+		}
+		return attr ;
+	}
+
+	bool SameValue( const Val& a, const Val& b )
+	{
+		if ( a.Type() != b.Type() )
+			return false ;
+		switch ( a.Type() )
+		{
+		case Val::int_type :	return a.As<long long>() == b.As<long long>() ;
+		case Val::string_type :	return a.Str() == b.Str() ;
+		case Val::bool_type :	return a.Bool() == b.Bool() ;
+		case Val::double_type :	return a.Double() == b.Double() ;
+		case Val::null_type :	return true ;
+		default :				return false ;
+		}
+	}
+
+	bool SameAttributes( const Val& a, const Val& b )
+	{
+		const Val::Object& oa = a.AsObject(), &ob = b.AsObject() ;
+		if ( oa.size() != ob.size() )
+			return false ;
+		for ( Val::Object::const_iterator i = oa.begin(), j = ob.begin() ; i != oa.end() ; ++i, ++j )
+			if ( i->first != j->first || !SameValue( i->second, j->second ) )
+				return false ;
+		return true ;
+	}
+
+	/// folders with more children get an index to find them by name
+	const std::size_t max_unindexed_children = 16 ;
+
+	/// a resource being synced by Resource::Sync()
+	struct SyncItem
+	{
+		bool	journaled ;
+		bool	had_index ;
+		bool	mapped ;
+		Val		before ;
+		bool	failed ;
+	} ;
+}
+
 /// default constructor creates the root folder
 Resource::Resource( const fs::path& root_folder ) :
 	m_name		( root_folder.string() ),
-	m_kind		( "folder" ),
+	m_path		( root_folder ),
 	m_size		( 0 ),
 	m_id		( "folder:root" ),
 	m_href		( "root" ),
-	m_is_editable( true ),
 	m_parent	( 0 ),
-	m_state		( sync ),
 	m_json		( NULL ),
-	m_local_exists( true )
+	m_rel_pos	( 0 ),
+	m_state		( sync ),
+	m_kind		( folder_kind ),
+	m_is_editable( true ),
+	m_local_exists( true ),
+	m_moved_away( false )
 {
 }
 
-Resource::Resource( const std::string& name, const std::string& kind ) :
+Resource::Resource( const std::string& name, KindEnum kind ) :
 	m_name		( name ),
-	m_kind		( kind ),
+	m_path		( name ),
 	m_size		( 0 ),
-	m_is_editable( true ),
 	m_parent	( 0 ),
-	m_state		( unknown ),
 	m_json		( NULL ),
-	m_local_exists( false )
+	m_rel_pos	( 0 ),
+	m_state		( unknown ),
+	m_kind		( kind ),
+	m_is_editable( true ),
+	m_local_exists( false ),
+	m_moved_away( false )
 {
 }
 
@@ -91,18 +155,18 @@ void Resource::FromRemoteFolder( const Entry& remote )
 		Log( "folder %1% is read-only", path, log::verbose ) ;
 	
 	// already sync
-	if ( m_local_exists && m_kind == "folder" )
+	if ( m_local_exists && m_kind == folder_kind )
 	{
 		Log( "folder %1% is in sync", path, log::verbose ) ;
 		m_state = sync ;
 	}
-	else if ( m_local_exists && m_kind == "file" )
+	else if ( m_local_exists && m_kind == file_kind )
 	{
 		// TODO: handle type change
 		Log( "%1% changed from folder to file", path, log::verbose ) ;
 		m_state = sync ;
 	}
-	else if ( m_local_exists && m_kind == "bad" )
+	else if ( m_local_exists && m_kind == bad_kind )
 	{
 		Log( "%1% inaccessible", path, log::verbose ) ;
 		m_state = sync ;
@@ -173,7 +237,7 @@ void Resource::FromRemoteFile( const Entry& remote )
 		m_state = m_parent->m_state ;
 	}
 
-	else if ( m_kind == "bad" )
+	else if ( m_kind == bad_kind )
 	{
 		m_state = sync;
 	}
@@ -240,20 +304,51 @@ void Resource::FromDeleted( Val& state )
 {
 	assert( !m_json );
 	m_json = &state;
-	if ( state.Has( "ctime" ) )
-		m_ctime.Assign( state["ctime"].U64(), 0 );
-	if ( state.Has( "md5" ) )
-		m_md5 = state["md5"];
-	if ( state.Has( "srv_time" ) )
-		m_mtime.Assign( state[ "srv_time" ].U64(), 0 ) ;
-	if ( state.Has( "size" ) )
-		m_size = state[ "size" ].U64();
+
+	// read with Get(), which leaves an entry of a mapped index in the mapping
+	Val v ;
+	if ( state.Get( "ctime", v ) )
+		m_ctime.Assign( v.U64(), 0 );
+	if ( state.Get( "md5", v ) )
+		m_md5 = v.Str();
+	if ( state.Get( "srv_time", v ) )
+		m_mtime.Assign( v.U64(), 0 ) ;
+	if ( state.Get( "size", v ) )
+		m_size = v.U64();
 	m_state = both_deleted;
 }
 
 /// Update the resource with the attributes of local file or directory. This
 /// function will propulate the fields in m_entry.
 void Resource::FromLocal( Val& state )
+{
+	// root folder is always in sync
+	if ( IsRoot() )
+	{
+		assert( !m_json );
+		m_json = &state;
+		return;
+	}
+
+	DateTime ctime ;
+	off64_t size = 0 ;
+	FileType ft = FT_UNKNOWN ;
+	int error = 0 ;
+	try
+	{
+		os::Stat( Path(), &ctime, &size, &ft ) ;
+	}
+	catch ( os::Error &e )
+	{
+		int const* eno = boost::get_error_info< boost::errinfo_errno >(e);
+		error = eno ? *eno : EIO ;
+	}
+	FromLocal( state, ctime, size, ft, error ) ;
+}
+
+/// Same as FromLocal( Val& ), with the attributes of the local file already
+/// read, e.g. by DirScanner. \a error is the errno of a failed stat().
+void Resource::FromLocal( Val& state, const DateTime& ctime, u64_t size, FileType ft, int error )
 {
 	assert( !m_json );
 	m_json = &state;
@@ -262,39 +357,38 @@ void Resource::FromLocal( Val& state )
 	if ( !IsRoot() )
 	{
 		fs::path path = Path() ;
-		FileType ft ;
-		try
-		{
-			os::Stat( path, &m_ctime, (off64_t*)&m_size, &ft ) ;
-		}
-		catch ( os::Error &e )
+		if ( error != 0 )
 		{
 			// invalid symlink, unreadable file or something else
-			int const* eno = boost::get_error_info< boost::errinfo_errno >(e);
-			Log( "Error accessing %1%: %2%; skipping file", path.string(), strerror( *eno ), log::warning );
+			Log( "Error accessing %1%: %2%; skipping file", path.string(), strerror( error ), log::warning );
 			m_state = sync;
-			m_kind = "bad";
+			m_kind = bad_kind;
 			return;
 		}
+		m_ctime = ctime ;
+		m_size = size ;
 		if ( ft == FT_UNKNOWN )
 		{
 			// Skip sockets/FIFOs/etc
 			Log( "File %1% is not a regular file or directory; skipping file", path.string(), log::warning );
 			m_state = sync;
-			m_kind = "bad";
+			m_kind = bad_kind;
 			return;
 		}
 
-		m_name = path.filename().string() ;
-		m_kind = ft == FT_DIR ? "folder" : "file";
+		m_kind = ft == FT_DIR ? folder_kind : file_kind;
 		m_local_exists = true;
 
+		// read with Get(), which leaves an entry of a mapped index in the mapping
+		Val st_ctime, st_md5, st_size, st_srv_time ;
+		bool has_md5 = state.Get( "md5", st_md5 ) ;
+
 		bool is_changed;
-		if ( state.Has( "ctime" ) && (u64_t) m_ctime.Sec() <= state["ctime"].U64() &&
-			( ft == FT_DIR || state.Has( "md5" ) ) )
+		if ( state.Get( "ctime", st_ctime ) && (u64_t) m_ctime.Sec() <= st_ctime.U64() &&
+			( ft == FT_DIR || has_md5 ) )
 		{
 			if ( ft != FT_DIR )
-				m_md5 = state["md5"];
+				m_md5 = st_md5.Str();
 			is_changed = false;
 		}
 		else
@@ -302,14 +396,14 @@ void Resource::FromLocal( Val& state )
 			if ( ft != FT_DIR )
 			{
 				// File is changed locally. TODO: Detect conflicts
-				is_changed = ( state.Has( "size" ) && m_size != state["size"].U64() ) ||
-					!state.Has( "md5" ) || GetMD5() != state["md5"].Str();
+				is_changed = ( state.Get( "size", st_size ) && m_size != st_size.U64() ) ||
+					!has_md5 || GetMD5() != st_md5.Str();
 			}
 			else
 				is_changed = true;
 		}
-		if ( state.Has( "srv_time" ) )
-			m_mtime.Assign( state[ "srv_time" ].U64(), 0 ) ;
+		if ( state.Get( "srv_time", st_srv_time ) )
+			m_mtime.Assign( st_srv_time.U64(), 0 ) ;
 
 		// Upload file if it is changed and remove if not.
 		// State will be updated to sync/remote_changed in FromRemote()
@@ -351,7 +445,7 @@ std::string Resource::Name() const
 	return m_name ;
 }
 
-std::string Resource::Kind() const
+Resource::KindEnum Resource::Kind() const
 {
 	return m_kind ;
 }
@@ -390,12 +484,22 @@ void Resource::AddChild( Resource *child )
 	assert( child != this ) ;
 
 	child->m_parent = this ;
+	child->SetPath() ;
 	m_child.push_back( child ) ;
+
+	if ( !m_index.empty() )
+		m_index.insert( std::make_pair( &child->m_name, child ) ) ;
+	else if ( m_child.size() > max_unindexed_children )
+	{
+		m_index.reserve( m_child.size() * 2 ) ;
+		for ( std::vector<Resource*>::iterator i = m_child.begin() ; i != m_child.end() ; ++i )
+			m_index.insert( std::make_pair( &(*i)->m_name, *i ) ) ;
+	}
 }
 
 bool Resource::IsFolder() const
 {
-	return m_kind == "folder" ;
+	return m_kind == folder_kind ;
 }
 
 bool Resource::IsEditable() const
@@ -403,12 +507,27 @@ bool Resource::IsEditable() const
 	return m_is_editable ;
 }
 
-fs::path Resource::Path() const
+/// Builds the path from the path of the parent, and the paths below it again.
+/// Paths are only built once, so that Path() is cheap and may be called by
+/// the transfer threads.
+void Resource::SetPath()
+{
+	assert( m_parent != 0 ) ;
+
+	m_path = m_parent->m_path / m_name ;
+
+	// the relative path starts after the root and its separator
+	m_rel_pos = m_parent->IsRoot() ? m_path.string().size() - m_name.size() : m_parent->m_rel_pos ;
+
+	std::for_each( m_child.begin(), m_child.end(), boost::bind( &Resource::SetPath, _1 ) ) ;
+}
+
+const fs::path& Resource::Path() const
 {
 	assert( m_parent != this ) ;
 	assert( m_parent == 0 || m_parent->IsFolder() ) ;
 
-	return m_parent != 0 ? (m_parent->Path() / m_name) : m_name ;
+	return m_path ;
 }
 
 // Path relative to the root directory
@@ -417,7 +536,7 @@ fs::path Resource::RelPath() const
 	assert( m_parent != this ) ;
 	assert( m_parent == 0 || m_parent->IsFolder() ) ;
 
-	return m_parent != 0 && !m_parent->IsRoot() ? (m_parent->RelPath() / m_name) : m_name ;
+	return m_parent != 0 ? fs::path( m_path.string().substr( m_rel_pos ) ) : m_path ;
 }
 
 bool Resource::IsInRootTree() const
@@ -428,6 +547,12 @@ bool Resource::IsInRootTree() const
 
 Resource* Resource::FindChild( const std::string& name )
 {
+	if ( !m_index.empty() )
+	{
+		ChildIndex::iterator i = m_index.find( &name ) ;
+		return i != m_index.end() ? i->second : 0 ;
+	}
+
 	for ( std::vector<Resource*>::iterator i = m_child.begin() ; i != m_child.end() ; ++i )
 	{
 		assert( (*i)->m_parent == this ) ;
@@ -438,25 +563,129 @@ Resource* Resource::FindChild( const std::string& name )
 }
 
 // try to change the state to "sync"
-void Resource::Sync( Syncer *syncer, ResourceTree *res_tree, const Val& options )
+/// Syncs this folder and everything below it. The tree is synced one level at
+/// a time: the metadata changes of a level are queued in the syncer, which may
+/// send them together, and are finished before the next level, as it needs the
+/// IDs of the folders created.
+void Resource::Sync( Syncer *syncer, TransferPool *pool, Journal *journal, ResourceTree *res_tree, const Val& options )
 {
 	assert( m_state != unknown ) ;
 	assert( !IsRoot() || m_state == sync ) ;	// root folder is already synced
 	
+	// the files deleted in local whose new copy may move them
+	std::vector<Resource*> level( 1, this ), moved ;
+	while ( !level.empty() )
+	{
+		std::vector<SyncItem> items( level.size() ) ;
+		for ( std::size_t i = 0 ; i < level.size() ; i++ )
+		{
+			Resource *r = level[i] ;
+			SyncItem& item = items[i] ;
+			
+			// the index entry before syncing, to journal it if it changes. An entry
+			// still in the mapped state file is decoded by any change, so it need
+			// not be copied to be compared.
+			item.journaled	= journal && !r->IsRoot() ;
+			item.had_index	= r->m_json != NULL ;
+			item.mapped		= item.had_index && r->m_json->IsMapped() ;
+			item.before		= item.journaled && !item.mapped ? Attributes( r->m_json ) : Val() ;
+			item.failed		= false ;
+			
+			try
+			{
+				r->SyncSelf( syncer, pool, journal, res_tree, options, &item.failed ) ;
+			}
+			catch ( File::Error& )
+			{
+				r->LogSyncError() ;
+				item.failed = true ;
+			}
+			catch ( boost::filesystem::filesystem_error& )
+			{
+				r->LogSyncError() ;
+				item.failed = true ;
+			}
+			catch ( http::Error& )
+			{
+				r->LogSyncError() ;
+				item.failed = true ;
+			}
+
+			if ( r->m_state == local_deleted && r->m_moved_away )
+				moved.push_back( r ) ;
+		}
+		
+		if ( syncer )
+			syncer->Flush() ;
+		
+		std::vector<Resource*> next ;
+		for ( std::size_t i = 0 ; i < level.size() ; i++ )
+		{
+			Resource *r = level[i] ;
+			const SyncItem& item = items[i] ;
+			if ( item.failed )
+				continue ;
+			
+			if ( item.journaled )
+			{
+				if ( !r->m_json && item.had_index )
+					journal->Record( r->RelPath(), NULL ) ;
+				else if ( r->m_json && !r->m_json->IsMapped() && ( !item.had_index || item.mapped ||
+					!SameAttributes( item.before, Attributes( r->m_json ) ) ) )
+					journal->Record( r->RelPath(), r->m_json ) ;
+			}
+			
+			// if it is deleted, no need to do the childrens
+			if ( r->m_state != local_deleted && r->m_state != remote_deleted )
+				next.insert( next.end(), r->m_child.begin(), r->m_child.end() ) ;
+		}
+		level.swap( next ) ;
+
+		// the ones no new copy was moved from, e.g. because its folder couldn't
+		// be created, are deleted in a last level
+		if ( level.empty() )
+		{
+			for ( std::vector<Resource*>::iterator i = moved.begin() ; i != moved.end() ; ++i )
+			{
+				if ( (*i)->m_state == local_deleted )
+				{
+					(*i)->m_moved_away = false ;
+					level.push_back( *i ) ;
+				}
+			}
+			moved.clear() ;
+		}
+	}
+}
+
+/// Logs the error a queued operation of the syncer failed with.
+void Resource::LogSyncError( std::exception_ptr error ) const
+{
 	try
 	{
-		SyncSelf( syncer, res_tree, options ) ;
+		std::rethrow_exception( error ) ;
+	}
+	catch ( http::Error& )
+	{
+		LogSyncError() ;
+	}
+}
+
+/// Logs the sync error currently being handled. Must be called from a catch block.
+void Resource::LogSyncError() const
+{
+	try
+	{
+		throw ;
 	}
 	catch ( File::Error &e )
 	{
 		int *en = boost::get_error_info< boost::errinfo_errno > ( e ) ;
 		Log( "Error syncing %1%: %2%", Path(), en ? strerror( *en ) : "", log::error );
-		return;
 	}
 	catch ( boost::filesystem::filesystem_error &e )
 	{
 		Log( "Error syncing %1%: %2%", Path(), e.what(), log::error );
-		return;
 	}
 	catch ( http::Error &e )
 	{
@@ -482,42 +711,34 @@ void Resource::Sync( Syncer *syncer, ResourceTree *res_tree, const Val& options
 			Log( "Response headers: %1%", *resp_hdr, log::verbose );
 		if ( resp_txt )
 			Log( "Response text: %1%", *resp_txt, log::verbose );
-		return;
 	}
-	
-	// if myself is deleted, no need to do the childrens
-	if ( m_state != local_deleted && m_state != remote_deleted )
+}
+
+/// A locally added file may be a moved one if a file of the same size was
+/// deleted locally. The size index is checked first, so that the MD5 is only
+/// computed for these files.
+bool Resource::MaybeMoved( ResourceTree *res_tree ) const
+{
+	details::SizeRange moved = res_tree->FindBySize( m_size );
+	for ( details::SizeMap::iterator i = moved.first ; i != moved.second; i++ )
 	{
-		std::for_each( m_child.begin(), m_child.end(),
-			boost::bind( &Resource::Sync, _1, syncer, res_tree, options ) ) ;
+		Resource *m = *i;
+		if ( m->m_state == local_deleted )
+			return true;
 	}
+	return false;
 }
 
-bool Resource::CheckRename( Syncer* syncer, ResourceTree *res_tree )
+bool Resource::CheckRename( Syncer* syncer, ResourceTree *res_tree, bool *failed )
 {
 	if ( !IsFolder() && ( m_state == local_new || m_state == remote_new ) )
 	{
 		bool is_local = m_state == local_new;
 		State other = is_local ? local_deleted : remote_deleted;
-		if ( is_local )
+		if ( is_local && !MaybeMoved( res_tree ) )
 		{
-			// First check size index for locally added files
-			details::SizeRange moved = res_tree->FindBySize( m_size );
-			bool found = false;
-			for ( details::SizeMap::iterator i = moved.first ; i != moved.second; i++ )
-			{
-				Resource *m = *i;
-				if ( m->m_state == other )
-				{
-					found = true;
-					break;
-				}
-			}
-			if ( !found )
-			{
-				// Don't check md5 sums if there are no deleted files with same size
-				return false;
-			}
+			// Don't check md5 sums if there are no deleted files with same size
+			return false;
 		}
 		details::MD5Range moved = res_tree->FindByMD5( GetMD5() );
 		for ( details::MD5Map::iterator i = moved.first ; i != moved.second; i++ )
@@ -533,14 +754,15 @@ bool Resource::CheckRename( Syncer* syncer, ResourceTree *res_tree )
 				{
 					if ( is_local )
 					{
-						syncer->Move( from, to->Parent(), to->Name() );
-						to->SetIndex( false );
-					}
-					else
-					{
-						fs::rename( from->Path(), to->Path() );
-						to->SetIndex( true );
+						// the index is updated when the move is finished
+						from->m_state = both_deleted;
+						to->m_state = sync;
+						syncer->QueueMove( from, to->Parent(), to->Name(),
+							boost::bind( &Resource::FinishMove, to, from, failed, _1 ) );
+						return true;
 					}
+					fs::rename( from->Path(), to->Path() );
+					to->SetIndex( true );
 					to->m_mtime = from->m_mtime;
 					to->m_json->Set( "srv_time", Val( from->m_mtime.Sec() ) );
 					from->DeleteIndex();
@@ -554,7 +776,10 @@ bool Resource::CheckRename( Syncer* syncer, ResourceTree *res_tree )
 	return false;
 }
 
-void Resource::SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& options )
+/// Syncs this resource, not its children. Folders are created and files deleted
+/// or moved in the server by queued operations of the syncer, which set \a failed
+/// when they fail.
+void Resource::SyncSelf( Syncer* syncer, TransferPool *pool, Journal *journal, ResourceTree *res_tree, const Val& options, bool *failed )
 {
 	assert( !IsRoot() || m_state == sync ) ;	// root is always sync
 	assert( IsRoot() || !syncer || m_parent->IsFolder() ) ;
@@ -564,37 +789,40 @@ void Resource::SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& opti
 	const fs::path path = Path() ;
 
 	// Detect renames
-	if ( CheckRename( syncer, res_tree ) )
+	if ( CheckRename( syncer, res_tree, failed ) )
 		return;
 
+	// file transfers may be run by the pool in parallel. folders are always created
+	// right here, so they exist before any of their children is transferred.
+	bool transfer = false ;
+
 	switch ( m_state )
 	{
 	case local_new :
 		Log( "sync %1% doesn't exist in server, uploading", path, log::info ) ;
 		
-		if ( syncer && syncer->Create( this ) )
-		{
-			m_state = sync ;
-			SetIndex( false );
-		}
+		if ( syncer && IsFolder() )
+			syncer->QueueCreate( this, boost::bind( &Resource::FinishCreate, this, failed, _1 ) ) ;
+		else
+			transfer = true ;
 		break ;
 	
 	case local_deleted :
-		Log( "sync %1% deleted in local. deleting remote", path, log::info ) ;
-		if ( syncer && !options["no-delete-remote"].Bool() )
+		// the levels are synced in order, so the file it was moved to may not be
+		// checked yet. the move is sent with it, or it is deleted at the end.
+		if ( m_moved_away )
 		{
-			syncer->DeleteRemote( this ) ;
-			DeleteIndex() ;
+			Log( "sync %1% deleted in local, but may be moved", path, log::verbose ) ;
+			break ;
 		}
+		Log( "sync %1% deleted in local. deleting remote", path, log::info ) ;
+		if ( syncer && !options["no-delete-remote"].Bool() )
+			syncer->QueueDelete( this, boost::bind( &Resource::FinishDelete, this, failed, _1 ) ) ;
 		break ;
 	
 	case local_changed :
 		Log( "sync %1% changed in local. uploading", path, log::info ) ;
-		if ( syncer && syncer->EditContent( this, options["new-rev"].Bool() ) )
-		{
-			m_state = sync ;
-			SetIndex( false );
-		}
+		transfer = true ;
 		break ;
 	
 	case remote_new :
@@ -603,15 +831,14 @@ void Resource::SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& opti
 		else
 		{
 			Log( "sync %1% created in remote. creating local", path, log::info ) ;
-			if ( syncer )
+			if ( syncer && IsFolder() )
 			{
-				if ( IsFolder() )
-					fs::create_directories( path ) ;
-				else
-					syncer->Download( this, path ) ;
+				fs::create_directories( path ) ;
 				SetIndex( true ) ;
 				m_state = sync ;
 			}
+			else
+				transfer = true ;
 		}
 		break ;
 	
@@ -622,12 +849,7 @@ void Resource::SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& opti
 		else
 		{
 			Log( "sync %1% changed in remote. downloading", path, log::info ) ;
-			if ( syncer )
-			{
-				syncer->Download( this, path ) ;
-				SetIndex( true ) ;
-				m_state = sync ;
-			}
+			transfer = true ;
 		}
 		break ;
 	
@@ -657,14 +879,126 @@ void Resource::SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& opti
 		assert( false ) ;
 		break ;
 	}
-	
-	if ( syncer && m_json )
+
+	if ( transfer && syncer )
+	{
+		assert( pool != 0 ) ;
+		pool->Push( syncer,
+			boost::bind( &Resource::Transfer, this, _1, options["new-rev"].Bool() ),
+			boost::bind( &Resource::FinishTransfer, this, journal, _1 ) ) ;
+	}
+	else if ( syncer && m_json )
 	{
 		// Update server time of this file
 		m_json->Set( "srv_time", Val( m_mtime.Sec() ) );
 	}
 }
 
+/// Updates the state index after the folder is created in the server.
+void Resource::FinishCreate( bool *failed, std::exception_ptr error )
+{
+	if ( error )
+		LogSyncError( error ) ;
+
+	// not created in a read-only folder
+	if ( error || ResourceID().empty() )
+	{
+		*failed = true ;
+		return ;
+	}
+
+	m_state = sync ;
+	SetIndex( false ) ;
+	m_json->Set( "srv_time", Val( m_mtime.Sec() ) ) ;
+}
+
+/// Updates the state index after the file is deleted in the server.
+void Resource::FinishDelete( bool *failed, std::exception_ptr error )
+{
+	if ( error )
+	{
+		LogSyncError( error ) ;
+		*failed = true ;
+	}
+	else
+		DeleteIndex() ;
+}
+
+/// Updates the state index after \a from is moved to this resource in the server.
+/// If it failed, both are left as they were, to be deleted and uploaded.
+void Resource::FinishMove( Resource *from, bool *failed, std::exception_ptr error )
+{
+	if ( error )
+	{
+		LogSyncError( error ) ;
+		*failed = true ;
+		from->m_state = local_deleted ;
+		m_state = local_new ;
+		return ;
+	}
+
+	SetIndex( false ) ;
+	m_mtime = from->m_mtime ;
+	m_json->Set( "srv_time", Val( from->m_mtime.Sec() ) ) ;
+	from->DeleteIndex() ;
+}
+
+/// Uploads or downloads the content of the file. This may run in a worker thread
+/// of the TransferPool, so it must not touch the state index or other resources.
+bool Resource::Transfer( Syncer* syncer, bool new_rev )
+{
+	try
+	{
+		switch ( m_state )
+		{
+		case local_new :
+			return syncer->Create( this ) ;
+		
+		case local_changed :
+			return syncer->EditContent( this, new_rev ) ;
+		
+		case remote_new :
+		case remote_changed :
+			syncer->Download( this, Path() ) ;
+			return true ;
+		
+		default :
+			assert( false ) ;
+			return false ;
+		}
+	}
+	catch ( File::Error& )
+	{
+		LogSyncError() ;
+	}
+	catch ( boost::filesystem::filesystem_error& )
+	{
+		LogSyncError() ;
+	}
+	catch ( http::Error& )
+	{
+		LogSyncError() ;
+	}
+	return false ;
+}
+
+/// Updates the state index after Transfer(). Always called in the thread running the sync.
+void Resource::FinishTransfer( Journal *journal, bool done )
+{
+	if ( !done )
+		return ;
+	
+	// downloaded files got a new ctime that must be remembered
+	SetIndex( m_state == remote_new || m_state == remote_changed ) ;
+	m_state = sync ;
+	
+	// Update server time of this file
+	m_json->Set( "srv_time", Val( m_mtime.Sec() ) );
+	
+	if ( journal )
+		journal->Record( RelPath(), m_json ) ;
+}
+
 void Resource::SetServerTime( const DateTime& time )
 {
 	m_mtime = time ;
@@ -782,11 +1116,50 @@ std::string Resource::GetMD5()
 		// MD5 checksum is calculated lazily and only when really needed:
 		// 1) when a local rename is supposed (when there are a new file and a deleted file of the same size)
 		// 2) when local ctime is changed, but file size isn't
-		m_md5 = crypt::MD5::Get( Path() );
+		// the file is only read if its content changed since it was last hashed
+		m_md5 = HashCache::Inst()->Get( Path() );
 	}
 	return m_md5 ;
 }
 
+/// Starts computing the MD5 which CheckRename() will need in the background,
+/// so that all the possibly moved files are read at the same time.
+void Resource::PrefetchMD5( ResourceTree *res_tree )
+{
+	if ( m_md5.empty() && !IsFolder() && m_local_exists && m_state == local_new && MaybeMoved( res_tree ) )
+		HashCache::Inst()->Async( Path() ) ;
+}
+
+/// Marks a file deleted in local if a new local file has the size and MD5 of
+/// its index record, i.e. if it may have been moved. It must be called before
+/// the sync starts, as the MD5 of the new files is read and the transfers set it.
+void Resource::CheckMovedAway( ResourceTree *res_tree )
+{
+	m_moved_away = false ;
+	if ( m_state != local_deleted || IsFolder() || !m_json || !m_json->Has( "md5" ) || !m_json->Has( "size" ) )
+		return ;
+
+	const std::string md5 = (*m_json)["md5"].Str() ;
+	details::SizeRange same = res_tree->FindBySize( (*m_json)["size"].U64() ) ;
+	for ( details::SizeMap::iterator i = same.first ; i != same.second && !m_moved_away ; ++i )
+	{
+		Resource *r = *i ;
+		m_moved_away = r->m_state == local_new && !r->IsFolder() && r->GetMD5() == md5 ;
+	}
+}
+
+/// Tells if FromLocal() will compare the MD5 of a file with the index to know
+/// if it was changed, i.e. if its ctime was changed but its size wasn't.
+bool Resource::NeedsMD5( const Val& state, const DateTime& ctime, u64_t size )
+{
+	Val v ;
+	if ( !state.Has( "md5" ) )
+		return false ;
+	if ( state.Get( "ctime", v ) && (u64_t) ctime.Sec() <= v.U64() )
+		return false ;
+	return !state.Get( "size", v ) || size == v.U64() ;
+}
+
 bool Resource::IsRoot() const
 {
 	// Root entry does not show up in file feeds, so we check for empty parent (and self-href)
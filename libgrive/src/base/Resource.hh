@@ -23,8 +23,12 @@
 #include "util/DateTime.hh"
 #include "util/Exception.hh"
 #include "util/FileSystem.hh"
+#include "util/OS.hh"
 
+#include <exception>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <iosfwd>
 
@@ -34,6 +38,10 @@ class ResourceTree ;
 
 class Syncer ;
 
+class TransferPool ;
+
+class Journal ;
+
 class Val ;
 
 class Entry ;
@@ -83,15 +91,18 @@ public :
 		unknown
 	} ;
 
+	/// bad_kind is a local file which can't be read, or is neither a file nor a folder
+	enum KindEnum { folder_kind, file_kind, bad_kind } ;
+
 public :
 	Resource(const fs::path& root_folder) ;
-	Resource( const std::string& name, const std::string& kind ) ;
+	Resource( const std::string& name, KindEnum kind ) ;
 	
 	bool IsFolder() const ;
 	bool IsEditable() const ;
 
 	std::string Name() const ;
-	std::string Kind() const ;
+	KindEnum Kind() const ;
 	DateTime ServerTime() const ;
 	std::string SelfHref() const ;
 	std::string ContentSrc() const ;
@@ -104,7 +115,7 @@ public :
 	void AddChild( Resource *child ) ;
 	Resource* FindChild( const std::string& title ) ;
 	
-	fs::path Path() const ;
+	const fs::path& Path() const ;
 	fs::path RelPath() const ;
 	bool IsInRootTree() const ;
 	bool IsRoot() const ;
@@ -112,12 +123,16 @@ public :
 	u64_t Size() const;
 	std::string MD5() const ;
 	std::string GetMD5() ;
+	void PrefetchMD5( ResourceTree *res_tree ) ;
+	void CheckMovedAway( ResourceTree *res_tree ) ;
+	static bool NeedsMD5( const Val& state, const DateTime& ctime, u64_t size ) ;
 
 	void FromRemote( const Entry& remote ) ;
 	void FromDeleted( Val& state ) ;
 	void FromLocal( Val& state ) ;
+	void FromLocal( Val& state, const DateTime& ctime, u64_t size, FileType ft, int error ) ;
 	
-	void Sync( Syncer* syncer, ResourceTree *res_tree, const Val& options ) ;
+	void Sync( Syncer* syncer, TransferPool *pool, Journal *journal, ResourceTree *res_tree, const Val& options ) ;
 	void SetServerTime( const DateTime& time ) ;
 
 	// children access
@@ -136,6 +151,7 @@ private :
 
 private :
 	void SetState( State new_state ) ;
+	void SetPath() ;
 	
 	void FromRemoteFolder( const Entry& remote ) ;
 	void FromRemoteFile( const Entry& remote ) ;
@@ -144,12 +160,32 @@ private :
 	void DeleteIndex() ;
 	void SetIndex( bool ) ;
 	
-	bool CheckRename( Syncer* syncer, ResourceTree *res_tree ) ;
-	void SyncSelf( Syncer* syncer, ResourceTree *res_tree, const Val& options ) ;
+	bool MaybeMoved( ResourceTree *res_tree ) const ;
+	bool CheckRename( Syncer* syncer, ResourceTree *res_tree, bool *failed ) ;
+	void SyncSelf( Syncer* syncer, TransferPool *pool, Journal *journal, ResourceTree *res_tree, const Val& options, bool *failed ) ;
+	void FinishCreate( bool *failed, std::exception_ptr error ) ;
+	void FinishDelete( bool *failed, std::exception_ptr error ) ;
+	void FinishMove( Resource *from, bool *failed, std::exception_ptr error ) ;
+	bool Transfer( Syncer* syncer, bool new_rev ) ;
+	void FinishTransfer( Journal *journal, bool done ) ;
+	void LogSyncError() const ;
+	void LogSyncError( std::exception_ptr error ) const ;
+
+	/// children by name, pointing to their own m_name
+	struct NameHash
+	{
+		std::size_t operator()( const std::string *name ) const { return std::hash<std::string>()( *name ) ; }
+	} ;
+	struct NameEqual
+	{
+		bool operator()( const std::string *a, const std::string *b ) const { return *a == *b ; }
+	} ;
+	typedef std::unordered_map<const std::string*, Resource*, NameHash, NameEqual> ChildIndex ;
 
 private :
 	std::string				m_name ;
-	std::string				m_kind ;
+	/// set when the resource is added to its parent
+	fs::path				m_path ;
 	std::string				m_md5 ;
 	DateTime				m_mtime ;
 	DateTime				m_ctime ;
@@ -159,15 +195,25 @@ private :
 	std::string				m_href ;
 	std::string				m_content ;
 	std::string				m_etag ;
-	bool					m_is_editable ;
 
 	// not owned
 	Resource				*m_parent ;
 	std::vector<Resource*>	m_child ;
 
-	State					m_state ;
+	/// only built for folders with many children
+	ChildIndex				m_index ;
+
 	Val*					m_json ;
+
+	// the small fields last, so they share the padding
+	/// where the path relative to the root starts in m_path
+	unsigned				m_rel_pos ;
+	State					m_state ;
+	KindEnum				m_kind ;
+	bool					m_is_editable ;
 	bool					m_local_exists ;
+	/// deleted in local, but a new file has its content
+	bool					m_moved_away ;
 } ;
 
 } // end of namespace gr::v1
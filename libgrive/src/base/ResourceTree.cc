@@ -66,6 +66,15 @@ void ResourceTree::Clear()
 	m_root = 0 ;
 }
 
+/// Deletes everything but a new root folder, to build the tree again.
+void ResourceTree::Reset()
+{
+	fs::path root = Root()->Path() ;
+	Clear() ;
+	m_root = new Resource( root ) ;
+	m_set.insert( m_root ) ;
+}
+
 Resource* ResourceTree::Root()
 {
 	assert( m_root != 0 ) ;
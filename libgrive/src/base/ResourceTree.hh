@@ -84,6 +84,7 @@ public :
 	
 	Resource* Root() ;
 	const Resource* Root() const ;
+	void Reset() ;
 	
 	iterator begin() ;
 	iterator end() ;
@@ -20,23 +20,35 @@
 #include "State.hh"
 
 #include "Entry.hh"
+#include "HashCache.hh"
 #include "Resource.hh"
 #include "Syncer.hh"
+#include "TransferPool.hh"
 
 #include "util/Crypt.hh"
 #include "util/File.hh"
+#include "util/MemMap.hh"
 #include "util/log/Log.hh"
+#include "json/BinaryVal.hh"
 #include "json/JsonParser.hh"
 
 #include <boost/algorithm/string.hpp>
-
-#include <fstream>
+#include <boost/bind.hpp>
 
 namespace gr {
 
 const std::string state_file = ".grive_state" ;
+const std::string journal_file = ".grive_state.journal" ;
+const std::string temp_state_file = ".grive_state.tmp" ;
+const std::string uploads_file = ".grive_state.uploads" ;
 const std::string ignore_file = ".griveignore" ;
+// grive's own files, including the part files of unfinished downloads in any directory
+const std::string own_files_re = "^\\.(grive$|grive_state(\\.journal|\\.tmp|\\.uploads(\\.tmp)?)?$|trash)|(^|/)\\.[^/]+\\.grive_part$" ;
 const int MAX_IGN = 65536 ;
+
+// reading directories is mostly waiting for the disk (or the network, with NFS),
+// so more threads than cores help
+const unsigned scan_threads = 8 ;
 const char* regex_escape_chars = ".^$|()[]{}*+?\\";
 const boost::regex regex_escape_re( "[.^$|()\\[\\]{}*+?\\\\]" );
 
@@ -48,7 +60,10 @@ inline std::string regex_escape( std::string s )
 State::State( const fs::path& root, const Val& options  ) :
 	m_root		( root ),
 	m_res		( options["path"].Str() ),
-	m_cstamp	( -1 )
+	m_cstamp	( -1 ),
+	m_ign_compiled	( false ),
+	m_journal	( root / journal_file ),
+	m_uploads	( root / uploads_file )
 {
 	Read() ;
 
@@ -78,7 +93,12 @@ State::State( const fs::path& root, const Val& options  ) :
 	}
 
 	m_ign_changed = m_orig_ign != "" && m_orig_ign != m_ign;
-	m_ign_re = boost::regex( m_ign.empty() ? "^\\.(grive$|grive_state$|trash)" : ( m_ign+"|^\\.(grive$|grive_state$|trash)" ) );
+
+	// the patterns of .griveignore are matched by m_ign_matcher, the regexp
+	// is only used for the options and for grive's own files
+	if ( m_ign != m_orig_ign )
+		m_ign_compiled = false;
+	m_ign_re = boost::regex( m_ign.empty() || m_ign_compiled ? own_files_re : ( m_ign+"|"+own_files_re ) );
 }
 
 State::~State()
@@ -89,29 +109,171 @@ State::~State()
 /// of local directory.
 void State::FromLocal( const fs::path& p )
 {
+	DirScanner::Node root ;
+	DirScanner scanner( scan_threads, boost::bind( &State::IsIgnore, this, _1 ) ) ;
+	scanner.Scan( p, root ) ;
+
+	FromScan( root, p ) ;
+}
+
+/// Same as FromLocal( p ), for syncing again with the same State. Only the
+/// directories in \a dirty, relative to \a p, are read again: the rest of the
+/// tree is the same as the last time.
+void State::FromLocal( const fs::path& p, const std::set<std::string>& dirty )
+{
+	// the resources of the last sync are done with
+	m_res.Reset() ;
+	m_unresolved.clear() ;
+
+	// nothing read yet
+	std::set<std::string> dirs( dirty ) ;
+	if ( m_scan.name.empty() )
+		dirs.insert( "" ) ;
+
+	std::vector<std::string> done ;
+	for ( std::set<std::string>::const_iterator i = dirs.begin() ; i != dirs.end() ; ++i )
+	{
+		// directories are read with everything below them
+		bool below = false ;
+		for ( std::vector<std::string>::const_iterator j = done.begin() ; j != done.end() && !below ; ++j )
+			below = j->empty() || i->compare( 0, j->size() + 1, *j + "/" ) == 0 ;
+
+		if ( !below )
+		{
+			Rescan( p, *i ) ;
+			done.push_back( *i ) ;
+		}
+	}
+
+	FromScan( m_scan, p ) ;
+}
+
+/// Reads the directory \a rel of the tree in m_scan again. If it's not a
+/// directory any more, its parent is read instead.
+void State::Rescan( const fs::path& p, const std::string& rel )
+{
+	std::string::size_type slash = rel.rfind( '/' ) ;
+	std::string parent = slash == std::string::npos ? "" : rel.substr( 0, slash ) ;
+
+	DirScanner::Node *node = &m_scan ;
+	std::vector<std::string> parts ;
+	if ( !rel.empty() )
+		boost::split( parts, rel, boost::is_any_of( "/" ) ) ;
+	for ( std::vector<std::string>::iterator i = parts.begin() ; i != parts.end() && node ; ++i )
+	{
+		DirScanner::Node *child = NULL ;
+		for ( std::vector<DirScanner::Node>::iterator c = node->children.begin() ; c != node->children.end() && !child ; ++c )
+			if ( c->name == *i && c->type == FT_DIR && !c->ignored )
+				child = &*c ;
+		node = child ;
+	}
+	if ( !node )
+	{
+		Rescan( p, parent ) ;
+		return ;
+	}
+
+	std::string name = node->name ;
+	try
+	{
+		DirScanner scanner( scan_threads, boost::bind( &State::IsIgnore, this, _1 ) ) ;
+		scanner.Scan( p / rel, rel, *node ) ;
+	}
+	catch ( fs::filesystem_error& )
+	{
+		if ( rel.empty() )
+			throw ;
+		Rescan( p, parent ) ;
+		return ;
+	}
+
+	// its own ctime changes with its entries
+	if ( !rel.empty() )
+	{
+		node->name = name ;
+
+		off64_t size ;
+		FileType ft ;
+		try
+		{
+			os::Stat( p / rel, &node->ctime, &size, &ft ) ;
+		}
+		catch ( os::Error& )
+		{
+		}
+	}
+}
+
+/// Builds the local side of the resource tree from a scan of the directory \a p.
+void State::FromScan( const DirScanner::Node& root, const fs::path& p )
+{
+	// start reading all the files whose MD5 must be checked before using it
+	PrefetchMD5( root, p, m_st.Item( "tree" ) ) ;
+
 	m_res.Root()->FromLocal( m_st ) ;
-	FromLocal( p, m_res.Root(), m_st.Item( "tree" ) ) ;
+	FromLocal( root, m_res.Root(), m_st.Item( "tree" ) ) ;
+}
+
+void State::PrefetchMD5( const DirScanner::Node& dir, const fs::path& path, const Val& tree )
+{
+	for ( std::vector<DirScanner::Node>::const_iterator i = dir.children.begin() ; i != dir.children.end() ; ++i )
+	{
+		if ( i->ignored || i->error != 0 || !tree.Has( i->name ) )
+			continue ;
+
+		const Val& rec = tree[i->name] ;
+		if ( i->type == FT_DIR && rec.Has( "tree" ) )
+			PrefetchMD5( *i, path / i->name, rec["tree"] ) ;
+		else if ( i->type == FT_FILE && Resource::NeedsMD5( rec, i->ctime, i->size ) )
+			HashCache::Inst()->Async( path / i->name ) ;
+	}
+}
+
+/// Files whose checksum comes from the index are added to the MD5 cache, so it
+/// stays valid when only their ctime changes or when they are renamed.
+void State::RememberMD5( const DirScanner::Node& file, const std::string& md5 )
+{
+	HashCache::Key key ;
+	key.dev		= file.dev ;
+	key.ino		= file.ino ;
+	key.size	= file.size ;
+	key.mtime	= file.mtime ;
+	HashCache::Inst()->Put( key, md5 ) ;
 }
 
 bool State::IsIgnore( const std::string& filename )
 {
-	return regex_search( filename.c_str(), m_ign_re, boost::format_perl );
+	return ( m_ign_compiled && m_ign_matcher.IsIgnored( filename ) ) ||
+		regex_search( filename.c_str(), m_ign_re, boost::format_perl );
 }
 
-void State::FromLocal( const fs::path& p, Resource* folder, Val& tree )
+void State::FromLocal( const DirScanner::Node& dir, Resource* folder, Val& tree )
 {
 	assert( folder != 0 ) ;
 	assert( folder->IsFolder() ) ;
 
-	Val::Object leftover = tree.AsObject();
+	// the index entries which are not found in local. both are sorted by name,
+	// so they are merged in one pass
+	std::vector<std::string> leftover ;
+	const Val::Object& index = tree.AsObject() ;
+	std::vector<DirScanner::Node>::const_iterator n = dir.children.begin() ;
+	for ( Val::Object::const_iterator i = index.begin() ; i != index.end() ; ++i )
+	{
+		while ( n != dir.children.end() && n->name < i->first )
+			++n ;
+		if ( n == dir.children.end() || n->name != i->first || n->ignored )
+			leftover.push_back( i->first ) ;
+	}
 
-	for ( fs::directory_iterator i( p ) ; i != fs::directory_iterator() ; ++i )
+	for ( std::vector<DirScanner::Node>::const_iterator i = dir.children.begin() ; i != dir.children.end() ; ++i )
 	{
-		std::string fname = i->path().filename().string() ;
-		std::string path = ( folder->IsRoot() ? fname : ( folder->RelPath() / fname ).string() );
+		const std::string& fname = i->name ;
 		
-		if ( IsIgnore( path ) )
+		if ( i->ignored )
+		{
+			std::string path = ( folder->IsRoot() ? fname : ( folder->RelPath() / fname ).string() );
 			Log( "file %1% is ignored by grive", path, log::verbose ) ;
+		}
 		else
 		{
 			// if the Resource object of the child already exists, it should
@@ -119,14 +281,16 @@ void State::FromLocal( const fs::path& p, Resource* folder, Val& tree )
 			Resource *c = folder->FindChild( fname ), *c2 = c ;
 			if ( !c )
 			{
-				c2 = new Resource( fname, "" ) ;
+				// the kind is only known after FromLocal()
+				c2 = new Resource( fname, Resource::file_kind ) ;
 				folder->AddChild( c2 ) ;
 			}
-			leftover.erase( fname );
 			Val& rec = tree.Item( fname );
 			if ( m_force )
 				rec.Del( "srv_time" );
-			c2->FromLocal( rec ) ;
+			c2->FromLocal( rec, i->ctime, i->size, i->type, i->error ) ;
+			if ( i->type == FT_FILE && !c2->MD5().empty() )
+				RememberMD5( *i, c2->MD5() ) ;
 			if ( !c )
 				m_res.Insert( c2 ) ;
 			if ( c2->IsFolder() )
@@ -134,21 +298,21 @@ void State::FromLocal( const fs::path& p, Resource* folder, Val& tree )
 		}
 	}
 
-	for( Val::Object::iterator i = leftover.begin(); i != leftover.end(); i++ )
+	for( std::vector<std::string>::iterator i = leftover.begin(); i != leftover.end(); i++ )
 	{
-		std::string path = folder->IsRoot() ? i->first : ( folder->RelPath() / i->first ).string();
+		std::string path = folder->IsRoot() ? *i : ( folder->RelPath() / *i ).string();
 		if ( IsIgnore( path ) )
 			Log( "file %1% is ignored by grive", path, log::verbose ) ;
 		else
 		{
 			// Restore state of locally deleted files
-			Resource *c = folder->FindChild( i->first ), *c2 = c ;
+			Val& rec = tree.Item( *i );
+			Resource *c = folder->FindChild( *i ), *c2 = c ;
 			if ( !c )
 			{
-				c2 = new Resource( i->first, i->second.Has( "tree" ) ? "folder" : "file" ) ;
+				c2 = new Resource( *i, rec.Has( "tree" ) ? Resource::folder_kind : Resource::file_kind ) ;
 				folder->AddChild( c2 ) ;
 			}
-			Val& rec = tree.Item( i->first );
 			if ( m_force || m_ign_changed )
 				rec.Del( "srv_time" );
 			c2->FromDeleted( rec );
@@ -176,37 +340,98 @@ void State::FromRemote( const Entry& e )
 	else if ( e.IsChange() )
 		FromChange( e ) ;
 
-	else if ( !Update( e ) )
-		m_unresolved.push_back( e ) ;
+	else
+		Resolve( e ) ;
 }
 
-void State::ResolveEntry()
+/// Check if the state file has a copy of the remote file list, i.e. if the
+/// changes feed can be used to update it instead of listing all files again.
+bool State::HasRemote() const
 {
-	while ( !m_unresolved.empty() )
-	{
-		if ( TryResolveEntry() == 0 )
-			break ;
-	}
+	return m_st.Has( "remote" ) ;
 }
 
-std::size_t State::TryResolveEntry()
+/// Forget the remote file list before a full listing, so that a listing which fails
+/// halfway is never taken for the complete one by the next sync.
+void State::ClearRemote()
 {
-	assert( !m_unresolved.empty() ) ;
+	m_st.Del( "remote" ) ;
+}
+
+/// Replace the remote file list with the complete one in \a remote.
+void State::SetRemote( Val&& remote )
+{
+	m_st.Set( "remote", std::move( remote ) ) ;
+}
+
+/// The remote file list, for applying the changes feed to it.
+Val& State::Remote()
+{
+	return m_st.Item( "remote" ) ;
+}
 
+/// Record an entry of the remote file list, or forget it if it has been deleted in remote.
+void State::UpdateRemote( Val& remote, const Entry& e )
+{
+	if ( e.IsRemoved() )
+		remote.Del( e.ResourceID() ) ;
+	else
+		remote.Set( e.ResourceID(), e.Index() ) ;
+}
+
+/// Build up the remote side of the resource tree from the recorded file list.
+void State::FromRemoteIndex()
+{
+	const Val::Object& remote = m_st.Item( "remote" ).AsObject() ;
+	for ( Val::Object::const_iterator i = remote.begin() ; i != remote.end() ; ++i )
+		FromRemote( Entry( i->second ) ) ;
+}
+
+/// The entries left waiting once the whole file list is read have no parent
+/// in the tree, e.g. because the parent is ignored or not in the drive.
+/// Returns their number.
+std::size_t State::ResolveEntry()
+{
 	std::size_t count = 0 ;
-	std::list<Entry>& en = m_unresolved ;
+	for ( Unresolved::const_iterator i = m_unresolved.begin() ; i != m_unresolved.end() ; ++i )
+		count += i->second.size() ;
+
+	if ( count > 0 )
+		Log( "%1% remote entries have no known parent, ignored", count, log::verbose ) ;
+	return count ;
+}
 
-	for ( std::list<Entry>::iterator i = en.begin() ; i != en.end() ; )
+/// Adds \a e to the tree, and then the entries which were waiting for it as
+/// their parent, and so on. The file list may have children before their
+/// parents, so an entry whose parent is not in the tree yet waits for it.
+void State::Resolve( const Entry& e )
+{
+	if ( !Update( e ) )
 	{
-		if ( Update( *i ) )
+		m_unresolved[e.ParentHref()].push_back( e ) ;
+		return ;
+	}
+
+	std::vector<std::string> resolved( 1, e.SelfHref() ) ;
+	while ( !resolved.empty() )
+	{
+		Unresolved::iterator i = m_unresolved.find( resolved.back() ) ;
+		resolved.pop_back() ;
+		if ( i == m_unresolved.end() )
+			continue ;
+
+		// the ones failing again, e.g. below an ignored folder, wait in a new list
+		std::vector<Entry> waiting ;
+		waiting.swap( i->second ) ;
+		m_unresolved.erase( i ) ;
+		for ( std::vector<Entry>::const_iterator c = waiting.begin() ; c != waiting.end() ; ++c )
 		{
-			i = en.erase( i ) ;
-			count++ ;
+			if ( Update( *c ) )
+				resolved.push_back( c->SelfHref() ) ;
+			else
+				m_unresolved[c->ParentHref()].push_back( *c ) ;
 		}
-		else
-			++i ;
 	}
-	return count ;
 }
 
 void State::FromChange( const Entry& e )
@@ -266,7 +491,7 @@ bool State::Update( const Entry& e )
 		else if ( e.IsDir() || !e.Filename().empty() )
 		{
 			// first create a dummy resource and update it later
-			child = new Resource( name, e.IsDir() ? "folder" : "file" ) ;
+			child = new Resource( name, e.IsDir() ? Resource::folder_kind : Resource::file_kind ) ;
 			parent->AddChild( child ) ;
 			m_res.Insert( child ) ;
 			
@@ -300,19 +525,43 @@ void State::Read()
 	try
 	{
 		File st_file( m_root / state_file ) ;
-		m_st = ParseJson( st_file );
+		std::size_t size = st_file.Size() ;
+		if ( size > 0 )
+		{
+			MemMap map( st_file, 0, size ) ;
+			const char *data = static_cast<const char*>( map.Addr() ) ;
+
+			// the entries of the index stay in the mapping until they are used
+			// or changed, see Val. it is replaced by renaming, so the mapping
+			// stays valid after the next Write(). older versions wrote JSON,
+			// which is converted to binary by the next Write()
+			m_st = binary::IsBinary( data, size ) ?
+				binary::Map( st_file, size ) : ParseJson( std::string( data, size ) ) ;
+		}
 		m_cstamp = m_st["change_stamp"].Int() ;
+
+		Val hashes ;
+		if ( m_st.Get( "hashes", hashes ) )
+			HashCache::Inst()->Read( hashes ) ;
 	}
 	catch ( Exception& )
 	{
 	}
 
+	// keep the index updates of an interrupted sync
+	std::size_t replayed = m_journal.Replay( m_st ) ;
+	if ( replayed > 0 )
+	{
+		Log( "recovered %1% index updates of an interrupted sync", replayed, log::info ) ;
+		Checkpoint() ;
+	}
+
 	try
 	{
 		File ign_file( m_root / ignore_file ) ;
 		char ign[MAX_IGN] = { 0 };
 		int s = ign_file.Read( ign, MAX_IGN-1 ) ;
-		ParseIgnoreFile( ign, s );
+		m_ign_compiled = ParseIgnoreFile( ign, s );
 	}
 	catch ( Exception& e )
 	{
@@ -352,6 +601,7 @@ bool State::ParseIgnoreFile( const char* buffer, int size )
 			str = str.substr( 1 );
 		}
 		std::vector<std::string> parts = split( boost::regex( "/+" ), str.c_str(), str.size() );
+		m_ign_matcher.Add( parts, inc );
 		for ( int j = 0; j < (int)parts.size(); j++ )
 		{
 			if ( parts[j] == "**" )
@@ -405,16 +655,46 @@ void State::Write()
 {
 	m_st.Set( "change_stamp", Val( m_cstamp ) ) ;
 	m_st.Set( "ignore_regexp", Val( m_ign ) ) ;
+
+	HashCache *hashes = HashCache::Inst() ;
+	m_st.Set( "hashes", hashes->Write() ) ;
+	Log( "MD5 cache: %1% hits, %2% misses", hashes->Hits(), hashes->Misses(), log::verbose ) ;
 	
-	fs::path filename = m_root / state_file ;
-	std::ofstream fs( filename.string().c_str() ) ;
-	fs << m_st ;
+	Checkpoint() ;
+}
+
+/// Save the index to the state file. The file is replaced atomically, so it
+/// always holds either the old or the new index, and the journal is no
+/// longer needed once it's done.
+void State::Checkpoint()
+{
+	fs::path temp = m_root / temp_state_file ;
+	{
+		File st_file ;
+		st_file.OpenForWrite( temp, 0644 ) ;
+		binary::Write( m_st, &st_file ) ;
+		st_file.Sync() ;
+	}
+	fs::rename( temp, m_root / state_file ) ;
+	m_journal.Clear() ;
 }
 
-void State::Sync( Syncer *syncer, const Val& options )
+void State::Sync( Syncer *syncer, TransferPool *pool, const Val& options )
 {
 	// set the last sync time to the time on the client
-	m_res.Root()->Sync( syncer, &m_res, options ) ;
+	// start reading the files which may have been moved, CheckRename() needs their MD5
+	for ( ResourceTree::iterator i = m_res.begin() ; i != m_res.end() ; ++i )
+		(*i)->PrefetchMD5( &m_res ) ;
+	for ( ResourceTree::iterator i = m_res.begin() ; i != m_res.end() ; ++i )
+		(*i)->CheckMovedAway( &m_res ) ;
+
+	m_res.Root()->Sync( syncer, pool, syncer ? &m_journal : NULL, &m_res, options ) ;
+
+	// apply the index updates of the transfers still running
+	if ( pool )
+		pool->Finish() ;
+
+	HashCache::Inst()->Discard() ;
 }
 
 long State::ChangeStamp() const
@@ -422,6 +702,11 @@ long State::ChangeStamp() const
 	return m_cstamp ;
 }
 
+UploadSessions* State::Uploads()
+{
+	return &m_uploads ;
+}
+
 void State::ChangeStamp( long cstamp )
 {
 	Log( "change stamp is set to %1%", cstamp, log::verbose ) ;
@@ -19,13 +19,21 @@
 
 #pragma once
 
+#include "Journal.hh"
 #include "ResourceTree.hh"
+#include "UploadSessions.hh"
 
 #include "util/DateTime.hh"
+#include "util/DirScanner.hh"
 #include "util/FileSystem.hh"
+#include "util/IgnoreMatcher.hh"
 #include "json/Val.hh"
 
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <vector>
 #include <boost/regex.hpp>
 
 namespace gr {
@@ -36,6 +44,8 @@ class Syncer ;
 
 class Resource ;
 
+class TransferPool ;
+
 class State
 {
 public :
@@ -46,8 +56,16 @@ public :
 	~State() ;
 	
 	void FromLocal( const fs::path& p ) ;
+	void FromLocal( const fs::path& p, const std::set<std::string>& dirty ) ;
 	void FromRemote( const Entry& e ) ;
-	void ResolveEntry() ;
+	std::size_t ResolveEntry() ;
+	
+	bool HasRemote() const ;
+	void ClearRemote() ;
+	void SetRemote( Val&& remote ) ;
+	Val& Remote() ;
+	static void UpdateRemote( Val& remote, const Entry& e ) ;
+	void FromRemoteIndex() ;
 	
 	void Read() ;
 	void Write() ;
@@ -55,7 +73,7 @@ public :
 	Resource* FindByHref( const std::string& href ) ;
 	Resource* FindByID( const std::string& id ) ;
 
-	void Sync( Syncer *syncer, const Val& options ) ;
+	void Sync( Syncer *syncer, TransferPool *pool, const Val& options ) ;
 	
 	iterator begin() ;
 	iterator end() ;
@@ -63,26 +81,44 @@ public :
 	long ChangeStamp() const ;
 	void ChangeStamp( long cstamp ) ;
 
+	UploadSessions* Uploads() ;
+
+	bool IsIgnore( const std::string& filename ) ;
+
 private :
 	bool ParseIgnoreFile( const char* buffer, int size ) ;
-	void FromLocal( const fs::path& p, Resource *folder, Val& tree ) ;
+	void Checkpoint() ;
+	void FromLocal( const DirScanner::Node& dir, Resource *folder, Val& tree ) ;
+	void PrefetchMD5( const DirScanner::Node& dir, const fs::path& path, const Val& tree ) ;
+	void RememberMD5( const DirScanner::Node& file, const std::string& md5 ) ;
 	void FromChange( const Entry& e ) ;
 	bool Update( const Entry& e ) ;
-	std::size_t TryResolveEntry() ;
-
-	bool IsIgnore( const std::string& filename ) ;
+	void Resolve( const Entry& e ) ;
+	void Rescan( const fs::path& p, const std::string& rel ) ;
+	void FromScan( const DirScanner::Node& root, const fs::path& p ) ;
 	
+private :
+	typedef std::map<std::string, std::vector<Entry> > Unresolved ;
+
 private :
 	fs::path			m_root ;
 	ResourceTree		m_res ;
 	int					m_cstamp ;
 	std::string			m_ign ;
 	boost::regex		m_ign_re ;
+	IgnoreMatcher		m_ign_matcher ;
+	bool				m_ign_compiled ;
 	Val					m_st ;
+	Journal				m_journal ;
+	UploadSessions		m_uploads ;
 	bool				m_force ;
 	bool				m_ign_changed ;
 	
-	std::list<Entry>	m_unresolved ;
+	/// remote entries waiting for their parent, by the href of the parent
+	Unresolved			m_unresolved ;
+
+	/// the local tree, kept between syncs by FromLocal( p, dirty )
+	DirScanner::Node	m_scan ;
 } ;
 
 } // end of namespace gr
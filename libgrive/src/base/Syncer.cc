@@ -20,16 +20,94 @@
 #include "Syncer.hh"
 #include "Resource.hh"
 #include "Entry.hh"
+#include "Feed.hh"
 #include "http/Agent.hh"
 #include "http/Header.hh"
 #include "http/Download.hh"
+#include "http/Error.hh"
+#include "util/Crypt.hh"
+#include "util/File.hh"
 #include "util/OS.hh"
 #include "util/log/Log.hh"
 
+#include <boost/bind.hpp>
+#include <boost/exception/get_error_info.hpp>
+
+#include <algorithm>
+#include <vector>
+
 namespace gr {
 
+// downloads are written to ".<name>.grive_part" and renamed when complete
+const std::string part_suffix = ".grive_part" ;
+
+// a file is only split if each range gets at least this much of it
+const u64_t min_range_size = 4 * 1024 * 1024 ;
+
+// a download is given up after this many failures in a row without progress
+const int max_download_failures = 10 ;
+
+namespace
+{
+	struct Range
+	{
+		Range( File *file, u64_t begin, u64_t end ) :
+			dl( file, begin ), end( end ), code( 0 ), done( false )
+		{
+		}
+
+		http::Download		dl ;
+		u64_t				end ;
+		long				code ;
+		std::exception_ptr	error ;
+		bool				done ;
+	} ;
+
+	void RangeDone( Range *range, long code, std::exception_ptr error )
+	{
+		range->code		= code ;
+		range->error	= error ;
+	}
+
+	/// Transfers which were cut off and errors of the server are worth resuming.
+	/// The other HTTP errors, e.g. 404 or 416 when the file shrank, stay the same
+	/// however often the request is sent again. 5xx and 429 responses are already
+	/// retried by AuthAgent, but may still come through after a token refresh.
+	bool IsTemporary( const http::Error& e )
+	{
+		const int *code = boost::get_error_info<http::HttpResponseCode>( e ) ;
+		return boost::get_error_info<http::CurlCode>( e ) != 0 || ( code && *code >= 500 ) ;
+	}
+
+	bool IsTemporary( std::exception_ptr error )
+	{
+		try
+		{
+			std::rethrow_exception( error ) ;
+		}
+		catch ( http::Error& e )
+		{
+			return IsTemporary( e ) ;
+		}
+		catch ( ... )
+		{
+			return false ;
+		}
+	}
+
+	u64_t Received( const std::vector< std::unique_ptr<Range> >& ranges )
+	{
+		u64_t total = 0 ;
+		for ( std::size_t i = 0 ; i < ranges.size() ; i++ )
+			total += ranges[i]->dl.Offset() ;
+		return total ;
+	}
+}
+
 Syncer::Syncer( http::Agent *http ):
-	m_http( http )
+	m_http( http ),
+	m_uploads( NULL ),
+	m_ranges( 1 )
 {
 }
 
@@ -38,17 +116,253 @@ http::Agent* Syncer::Agent() const
 	return m_http;
 }
 
+/// Where to keep the sessions of resumable uploads. Without it, interrupted
+/// uploads start again from the beginning.
+void Syncer::SetUploadSessions( UploadSessions *sessions )
+{
+	m_uploads = sessions;
+}
+
+/// Splits downloads of large files into \a count ranges requested at the same
+/// time. They only run in parallel if the agent has an event loop, i.e. it is
+/// built on CurlMultiAgent.
+void Syncer::SetDownloadRanges( unsigned count )
+{
+	m_ranges = std::max( count, 1u );
+}
+
+/// The file a download of \a file is written to before it is complete.
+fs::path Syncer::PartFile( const fs::path& file )
+{
+	return file.parent_path() / ( "." + file.filename().string() + part_suffix ) ;
+}
+
+/// Downloads the content of \a res to \a file. It is written to a part file in the
+/// same directory first, which is renamed to \a file once complete, so a failed
+/// download never replaces the old content. A part file left by a failed download
+/// is continued by the next one with a Range request.
 void Syncer::Download( Resource *res, const fs::path& file )
 {
-	http::Download dl( file.string(), http::Download::NoChecksum() ) ;
-	long r = m_http->Get( res->ContentSrc(), &dl, http::Header(), res->Size() ) ;
-	if ( r <= 400 )
+	fs::path part = PartFile( file ) ;
+	u64_t size = res->Size() ;
+
+	// a file put together from parts is checked: they may come from an older
+	// revision of the file, or from a server that doesn't handle ranges properly
+	bool verify = true ;
+	if ( m_ranges > 1 && size >= 2 * min_range_size && !fs::exists( part ) )
+		DownloadRanges( res, part ) ;
+	else
+		verify = DownloadResume( res, part ) ;
+
+	if ( verify && !res->MD5().empty() && crypt::MD5::Get( part ) != res->MD5() )
 	{
-		if ( res->ServerTime() != DateTime() )
-			os::SetFileTime( file, res->ServerTime() ) ;
-		else
-			Log( "encountered zero date time after downloading %1%", file, log::warning ) ;
+		Log( "download of %1% in parts is corrupted, downloading it again", file, log::warning ) ;
+		fs::remove( part ) ;
+		DownloadResume( res, part ) ;
 	}
+
+	if ( res->ServerTime() != DateTime() )
+		os::SetFileTime( part, res->ServerTime() ) ;
+	else
+		Log( "encountered zero date time after downloading %1%", file, log::warning ) ;
+
+	if ( fs::exists( file ) )
+		fs::permissions( part, fs::status( file ).permissions() ) ;
+	fs::rename( part, file ) ;
+}
+
+/// Downloads the content of \a res to \a part in one request, starting after what
+/// it already contains. Requests which are cut off or fail on the server are continued
+/// where they stopped, other errors are thrown at once. Returns
+/// true if any of the content was received before this request or by a retry.
+bool Syncer::DownloadResume( Resource *res, const fs::path& part )
+{
+	u64_t size = res->Size() ;
+
+	File file ;
+	file.OpenForUpdate( part ) ;
+	u64_t offset = file.Size() ;
+	if ( offset > size )
+	{
+		file.Truncate( 0 ) ;
+		offset = 0 ;
+	}
+	else if ( offset > 0 )
+		Log( "resuming download of %1% at %2% bytes", res->RelPath(), offset, log::info ) ;
+
+	bool resumed = offset > 0 ;
+	int failures = 0 ;
+	while ( offset == 0 || offset < size )
+	{
+		http::Download dl( &file, offset ) ;
+		http::Header hdr ;
+		if ( offset > 0 )
+			hdr.Add( "Range: bytes=" + std::to_string( offset ) + "-" ) ;
+
+		try
+		{
+			long code = m_http->Get( res->ContentSrc(), &dl, hdr, size - offset ) ;
+			if ( offset > 0 && code != 206 )
+			{
+				// the range was ignored and the whole content was sent
+				Log( "server does not support ranges, downloading %1% again", res->RelPath(), log::warning ) ;
+				file.Truncate( 0 ) ;
+				offset = 0 ;
+				resumed = false ;
+				continue ;
+			}
+			break ;
+		}
+		catch ( http::Error& e )
+		{
+			if ( !IsTemporary( e ) )
+				throw ;
+			if ( dl.Offset() > offset )
+				failures = 0 ;
+			if ( ++failures > max_download_failures )
+				throw ;
+
+			offset = dl.Offset() ;
+			resumed = true ;
+			Log( "download of %1% failed at %2% bytes, resuming in %3% seconds",
+				res->RelPath(), offset, failures, log::warning ) ;
+			os::Sleep( failures ) ;
+		}
+	}
+	return resumed ;
+}
+
+/// Downloads the content of \a res to \a part in m_ranges parts requested at the
+/// same time, and written to their place in the file with pwrite(). Ranges which
+/// are cut off or fail on the server are requested again from where they stopped.
+void Syncer::DownloadRanges( Resource *res, const fs::path& part )
+{
+	u64_t size = res->Size() ;
+
+	File file( part, 0600 ) ;
+	file.Truncate( size ) ;
+
+	u64_t length = std::max( ( size + m_ranges - 1 ) / m_ranges, min_range_size ) ;
+	std::vector< std::unique_ptr<Range> > ranges ;
+	for ( u64_t begin = 0 ; begin < size ; begin += length )
+		ranges.push_back( std::unique_ptr<Range>( new Range( &file, begin, std::min( begin + length, size ) ) ) ) ;
+
+	Log( "downloading %1% in %2% ranges", res->RelPath(), ranges.size(), log::verbose ) ;
+
+	int failures = 0 ;
+	try
+	{
+		while ( true )
+		{
+			u64_t before = Received( ranges ) ;
+			for ( std::size_t i = 0 ; i < ranges.size() ; i++ )
+			{
+				Range *r = ranges[i].get() ;
+				if ( r->done )
+					continue ;
+
+				http::Header hdr ;
+				hdr.Add( "Range: bytes=" + std::to_string( r->dl.Offset() ) + "-" + std::to_string( r->end - 1 ) ) ;
+				r->code		= 0 ;
+				r->error	= std::exception_ptr() ;
+				m_http->RequestAsync( "GET", res->ContentSrc(), NULL, &r->dl, hdr,
+					boost::bind( &RangeDone, r, _1, _2 ) ) ;
+			}
+			m_http->Wait() ;
+
+			bool done = true ;
+			std::exception_ptr error ;
+			for ( std::size_t i = 0 ; i < ranges.size() ; i++ )
+			{
+				Range *r = ranges[i].get() ;
+				if ( r->done )
+					continue ;
+
+				if ( r->error && !IsTemporary( r->error ) )
+					std::rethrow_exception( r->error ) ;
+				if ( r->error )
+					error = r->error ;
+				else if ( r->code != 206 )
+				{
+					// the server sent the whole content for the range
+					Log( "server does not support ranges, downloading %1% again", res->RelPath(), log::warning ) ;
+					file.Close() ;
+					fs::remove( part ) ;
+					DownloadResume( res, part ) ;
+					return ;
+				}
+				r->done = !r->error && r->dl.Offset() >= r->end ;
+				done = done && r->done ;
+			}
+			if ( done )
+				break ;
+
+			if ( Received( ranges ) > before )
+				failures = 0 ;
+			if ( ++failures > max_download_failures )
+			{
+				if ( error )
+					std::rethrow_exception( error ) ;
+				BOOST_THROW_EXCEPTION( http::Error() << http::Url( res->ContentSrc() ) ) ;
+			}
+
+			Log( "download of %1% failed, resuming in %2% seconds", res->RelPath(), failures, log::warning ) ;
+			os::Sleep( failures ) ;
+		}
+	}
+	catch ( ... )
+	{
+		// keep what was received from the start of the file, so that the
+		// next download can continue it
+		u64_t complete = 0 ;
+		for ( std::size_t i = 0 ; i < ranges.size() ; i++ )
+		{
+			complete = ranges[i]->dl.Offset() ;
+			if ( !ranges[i]->done )
+				break ;
+		}
+		file.Truncate( complete ) ;
+		throw ;
+	}
+}
+
+/// Deletes \a res in the server, and calls \a done when finished. Queued
+/// operations may be sent together, up to the next Flush(), so they must not
+/// depend on each other. By default they are run right away.
+void Syncer::QueueDelete( Resource *res, const Done& done )
+{
+	DeleteRemote( res );
+	done( std::exception_ptr() );
+}
+
+/// Creates the folder \a res in the server, and calls \a done when finished.
+/// It may not be created even without error, e.g. in a read-only folder. See
+/// QueueDelete().
+void Syncer::QueueCreate( Resource *res, const Done& done )
+{
+	Create( res );
+	done( std::exception_ptr() );
+}
+
+/// Moves \a res in the server, and calls \a done when finished. See QueueDelete().
+void Syncer::QueueMove( Resource* res, Resource* newParent, const std::string& newFilename, const Done& done )
+{
+	Move( res, newParent, newFilename );
+	done( std::exception_ptr() );
+}
+
+/// Sends the queued operations, and waits until they are finished.
+void Syncer::Flush()
+{
+}
+
+/// Splits the listing of GetAll() into about \a count feeds that can be read at
+/// the same time. By default it isn't split.
+std::vector< std::unique_ptr<Feed> > Syncer::GetAllParts( std::size_t count )
+{
+	std::vector< std::unique_ptr<Feed> > parts;
+	parts.push_back( GetAll() );
+	return parts;
 }
 
 void Syncer::AssignIDs( Resource *res, const Entry& remote )
@@ -21,6 +21,9 @@
 
 #include "util/FileSystem.hh"
 
+#include <boost/function.hpp>
+
+#include <exception>
 #include <memory>
 #include <string>
 #include <vector>
@@ -41,14 +44,25 @@ class Entry ;
 
 class Feed ;
 
+class UploadSessions ;
+
 /*!	\brief	A Syncer incapsulates all resource-related upload/download/edit methods */
 class Syncer
 {
+public :
+	/// Completion of a queued operation. It receives the exception the operation
+	/// failed with, or null if it didn't.
+	typedef boost::function<void ( std::exception_ptr )> Done;
+
 public :
 
 	Syncer( http::Agent *http );
 
 	http::Agent* Agent() const;
+	void SetUploadSessions( UploadSessions *sessions );
+	void SetDownloadRanges( unsigned count );
+
+	static fs::path PartFile( const fs::path& file );
 
 	virtual void DeleteRemote( Resource *res ) = 0;
 	virtual void Download( Resource *res, const fs::path& file );
@@ -56,17 +70,29 @@ public :
 	virtual bool Create( Resource *res ) = 0;
 	virtual bool Move( Resource* res, Resource* newParent, std::string newFilename ) = 0;
 
+	virtual void QueueDelete( Resource *res, const Done& done );
+	virtual void QueueCreate( Resource *res, const Done& done );
+	virtual void QueueMove( Resource* res, Resource* newParent, const std::string& newFilename, const Done& done );
+	virtual void Flush();
+
 	virtual std::unique_ptr<Feed> GetFolders() = 0;
 	virtual std::unique_ptr<Feed> GetAll() = 0;
+	virtual std::vector< std::unique_ptr<Feed> > GetAllParts( std::size_t count );
 	virtual std::unique_ptr<Feed> GetChanges( long min_cstamp ) = 0;
 	virtual long GetChangeStamp( long min_cstamp ) = 0;
 
 protected:
 
 	http::Agent *m_http;
+	UploadSessions *m_uploads;
+	unsigned m_ranges;
 
 	void AssignIDs( Resource *res, const Entry& remote );
 
+private:
+	bool DownloadResume( Resource *res, const fs::path& part );
+	void DownloadRanges( Resource *res, const fs::path& part );
+
 } ;
 
 } // end of namespace gr
@@ -0,0 +1,163 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "TransferPool.hh"
+
+#include "util/log/Log.hh"
+
+#include <cassert>
+
+namespace gr {
+
+TransferPool::TransferPool( const std::vector<Syncer*>& workers ) :
+	m_running	( 0 ),
+	m_stop		( false )
+{
+	for ( std::vector<Syncer*>::const_iterator i = workers.begin() ; i != workers.end() ; ++i )
+		m_threads.push_back( std::thread( &TransferPool::Run, this, *i ) ) ;
+
+	if ( !m_threads.empty() )
+		Log( "running transfers in %1% parallel jobs", m_threads.size(), log::verbose ) ;
+}
+
+TransferPool::~TransferPool()
+{
+	// jobs still in the queue are dropped, their completions are never run
+	Stop() ;
+}
+
+std::size_t TransferPool::Size() const
+{
+	return m_threads.size() ;
+}
+
+void TransferPool::Push( Syncer *syncer, const Job& job, const Done& done )
+{
+	if ( m_threads.empty() )
+	{
+		done( job( syncer ) ) ;
+		return ;
+	}
+
+	Task t ;
+	t.job		= job ;
+	t.done		= done ;
+	t.result	= false ;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		m_queue.push_back( t ) ;
+	}
+	m_wake.notify_one() ;
+
+	// opportunistically apply what is already finished
+	Poll() ;
+}
+
+/// Runs the completion handlers of the jobs finished so far.
+void TransferPool::Poll()
+{
+	std::deque<Task> done ;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		done.swap( m_done ) ;
+	}
+	Complete( done ) ;
+}
+
+/// Waits for all queued jobs and runs their completion handlers.
+void TransferPool::Finish()
+{
+	while ( true )
+	{
+		std::deque<Task> done ;
+		{
+			std::unique_lock<std::mutex> lock( m_mutex ) ;
+			while ( m_done.empty() && ( !m_queue.empty() || m_running > 0 ) )
+				m_idle.wait( lock ) ;
+
+			if ( m_done.empty() )
+				break ;
+			done.swap( m_done ) ;
+		}
+		Complete( done ) ;
+	}
+}
+
+void TransferPool::Complete( std::deque<Task>& done )
+{
+	while ( !done.empty() )
+	{
+		Task t = done.front() ;
+		done.pop_front() ;
+
+		// errors the job didn't handle itself are propagated to the caller, as
+		// they would have been when running the job in the calling thread
+		if ( t.error )
+			std::rethrow_exception( t.error ) ;
+
+		t.done( t.result ) ;
+	}
+}
+
+void TransferPool::Run( Syncer *syncer )
+{
+	std::unique_lock<std::mutex> lock( m_mutex ) ;
+	while ( true )
+	{
+		while ( !m_stop && m_queue.empty() )
+			m_wake.wait( lock ) ;
+
+		if ( m_stop )
+			break ;
+
+		Task t = m_queue.front() ;
+		m_queue.pop_front() ;
+		m_running++ ;
+		lock.unlock() ;
+
+		try
+		{
+			t.result = t.job( syncer ) ;
+		}
+		catch ( ... )
+		{
+			t.error = std::current_exception() ;
+		}
+
+		lock.lock() ;
+		m_running-- ;
+		m_done.push_back( t ) ;
+		m_idle.notify_all() ;
+	}
+}
+
+void TransferPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		m_stop = true ;
+	}
+	m_wake.notify_all() ;
+
+	for ( std::vector<std::thread>::iterator i = m_threads.begin() ; i != m_threads.end() ; ++i )
+		i->join() ;
+	m_threads.clear() ;
+}
+
+} // end of namespace gr
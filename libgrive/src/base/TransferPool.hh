@@ -0,0 +1,85 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include <boost/function.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gr {
+
+class Syncer ;
+
+/*!	\brief	A pool of worker threads running file transfers
+
+	Each worker owns a Syncer (and thus its own HTTP connection). Jobs are run
+	by any free worker, while their completion handlers are always run on the
+	thread calling Poll() or Finish(), so that the resource tree and the state
+	index are only ever touched from one thread.
+
+	A pool without workers runs every job and its completion immediately in Push().
+*/
+class TransferPool
+{
+public :
+	typedef boost::function<bool ( Syncer* )>	Job ;
+	typedef boost::function<void ( bool )>		Done ;
+
+public :
+	explicit TransferPool( const std::vector<Syncer*>& workers ) ;
+	~TransferPool() ;
+
+	std::size_t Size() const ;
+
+	void Push( Syncer *syncer, const Job& job, const Done& done ) ;
+	void Poll() ;
+	void Finish() ;
+
+private :
+	struct Task
+	{
+		Job					job ;
+		Done				done ;
+		bool				result ;
+		std::exception_ptr	error ;
+	} ;
+
+	void Run( Syncer *syncer ) ;
+	void Complete( std::deque<Task>& done ) ;
+	void Stop() ;
+
+private :
+	std::vector<std::thread>	m_threads ;
+
+	std::mutex					m_mutex ;
+	std::condition_variable		m_wake ;
+	std::condition_variable		m_idle ;
+	std::deque<Task>			m_queue ;
+	std::deque<Task>			m_done ;
+	std::size_t					m_running ;
+	bool						m_stop ;
+} ;
+
+} // end of namespace gr
@@ -0,0 +1,106 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "UploadSessions.hh"
+
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "util/File.hh"
+#include "util/log/Log.hh"
+
+#include <fstream>
+#include <iterator>
+
+namespace gr {
+
+UploadSessions::UploadSessions( const fs::path& file ) :
+	m_file		( file ),
+	m_sessions	( Val::object_type )
+{
+	std::ifstream in( m_file.string().c_str() ) ;
+	std::string json( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() ) ;
+	if ( json.empty() )
+		return ;
+
+	try
+	{
+		Val sessions = ParseJson( json ) ;
+		if ( sessions.Is<Val::Object>() )
+			m_sessions.Swap( sessions ) ;
+	}
+	catch ( Exception& )
+	{
+		// they will only be started again
+		Log( "Ignoring unreadable upload sessions in %1%", m_file, log::warning ) ;
+	}
+}
+
+/// Finds the session of the file at \a path, relative to the root folder.
+bool UploadSessions::Find( const std::string& path, Session& session ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Val s ;
+	if ( !m_sessions.Get( path, s ) )
+		return false ;
+
+	session.uri		= s["uri"].Str() ;
+	session.size	= s["size"].U64() ;
+	session.ctime	= DateTime( s["ctime"].U64(), s["ctime_ns"].U64() ) ;
+	return true ;
+}
+
+void UploadSessions::Save( const std::string& path, const Session& session )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Val s ;
+	s.Add( "uri",		Val( session.uri ) ) ;
+	s.Add( "size",		Val( session.size ) ) ;
+	s.Add( "ctime",		Val( session.ctime.Sec() ) ) ;
+	s.Add( "ctime_ns",	Val( session.ctime.NanoSec() ) ) ;
+	m_sessions.Set( path, s ) ;
+	Write() ;
+}
+
+void UploadSessions::Remove( const std::string& path )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	if ( m_sessions.Del( path ) )
+		Write() ;
+}
+
+void UploadSessions::Write()
+{
+	if ( m_sessions.AsObject().empty() )
+	{
+		fs::remove( m_file ) ;
+		return ;
+	}
+
+	fs::path temp = m_file.string() + ".tmp" ;
+	{
+		std::string json = WriteJson( m_sessions ) ;
+		File out ;
+		out.OpenForWrite( temp, 0600 ) ;
+		out.Write( json.c_str(), json.size() ) ;
+		out.Sync() ;
+	}
+	fs::rename( temp, m_file ) ;
+}
+
+} // end of namespace gr
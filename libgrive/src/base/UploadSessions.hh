@@ -0,0 +1,69 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "json/Val.hh"
+#include "util/DateTime.hh"
+#include "util/FileSystem.hh"
+#include "util/Types.hh"
+
+#include <mutex>
+#include <string>
+
+namespace gr {
+
+/*!	\brief	Resumable uploads which are still in progress
+
+	When a large file is uploaded in chunks, the URI of its upload session is
+	saved here, so that a run which is interrupted can be continued by the
+	next one. The session is only reused if the file still has the size and
+	ctime it had when the upload started.
+
+	The sessions are saved right away, next to the state file, since an upload
+	may be interrupted by anything. Uploads run in the threads of the
+	TransferPool, so all functions may be called from several threads.
+*/
+class UploadSessions
+{
+public :
+	struct Session
+	{
+		std::string	uri ;
+		u64_t		size ;
+		DateTime	ctime ;
+	} ;
+
+public :
+	explicit UploadSessions( const fs::path& file ) ;
+
+	bool Find( const std::string& path, Session& session ) const ;
+	void Save( const std::string& path, const Session& session ) ;
+	void Remove( const std::string& path ) ;
+
+private :
+	void Write() ;
+
+private :
+	fs::path			m_file ;
+	mutable std::mutex	m_mutex ;
+	Val					m_sessions ;
+} ;
+
+} // end of namespace gr
@@ -0,0 +1,301 @@
+/*
+	REST API batch requests
+	Copyright (C) 2015  Vitaliy Filippov
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "Batch.hh"
+
+#include "http/Agent.hh"
+#include "http/Error.hh"
+#include "http/StringResponse.hh"
+#include "json/JsonParser.hh"
+#include "util/OS.hh"
+#include "util/log/Log.hh"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/exception/all.hpp>
+
+#include <cassert>
+#include <cstdlib>
+#include <map>
+
+namespace gr { namespace v2 {
+
+const std::string batch_url			= "https://www.googleapis.com/batch/drive/v2" ;
+const std::string batch_boundary	= "grive_batch" ;
+
+// the Drive API doesn't accept more requests in one batch
+const std::size_t max_batch_size	= 100 ;
+
+// requests failing with temporary errors are sent this many times more at most
+const int max_batch_retries			= 5 ;
+
+namespace
+{
+	/// The path of \a url on its host, which is what a sub-request contains.
+	std::string PathOf( const std::string& url )
+	{
+		std::size_t host = url.find( "://" ) ;
+		std::size_t path = url.find( '/', host == std::string::npos ? 0 : host + 3 ) ;
+		return path == std::string::npos ? "/" : url.substr( path ) ;
+	}
+
+	/// Splits a MIME part or an HTTP message into its headers and body.
+	void SplitHead( const std::string& msg, std::string& head, std::string& body )
+	{
+		std::size_t end = msg.find( "\r\n\r\n" ) ;
+		std::size_t sep = 4 ;
+		if ( end == std::string::npos )
+		{
+			end = msg.find( "\n\n" ) ;
+			sep = 2 ;
+		}
+		if ( end == std::string::npos )
+		{
+			head = msg ;
+			body.clear() ;
+		}
+		else
+		{
+			head = msg.substr( 0, end ) ;
+			body = msg.substr( end + sep ) ;
+		}
+	}
+
+	std::exception_ptr MakeError( const Batch::Response *resp, const std::string& url, const http::Header& hdr )
+	{
+		try
+		{
+			if ( resp )
+				BOOST_THROW_EXCEPTION(
+					http::Error()
+						<< http::HttpResponseCode( resp->code )
+						<< http::HttpResponseHeaders( resp->headers )
+						<< http::HttpResponseText( resp->body )
+						<< http::Url( url )
+						<< http::HttpRequestHeaders( hdr ) ) ;
+			else
+				BOOST_THROW_EXCEPTION(
+					http::Error()
+						<< http::HttpResponseText( "no response in batch" )
+						<< http::Url( url )
+						<< http::HttpRequestHeaders( hdr ) ) ;
+		}
+		catch ( http::Error& )
+		{
+			return std::current_exception() ;
+		}
+		return std::exception_ptr() ;
+	}
+}
+
+Batch::Batch( http::Agent *http ) :
+	m_http( http )
+{
+	assert( http != 0 ) ;
+}
+
+/// Adds a request to the batch. \a json is its body, if not empty. \a done is
+/// called when the response is received, at the latest in the next Flush().
+void Batch::Add(
+	const std::string&	method,
+	const std::string&	url,
+	const std::string&	json,
+	const http::Header&	hdr,
+	const Callback&		done )
+{
+	Request req ;
+	req.method	= method ;
+	req.url		= url ;
+	req.json	= json ;
+	req.hdr		= hdr ;
+	req.done	= done ;
+	req.retries	= 0 ;
+	m_queue.push_back( req ) ;
+
+	if ( m_queue.size() >= max_batch_size )
+		Flush() ;
+}
+
+/// Sends all the requests and calls their callbacks.
+void Batch::Flush()
+{
+	while ( !m_queue.empty() )
+	{
+		std::size_t count = std::min( m_queue.size(), max_batch_size ) ;
+		std::vector<Request> requests( m_queue.begin(), m_queue.begin() + count ) ;
+		m_queue.erase( m_queue.begin(), m_queue.begin() + count ) ;
+		Send( requests ) ;
+	}
+}
+
+std::size_t Batch::Size() const
+{
+	return m_queue.size() ;
+}
+
+void Batch::Send( std::vector<Request>& requests )
+{
+	std::string body ;
+	for ( std::size_t i = 0 ; i < requests.size() ; i++ )
+	{
+		const Request& req = requests[i] ;
+		body += "--" + batch_boundary + "\r\n"
+			"Content-Type: application/http\r\n"
+			"Content-ID: <item" + std::to_string( i ) + ">\r\n\r\n" +
+			req.method + " " + PathOf( req.url ) + " HTTP/1.1\r\n" ;
+		for ( http::Header::iterator h = req.hdr.begin() ; h != req.hdr.end() ; ++h )
+			body += *h + "\r\n" ;
+		if ( !req.json.empty() )
+			body += "Content-Type: application/json; charset=UTF-8\r\n" ;
+		body += "\r\n" + req.json + "\r\n" ;
+	}
+	body += "--" + batch_boundary + "--\r\n" ;
+
+	http::Header hdr ;
+	hdr.Add( "Content-Type: multipart/mixed; boundary=" + batch_boundary ) ;
+
+	Trace( "sending %1% requests in a batch", requests.size() ) ;
+
+	// if the batch itself fails, so do all of its requests
+	http::StringResponse str ;
+	std::vector<Response> responses ;
+	std::exception_ptr error ;
+	try
+	{
+		m_http->Post( batch_url, body, &str, hdr ) ;
+		responses = Parse( str.Response(), Boundary( m_http->ResponseHeader( "Content-Type" ) ) ) ;
+	}
+	catch ( http::Error& )
+	{
+		error = std::current_exception() ;
+	}
+
+	std::map<std::string, const Response*> by_id ;
+	for ( std::vector<Response>::const_iterator i = responses.begin() ; i != responses.end() ; ++i )
+		by_id[i->id] = &*i ;
+
+	std::vector<Request> retry ;
+	for ( std::size_t i = 0 ; i < requests.size() ; i++ )
+	{
+		Request& req = requests[i] ;
+		if ( error )
+		{
+			req.done( Val(), error ) ;
+			continue ;
+		}
+
+		std::map<std::string, const Response*>::iterator r = by_id.find( "response-item" + std::to_string( i ) ) ;
+		const Response *resp = r != by_id.end() ? r->second : NULL ;
+		if ( resp && resp->code >= 200 && resp->code < 300 )
+		{
+			Val result ;
+			if ( boost::starts_with( boost::trim_left_copy( resp->body ), "{" ) )
+				result = ParseJson( resp->body ) ;
+			req.done( result, std::exception_ptr() ) ;
+		}
+		else if ( resp && IsTemporary( *resp ) && req.retries < max_batch_retries )
+		{
+			req.retries++ ;
+			retry.push_back( req ) ;
+		}
+		else
+			req.done( Val(), MakeError( resp, req.url, req.hdr ) ) ;
+	}
+
+	if ( !retry.empty() )
+	{
+		int interval = retry.front().retries ;
+		Log( "%1% requests of a batch failed due to temporary errors. retrying in %2% seconds",
+			retry.size(), interval, log::warning ) ;
+		os::Sleep( interval ) ;
+		m_queue.insert( m_queue.begin(), retry.begin(), retry.end() ) ;
+	}
+}
+
+/// Errors which AuthAgent would retry if the request had been sent on its own.
+bool Batch::IsTemporary( const Response& response )
+{
+	return response.code == 500 || response.code == 503 || response.code == 429 ||
+		( response.code == 403 && response.body.find( "ateLimitExceeded\"" ) != std::string::npos ) ;
+}
+
+/// Extracts the boundary of a multipart Content-Type header.
+std::string Batch::Boundary( const std::string& content_type )
+{
+	std::vector<std::string> params ;
+	boost::split( params, content_type, boost::is_any_of( ";" ) ) ;
+	for ( std::vector<std::string>::iterator i = params.begin() ; i != params.end() ; ++i )
+	{
+		std::string param = boost::trim_copy( *i ) ;
+		if ( boost::istarts_with( param, "boundary=" ) )
+			return boost::trim_copy_if( param.substr( 9 ), boost::is_any_of( "\"" ) ) ;
+	}
+	return "" ;
+}
+
+/// Splits the multipart/mixed response of a batch request into the responses
+/// of its requests.
+std::vector<Batch::Response> Batch::Parse( const std::string& body, const std::string& boundary )
+{
+	std::vector<Response> result ;
+	if ( boundary.empty() )
+		return result ;
+
+	const std::string delim = "--" + boundary ;
+	std::size_t pos = body.find( delim ) ;
+	while ( pos != std::string::npos )
+	{
+		pos += delim.size() ;
+
+		// the closing delimiter
+		if ( body.compare( pos, 2, "--" ) == 0 )
+			break ;
+
+		std::size_t next = body.find( delim, pos ) ;
+		std::string part = body.substr( pos, next == std::string::npos ? std::string::npos : next - pos ) ;
+		pos = next ;
+
+		std::string part_head, msg ;
+		SplitHead( boost::trim_left_copy( part ), part_head, msg ) ;
+
+		Response resp ;
+		resp.id = boost::trim_copy_if( http::FindHeader( part_head, "Content-ID" ), boost::is_any_of( "<>" ) ) ;
+
+		// the embedded HTTP response: status line, headers and body
+		std::string head ;
+		SplitHead( msg, head, resp.body ) ;
+		std::size_t eol = head.find( '\n' ) ;
+		std::string status = head.substr( 0, eol ) ;
+		resp.headers = eol == std::string::npos ? "" : head.substr( eol + 1 ) ;
+
+		std::size_t space = status.find( ' ' ) ;
+		resp.code = space == std::string::npos ? 0 : std::atol( status.c_str() + space + 1 ) ;
+
+		// the part ends with the line break before the next delimiter
+		if ( boost::ends_with( resp.body, "\r\n" ) )
+			resp.body.erase( resp.body.size() - 2 ) ;
+		else if ( boost::ends_with( resp.body, "\n" ) )
+			resp.body.erase( resp.body.size() - 1 ) ;
+
+		result.push_back( resp ) ;
+	}
+	return result ;
+}
+
+} } // end of namespace gr::v2
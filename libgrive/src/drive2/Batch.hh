@@ -0,0 +1,103 @@
+/*
+	REST API batch requests
+	Copyright (C) 2015  Vitaliy Filippov
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "http/Header.hh"
+#include "json/Val.hh"
+
+#include <boost/function.hpp>
+
+#include <deque>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace gr {
+
+namespace http
+{
+	class Agent ;
+}
+
+namespace v2 {
+
+/*!	\brief	metadata requests sent together in batch requests
+
+	Requests added to a Batch are sent in one multipart/mixed request to the batch
+	endpoint of the Drive API when Flush() is called, or as soon as the batch is
+	full. The server may run them in any order, so only independent requests should
+	be in the same batch.
+
+	The sub-responses are passed to the callbacks of their requests one by one, so
+	each request may fail on its own. Requests failing with a temporary error are
+	sent again with the next batch.
+*/
+class Batch
+{
+public :
+	/// Called with the JSON response of the request, or with the exception
+	/// the request would have thrown if sent on its own.
+	typedef boost::function<void ( const Val&, std::exception_ptr )> Callback ;
+
+	/// One part of the response of a batch request.
+	struct Response
+	{
+		std::string	id ;
+		long		code ;
+		std::string	headers ;
+		std::string	body ;
+	} ;
+
+public :
+	explicit Batch( http::Agent *http ) ;
+
+	void Add(
+		const std::string&	method,
+		const std::string&	url,
+		const std::string&	json,
+		const http::Header&	hdr,
+		const Callback&		done ) ;
+	void Flush() ;
+	std::size_t Size() const ;
+
+	static std::string Boundary( const std::string& content_type ) ;
+	static std::vector<Response> Parse( const std::string& body, const std::string& boundary ) ;
+
+private :
+	struct Request
+	{
+		std::string		method ;
+		std::string		url ;
+		std::string		json ;
+		http::Header	hdr ;
+		Callback		done ;
+		int				retries ;
+	} ;
+
+	void Send( std::vector<Request>& requests ) ;
+	static bool IsTemporary( const Response& response ) ;
+
+private :
+	http::Agent				*m_http ;
+	std::deque<Request>		m_queue ;
+} ;
+
+} } // end of namespace gr::v2
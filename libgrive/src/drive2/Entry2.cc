@@ -31,6 +31,20 @@
 
 namespace gr { namespace v2 {
 
+/// The fields of a file resource read by Update(). Listings only request these,
+/// with the "fields" parameter, so they must be kept in sync with Update().
+std::string Entry2::FileFields()
+{
+	return "kind,id,title,etag,selfLink,modifiedDate,mimeType,editable,labels/trashed,"
+		"md5Checksum,fileSize,downloadUrl,parents(isRoot,parentLink)" ;
+}
+
+/// The fields of a change resource read by Update().
+std::string Entry2::ChangeFields()
+{
+	return "kind,id,deleted,fileId,file(" + FileFields() + ")" ;
+}
+
 /// construct an entry for remote, from "file" JSON object - Drive REST API
 Entry2::Entry2( const Val& item )
 {
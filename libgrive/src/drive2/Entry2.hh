@@ -31,6 +31,10 @@ class Entry2: public Entry
 {
 public :
 	explicit Entry2( const Val& item ) ;
+
+	static std::string FileFields() ;
+	static std::string ChangeFields() ;
+
 private :
 	void Update( const Val& item ) ;
 } ;
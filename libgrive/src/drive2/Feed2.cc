@@ -24,9 +24,10 @@
 #include "http/Agent.hh"
 #include "http/Header.hh"
 #include "json/Val.hh"
-#include "json/ValResponse.hh"
+#include "json/ItemResponse.hh"
 
 #include <iostream>
+#include <boost/bind.hpp>
 #include <boost/format.hpp>
 
 namespace gr { namespace v2 {
@@ -45,18 +46,21 @@ bool Feed2::GetNext( http::Agent *http )
 	if ( m_next.empty() )
 		return false ;
 	
-	http::ValResponse out ;
+	// entries are decoded while the page is being received, without
+	// building the whole "items" array in memory
+	m_entries.clear() ;
+	http::ItemResponse out( "items", boost::bind( &Feed2::AddEntry, this, _1 ) ) ;
 	http->Get( m_next, &out, http::Header(), 0 ) ;
 	Val m_content = out.Response() ;
 	
-	Val::Array items = m_content["items"].AsArray() ;
-	m_entries.clear() ;
-	for ( Val::Array::iterator i = items.begin() ; i != items.end() ; ++i )
-		m_entries.push_back( Entry2( *i ) );
-	
 	Val url ;
 	m_next = m_content.Get( "nextLink", url ) ? url : std::string( "" ) ;
 	return true ;
 }
 
+void Feed2::AddEntry( const Val& item )
+{
+	m_entries.push_back( Entry2( item ) ) ;
+}
+
 } } // end of namespace gr::v2
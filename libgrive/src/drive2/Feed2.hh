@@ -25,7 +25,11 @@
 
 #include <string>
 
-namespace gr { namespace v2 {
+namespace gr {
+
+class Val ;
+
+namespace v2 {
 
 class Feed2: public Feed
 {
@@ -33,6 +37,9 @@ public :
 	Feed2( const std::string& url ) ;
 	~Feed2() ;
 	bool GetNext( http::Agent *http ) ;
+
+private :
+	void AddEntry( const Val& item ) ;
 } ;
 
 } } // end of namespace gr::v2
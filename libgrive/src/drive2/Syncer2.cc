@@ -18,6 +18,7 @@
 */
 
 #include "base/Resource.hh"
+#include "base/UploadSessions.hh"
 #include "CommonUri.hh"
 #include "Entry2.hh"
 #include "Feed2.hh"
@@ -25,6 +26,7 @@
 
 #include "http/Agent.hh"
 #include "http/Download.hh"
+#include "http/Error.hh"
 #include "http/Header.hh"
 #include "http/StringResponse.hh"
 #include "json/ValResponse.hh"
@@ -34,18 +36,37 @@
 #include "util/log/Log.hh"
 #include "util/StringStream.hh"
 #include "util/ConcatStream.hh"
+#include "util/RangeStream.hh"
 
+#include <boost/bind.hpp>
 #include <boost/exception/all.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 
 // for debugging
 #include <iostream>
 
 namespace gr { namespace v2 {
 
+// files of this size or more are uploaded in chunks, which can be resumed after
+// an error. chunks must be a multiple of 256 KB
+const u64_t resumable_min_size	= 8 * 1024 * 1024 ;
+const u64_t chunk_size			= 8 * 1024 * 1024 ;
+
+// give up after this many failed chunks in a row
+const int max_chunk_failures	= 10 ;
+// the longest wait after a failed chunk, in seconds
+const unsigned max_chunk_delay	= 64 ;
+
+// folders listed by one query when the file list is split, as the query goes
+// into the URL and its length is limited
+const std::size_t max_folders_per_query	= 50 ;
+
 Syncer2::Syncer2( http::Agent *http ):
-	Syncer( http )
+	Syncer( http ),
+	m_batch( http )
 {
 	assert( http != 0 ) ;
 }
@@ -97,35 +118,14 @@ bool Syncer2::Move( Resource* res, Resource* newParentRes, std::string newFilena
 		return false;
 	}
 
-	Val meta;
-	meta.Add( "title", Val(newFilename) );
-	if ( res->IsFolder() )
-	{
-		meta.Add( "mimeType", Val( mime_types::folder ) );
-	}
-	std::string json_meta = WriteJson( meta );
-
 	Val valr ;
 
 	// Issue metadata update request
 	{
-		std::string addRemoveParents("");
-		if (res->Parent()->IsRoot() )
-			addRemoveParents += "&removeParents=root";
-		else
-			addRemoveParents += "&removeParents=" + res->Parent()->ResourceID();
-		if ( newParentRes->IsRoot() )
-			addRemoveParents += "&addParents=root";
-		else
-			addRemoveParents += "&addParents=" + newParentRes->ResourceID();
 		http::Header hdr2 ;
 		hdr2.Add( "Content-Type: application/json" );
 		http::ValResponse vrsp ;
-		// Don't change modified date because we're only moving
-		long http_code = m_http->Put(
-			feeds::files + "/" + res->ResourceID() + "?modifiedDateBehavior=noChange" + addRemoveParents,
-			json_meta, &vrsp, hdr2
-		) ;
+		long http_code = m_http->Put( MoveUrl( res, newParentRes ), MoveMetadata( res, newFilename ), &vrsp, hdr2 ) ;
 		valr = vrsp.Response();
 		assert( http_code == 200 && !( valr["id"].Str().empty() ) );
 	}
@@ -133,6 +133,87 @@ bool Syncer2::Move( Resource* res, Resource* newParentRes, std::string newFilena
 	return true;
 }
 
+void Syncer2::QueueDelete( Resource *res, const Done& done )
+{
+	http::Header hdr ;
+	hdr.Add( "If-Match: " + res->ETag() ) ;
+	m_batch.Add( "POST", res->SelfHref() + "/trash", "", hdr, boost::bind( done, _2 ) ) ;
+}
+
+void Syncer2::QueueCreate( Resource *res, const Done& done )
+{
+	assert( res->IsFolder() ) ;
+	assert( res->Parent()->GetState() == Resource::sync ) ;
+	assert( res->ResourceID().empty() ) ;
+
+	if ( !res->Parent()->IsEditable() )
+	{
+		Log( "Cannot upload %1%: parent directory read-only. %2%", res->Name(), res->StateStr(), log::warning ) ;
+		done( std::exception_ptr() ) ;
+		return ;
+	}
+
+	m_batch.Add( "POST", feeds::files, Metadata( res ), http::Header(),
+		boost::bind( &Syncer2::FinishCreate, this, res, done, _1, _2 ) ) ;
+}
+
+void Syncer2::QueueMove( Resource* res, Resource* newParent, const std::string& newFilename, const Done& done )
+{
+	if ( res->ResourceID().empty() )
+	{
+		Log("Can't rename file %1%, no server id found", res->Name());
+		done( std::exception_ptr() ) ;
+		return ;
+	}
+
+	m_batch.Add( "PUT", MoveUrl( res, newParent ), MoveMetadata( res, newFilename ), http::Header(),
+		boost::bind( done, _2 ) ) ;
+}
+
+void Syncer2::Flush()
+{
+	m_batch.Flush() ;
+}
+
+void Syncer2::FinishCreate( Resource *res, const Done& done, const Val& valr, std::exception_ptr error )
+{
+	if ( !error )
+	{
+		Entry2 responseEntry = Entry2( valr ) ;
+		AssignIDs( res, responseEntry ) ;
+		res->SetServerTime( responseEntry.MTime() );
+	}
+	done( error ) ;
+}
+
+/// URL of the metadata update moving \a res to \a newParentRes.
+std::string Syncer2::MoveUrl( Resource* res, Resource* newParentRes )
+{
+	std::string addRemoveParents("");
+	if (res->Parent()->IsRoot() )
+		addRemoveParents += "&removeParents=root";
+	else
+		addRemoveParents += "&removeParents=" + res->Parent()->ResourceID();
+	if ( newParentRes->IsRoot() )
+		addRemoveParents += "&addParents=root";
+	else
+		addRemoveParents += "&addParents=" + newParentRes->ResourceID();
+
+	// Don't change modified date because we're only moving
+	return feeds::files + "/" + res->ResourceID() + "?modifiedDateBehavior=noChange" + addRemoveParents ;
+}
+
+std::string Syncer2::MoveMetadata( Resource* res, const std::string& newFilename )
+{
+	Val meta;
+	meta.Add( "title", Val(newFilename) );
+	if ( res->IsFolder() )
+	{
+		meta.Add( "mimeType", Val( mime_types::folder ) );
+	}
+	return WriteJson( meta );
+}
+
 std::string to_string( uint64_t n )
 {
 	std::ostringstream s;
@@ -140,7 +221,8 @@ std::string to_string( uint64_t n )
 	return s.str();
 }
 
-bool Syncer2::Upload( Resource *res, bool new_rev )
+/// Metadata of a new or updated file: its title, type and parent.
+std::string Syncer2::Metadata( Resource *res )
 {
 	Val meta;
 	meta.Add( "title", Val( res->Name() ) );
@@ -154,7 +236,12 @@ bool Syncer2::Upload( Resource *res, bool new_rev )
 		parents.Add( parent );
 		meta.Add( "parents", parents );
 	}
-	std::string json_meta = WriteJson( meta );
+	return WriteJson( meta );
+}
+
+bool Syncer2::Upload( Resource *res, bool new_rev )
+{
+	std::string json_meta = Metadata( res );
 
 	Val valr ;
 
@@ -176,31 +263,38 @@ bool Syncer2::Upload( Resource *res, bool new_rev )
 	{
 		File file( res->Path() ) ;
 		uint64_t size = file.Size() ;
-		ConcatStream multipart ;
-		StringStream p1(
-			"--file_contents\r\nContent-Type: application/json; charset=utf-8\r\n\r\n" + json_meta +
-			"\r\n--file_contents\r\nContent-Type: application/octet-stream\r\nContent-Length: " + to_string( size ) +
-			"\r\n\r\n"
-		);
-		StringStream p2("\r\n--file_contents--\r\n");
-		multipart.Append( &p1 );
-		multipart.Append( &file );
-		multipart.Append( &p2 );
-
-		http::Header hdr ;
-		if ( !res->ETag().empty() )
-			hdr.Add( "If-Match: " + res->ETag() ) ;
-		hdr.Add( "Content-Type: multipart/related; boundary=\"file_contents\"" );
-		hdr.Add( "Content-Length: " + to_string( multipart.Size() ) );
-
-		http::ValResponse vrsp;
-		m_http->Request(
-			res->ResourceID().empty() ? "POST" : "PUT",
-			upload_base + ( res->ResourceID().empty() ? "" : "/" + res->ResourceID() ) +
-			"?uploadType=multipart&newRevision=" + ( new_rev ? "true" : "false" ),
-			&multipart, &vrsp, hdr
-		) ;
-		valr = vrsp.Response() ;
+		if ( size >= resumable_min_size )
+		{
+			valr = UploadResumable( res, file, json_meta, new_rev ) ;
+		}
+		else
+		{
+			ConcatStream multipart ;
+			StringStream p1(
+				"--file_contents\r\nContent-Type: application/json; charset=utf-8\r\n\r\n" + json_meta +
+				"\r\n--file_contents\r\nContent-Type: application/octet-stream\r\nContent-Length: " + to_string( size ) +
+				"\r\n\r\n"
+			);
+			StringStream p2("\r\n--file_contents--\r\n");
+			multipart.Append( &p1 );
+			multipart.Append( &file );
+			multipart.Append( &p2 );
+
+			http::Header hdr ;
+			if ( !res->ETag().empty() )
+				hdr.Add( "If-Match: " + res->ETag() ) ;
+			hdr.Add( "Content-Type: multipart/related; boundary=\"file_contents\"" );
+			hdr.Add( "Content-Length: " + to_string( multipart.Size() ) );
+
+			http::ValResponse vrsp;
+			m_http->Request(
+				res->ResourceID().empty() ? "POST" : "PUT",
+				upload_base + ( res->ResourceID().empty() ? "" : "/" + res->ResourceID() ) +
+				"?uploadType=multipart&newRevision=" + ( new_rev ? "true" : "false" ),
+				&multipart, &vrsp, hdr
+			) ;
+			valr = vrsp.Response() ;
+		}
 		assert( !( valr["id"].Str().empty() ) );
 	}
 
@@ -211,20 +305,233 @@ bool Syncer2::Upload( Resource *res, bool new_rev )
 	return true ;
 }
 
+/// Uploads a large file in chunks with the resumable upload protocol. When a
+/// chunk fails, the server is asked how much of the file it has, and the upload
+/// continues from there. The session is saved, so the next run can continue it
+/// too if this one is interrupted.
+Val Syncer2::UploadResumable( Resource *res, File& file, const std::string& json_meta, bool new_rev )
+{
+	std::string path = res->RelPath().string() ;
+	u64_t size = file.Size() ;
+
+	DateTime ctime ;
+	os::Stat( res->Path(), &ctime, NULL, NULL ) ;
+
+	Val result ;
+	u64_t offset = 0 ;
+	UploadSessions::Session session ;
+	bool resumed = m_uploads && m_uploads->Find( path, session ) &&
+		session.size == size && session.ctime == ctime ;
+	if ( resumed )
+	{
+		try
+		{
+			offset = QueryUpload( session.uri, size, result ) ;
+			Log( "resuming upload of %1% at %2% bytes", path, offset, log::info ) ;
+		}
+		catch ( http::Error& )
+		{
+			// the session has expired
+			resumed = false ;
+		}
+	}
+	if ( !resumed )
+	{
+		session.uri		= StartUpload( res, json_meta, size, new_rev ) ;
+		session.size	= size ;
+		session.ctime	= ctime ;
+		if ( m_uploads )
+			m_uploads->Save( path, session ) ;
+	}
+
+	int failures = 0 ;
+	while ( offset < size )
+	{
+		u64_t length = std::min( chunk_size, size - offset ) ;
+		RangeStream chunk( &file, offset, length ) ;
+
+		http::Header hdr ;
+		hdr.Add( "Content-Range: bytes " + to_string( offset ) + "-" + to_string( offset + length - 1 ) + "/" + to_string( size ) ) ;
+
+		try
+		{
+			http::ValResponse vrsp ;
+			// a failed chunk is not sent again as it is: the server may have
+			// received part of it, so it's asked where to go on from
+			long code = m_http->RequestOnce( "PUT", session.uri, &chunk, &vrsp, hdr ) ;
+			if ( code == 308 )
+				offset = Committed() ;
+			else
+			{
+				result = vrsp.Response() ;
+				offset = size ;
+			}
+			failures = 0 ;
+		}
+		catch ( http::Error& e )
+		{
+			if ( ++failures > max_chunk_failures )
+				throw ;
+
+			const int *code = boost::get_error_info<http::HttpResponseCode>( e ) ;
+			if ( code && ( *code == 404 || *code == 410 ) )
+			{
+				Log( "upload session of %1% has expired, starting again", path, log::warning ) ;
+				session.uri = StartUpload( res, json_meta, size, new_rev ) ;
+				if ( m_uploads )
+					m_uploads->Save( path, session ) ;
+				offset = 0 ;
+				continue ;
+			}
+
+			unsigned delay = std::min( 1u << failures, max_chunk_delay ) ;
+			Log( "upload of %1% failed at %2% bytes, resuming in %3% seconds", path, offset, delay, log::warning ) ;
+			os::Sleep( delay ) ;
+			try
+			{
+				offset = QueryUpload( session.uri, size, result ) ;
+			}
+			catch ( http::Error& )
+			{
+				// the chunk is just sent again
+			}
+		}
+	}
+
+	if ( m_uploads )
+		m_uploads->Remove( path ) ;
+	return result ;
+}
+
+/// Starts a resumable upload. Returns the URI of its session.
+std::string Syncer2::StartUpload( Resource *res, const std::string& json_meta, u64_t size, bool new_rev )
+{
+	std::string url = upload_base + ( res->ResourceID().empty() ? "" : "/" + res->ResourceID() ) +
+		"?uploadType=resumable&newRevision=" + ( new_rev ? "true" : "false" ) ;
+
+	http::Header hdr ;
+	if ( !res->ETag().empty() )
+		hdr.Add( "If-Match: " + res->ETag() ) ;
+	hdr.Add( "Content-Type: application/json; charset=UTF-8" ) ;
+	hdr.Add( "X-Upload-Content-Type: application/octet-stream" ) ;
+	hdr.Add( "X-Upload-Content-Length: " + to_string( size ) ) ;
+
+	StringStream meta( json_meta ) ;
+	http::StringResponse str ;
+	m_http->Request( res->ResourceID().empty() ? "POST" : "PUT", url, &meta, &str, hdr ) ;
+
+	std::string uri = m_http->ResponseHeader( "Location" ) ;
+	if ( uri.empty() )
+	{
+		BOOST_THROW_EXCEPTION(
+			http::Error()
+				<< http::Url( url )
+				<< http::HttpResponseText( "no upload session in the response: " + str.Response() )
+		) ;
+	}
+	return uri ;
+}
+
+/// Asks the server how much of a resumable upload it has received. Returns the
+/// size of the file, and its metadata in \a result, if the upload is complete.
+u64_t Syncer2::QueryUpload( const std::string& uri, u64_t size, Val& result )
+{
+	http::Header hdr ;
+	hdr.Add( "Content-Range: bytes */" + to_string( size ) ) ;
+
+	StringStream empty ;
+	http::ValResponse vrsp ;
+	if ( m_http->Request( "PUT", uri, &empty, &vrsp, hdr ) == 308 )
+		return Committed() ;
+
+	result = vrsp.Response() ;
+	return size ;
+}
+
+/// The number of bytes received by the server, from the "Range: bytes=0-<last>"
+/// header of a "308 Resume Incomplete" response. There is no such header if it
+/// has nothing yet.
+u64_t Syncer2::Committed() const
+{
+	std::string range = m_http->ResponseHeader( "Range" ) ;
+	std::size_t dash = range.find( '-' ) ;
+	return dash == std::string::npos ? 0 : std::strtoull( range.c_str() + dash + 1, 0, 10 ) + 1 ;
+}
+
+// only the fields read by Entry2 and Feed2 are requested, which makes the
+// listings several times smaller
+std::string FilesFields()
+{
+	return "&fields=nextLink,items(" + Entry2::FileFields() + ")" ;
+}
+
+std::string ChangesFields()
+{
+	return "&fields=nextLink,largestChangeId,items(" + Entry2::ChangeFields() + ")" ;
+}
+
 std::unique_ptr<Feed> Syncer2::GetFolders()
 {
-	return std::unique_ptr<Feed>( new Feed2( feeds::files + "?maxResults=100000&q=trashed%3dfalse+and+mimeType%3d%27" + mime_types::folder + "%27" ) );
+	return std::unique_ptr<Feed>( new Feed2( feeds::files + "?maxResults=100000&q=trashed%3dfalse+and+mimeType%3d%27" + mime_types::folder + "%27" + FilesFields() ) );
 }
 
 std::unique_ptr<Feed> Syncer2::GetAll()
 {
-	return std::unique_ptr<Feed>( new Feed2( feeds::files + "?maxResults=999999999&q=trashed%3dfalse" ) );
+	return std::unique_ptr<Feed>( new Feed2( feeds::files + "?maxResults=999999999&q=trashed%3dfalse" + FilesFields() ) );
+}
+
+/// Lists the files by the folders they are in, so the parts can be read in parallel.
+/// Files outside of the folders we can see are left out, but they could not be
+/// placed in the tree anyway. The query of each part goes into the URL, so the
+/// list is only split into \a count parts when there are few enough folders;
+/// otherwise it is read in one piece, as more parts would cost more requests
+/// than the parallel reads save.
+///
+/// Folders created after they are listed here are missed, with the files in
+/// them. The change stamp is taken before the list is read, so the next sync
+/// finds them in the changes.
+std::vector< std::unique_ptr<Feed> > Syncer2::GetAllParts( std::size_t count )
+{
+	std::vector< std::unique_ptr<Feed> > parts;
+	std::size_t max_folders = count * max_folders_per_query;
+
+	std::vector<std::string> folders;
+	if ( count > 1 )
+	{
+		folders.push_back( "root" );
+		std::unique_ptr<Feed> feed = GetFolders();
+		while ( folders.size() <= max_folders && feed->GetNext( m_http ) )
+		{
+			for ( Feed::iterator i = feed->begin(); i != feed->end(); ++i )
+				folders.push_back( i->ResourceID() );
+		}
+	}
+
+	if ( folders.empty() || folders.size() > max_folders )
+	{
+		if ( !folders.empty() )
+			Log( "More than %1% folders, listing them in one part", max_folders, log::verbose );
+		parts.push_back( GetAll() );
+		return parts;
+	}
+
+	std::size_t per_part = ( folders.size() + count - 1 ) / count;
+	for ( std::size_t i = 0; i < folders.size(); i += per_part )
+	{
+		std::string q = "trashed=false and (";
+		for ( std::size_t j = i; j < i + per_part && j < folders.size(); j++ )
+			q += ( j > i ? " or '" : "'" ) + folders[j] + "' in parents";
+		q += ")";
+		parts.push_back( std::unique_ptr<Feed>( new Feed2( feeds::files + "?maxResults=1000&q=" + m_http->Escape( q ) + FilesFields() ) ) );
+	}
+	Log( "Listing %1% folders in %2% parts", folders.size(), parts.size(), log::verbose );
+	return parts;
 }
 
 std::string ChangesFeed( long changestamp, int maxResults = 1000 )
 {
 	boost::format feed( feeds::changes + "?maxResults=%1%&includeSubscribed=false" + ( changestamp > 0 ? "&startChangeId=%2%" : "" ) ) ;
-	return ( changestamp > 0 ? feed % maxResults % changestamp : feed % maxResults ).str() ;
+	return ( changestamp > 0 ? feed % maxResults % changestamp : feed % maxResults ).str() + ChangesFields() ;
 }
 
 std::unique_ptr<Feed> Syncer2::GetChanges( long min_cstamp )
@@ -19,12 +19,21 @@
 
 #pragma once
 
+#include "Batch.hh"
+
 #include "base/Syncer.hh"
+#include "util/Types.hh"
+
+#include <string>
 
 namespace gr {
 
 class Feed;
 
+class File;
+
+class Val;
+
 namespace v2 {
 
 class Syncer2: public Syncer
@@ -39,14 +48,33 @@ public :
 	bool Create( Resource *res );
 	bool Move( Resource* res, Resource* newParent, std::string newFilename );
 
+	void QueueDelete( Resource *res, const Done& done );
+	void QueueCreate( Resource *res, const Done& done );
+	void QueueMove( Resource* res, Resource* newParent, const std::string& newFilename, const Done& done );
+	void Flush();
+
 	std::unique_ptr<Feed> GetFolders();
 	std::unique_ptr<Feed> GetAll();
+	std::vector< std::unique_ptr<Feed> > GetAllParts( std::size_t count );
 	std::unique_ptr<Feed> GetChanges( long min_cstamp );
 	long GetChangeStamp( long min_cstamp );
 
 private :
 
 	bool Upload( Resource *res, bool new_rev );
+	Val UploadResumable( Resource *res, File& file, const std::string& json_meta, bool new_rev );
+	std::string StartUpload( Resource *res, const std::string& json_meta, u64_t size, bool new_rev );
+	u64_t QueryUpload( const std::string& uri, u64_t size, Val& result );
+	u64_t Committed() const;
+
+	std::string Metadata( Resource *res );
+	std::string MoveUrl( Resource* res, Resource* newParentRes );
+	std::string MoveMetadata( Resource* res, const std::string& newFilename );
+	void FinishCreate( Resource *res, const Done& done, const Val& valr, std::exception_ptr error );
+
+private :
+
+	Batch m_batch;
 
 } ;
 
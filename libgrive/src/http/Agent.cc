@@ -19,6 +19,7 @@
 
 #include "Agent.hh"
 #include "Header.hh"
+#include "util/OS.hh"
 #include "util/StringStream.hh"
 
 namespace gr {
@@ -70,6 +71,59 @@ long Agent::Post(
 	return Request( "POST", url, &s, dest, h );
 }
 
+/// Same as Request(), without the retries an agent may make by itself after
+/// temporary errors. For requests whose callers know better how to go on,
+/// e.g. by asking the server how much of an upload it got.
+long Agent::RequestOnce(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const Header&		hdr )
+{
+	return Request( method, url, in, dest, hdr ) ;
+}
+
+/// Starts a request and calls \a done when it completes. \a in and \a dest must
+/// stay valid until then. Agents without an event loop simply complete the request
+/// before returning. Within \a done, LastError(), LastErrorHeaders() and
+/// ResponseHeader() are those of this request: keep them before starting
+/// another one.
+void Agent::RequestAsync(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const Header&		hdr,
+	const Callback&		done )
+{
+	long response = 0 ;
+	std::exception_ptr error ;
+	try
+	{
+		response = Request( method, url, in, dest, hdr ) ;
+	}
+	catch ( ... )
+	{
+		error = std::current_exception() ;
+	}
+	done( response, error ) ;
+}
+
+/// Runs the asynchronous requests until all of them are completed.
+void Agent::Wait()
+{
+}
+
+/// Runs \a task after \a seconds, e.g. to retry a request, without holding up
+/// the other requests in flight. Agents without an event loop simply wait and
+/// run it before returning.
+void Agent::Schedule( unsigned seconds, const Task& task )
+{
+	os::Sleep( seconds ) ;
+	task() ;
+}
+
 void Agent::SetUploadSpeed( unsigned kbytes )
 {
 	mMaxUpload = kbytes;
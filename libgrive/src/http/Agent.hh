@@ -20,10 +20,13 @@
 #pragma once
 
 #include <string>
+#include <exception>
 #include "ResponseLog.hh"
 #include "util/Types.hh"
 #include "util/Progress.hh"
 
+#include <boost/function.hpp>
+
 namespace gr {
 
 class SeekStream ;
@@ -35,6 +38,12 @@ class Header ;
 
 class Agent
 {
+public :
+	/// Completion handler of an asynchronous request. It receives the HTTP response
+	/// code, or the exception the blocking Request() would have thrown.
+	typedef boost::function<void ( long, std::exception_ptr )> Callback ;
+	typedef boost::function<void ()> Task ;
+
 protected:
 	unsigned mMaxUpload, mMaxDownload ;
 
@@ -69,6 +78,10 @@ public :
 		DataStream			*dest,
 		const Header&		hdr ) ;
 	
+	/// Sends a request and writes the response to \a dest. The bodies of errors
+	/// (400 and above) are kept for LastError() instead. If \a hdr has a Range
+	/// header but the server answers 200 with the whole content, nothing is
+	/// written and 200 is returned.
 	virtual long Request(
 		const std::string&	method,
 		const std::string&	url,
@@ -77,6 +90,24 @@ public :
 		const Header&		hdr,
 		u64_t			downloadFileBytes = 0 ) = 0 ;
 	
+	virtual long RequestOnce(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const Header&		hdr ) ;
+	
+	virtual void RequestAsync(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const Header&		hdr,
+		const Callback&		done ) ;
+	
+	virtual void Wait() ;
+	virtual void Schedule( unsigned seconds, const Task& task ) ;
+	
 	virtual void SetUploadSpeed( unsigned kbytes ) ;
 	virtual void SetDownloadSpeed( unsigned kbytes ) ;
 	
@@ -84,6 +115,7 @@ public :
 	virtual std::string LastErrorHeaders() const = 0 ;
 	
 	virtual std::string RedirLocation() const = 0 ;
+	virtual std::string ResponseHeader( const std::string& name ) const = 0 ;
 	
 	virtual std::string Escape( const std::string& str ) = 0 ;
 	virtual std::string Unescape( const std::string& str ) = 0 ;
@@ -19,6 +19,7 @@
 
 #include "CurlAgent.hh"
 
+#include "CurlShare.hh"
 #include "Error.hh"
 #include "Header.hh"
 
@@ -61,7 +62,10 @@ struct CurlAgent::Impl
 {
 	CURL			*curl ;
 	std::string		location ;
+	std::string		headers ;
 	bool			error ;
+	/// the request has a Range header, and the server sent the whole content
+	bool			ranged, range_ignored ;
 	std::string		error_headers ;
 	std::string		error_data ;
 	DataStream		*dest ;
@@ -70,15 +74,19 @@ struct CurlAgent::Impl
 
 static struct curl_slist* SetHeader( CURL* handle, const Header& hdr );
 
-CurlAgent::CurlAgent() : Agent(),
-	m_pimpl( new Impl ), m_pb( 0 )
+/// Agents created with the same \a share share their DNS cache and TLS
+/// sessions, but each keeps its own connections.
+CurlAgent::CurlAgent( CurlShare *share ) : Agent(),
+	m_pimpl( new Impl ), m_pb( 0 ), m_share( share )
 {
 	m_pimpl->curl = ::curl_easy_init();
 }
 
 void CurlAgent::Init()
 {
+	// the connections stay open after curl_easy_reset(), only the options are lost
 	::curl_easy_reset( m_pimpl->curl ) ;
+	CurlShare::SetOptions( m_pimpl->curl, m_share ) ;
 	::curl_easy_setopt( m_pimpl->curl, CURLOPT_SSL_VERIFYPEER,	0L ) ;
 	::curl_easy_setopt( m_pimpl->curl, CURLOPT_SSL_VERIFYHOST,	0L ) ;
 	::curl_easy_setopt( m_pimpl->curl, CURLOPT_HEADERFUNCTION,	&CurlAgent::HeaderCallback ) ;
@@ -89,6 +97,8 @@ void CurlAgent::Init()
 	if ( mMaxDownload > 0 )
 		::curl_easy_setopt( m_pimpl->curl, CURLOPT_MAX_RECV_SPEED_LARGE, mMaxDownload ) ;
 	m_pimpl->error = false;
+	m_pimpl->ranged = m_pimpl->range_ignored = false;
+	m_pimpl->headers = "";
 	m_pimpl->error_headers = "";
 	m_pimpl->error_data = "";
 	m_pimpl->dest = NULL;
@@ -120,12 +130,23 @@ std::size_t CurlAgent::HeaderCallback( void *ptr, size_t size, size_t nmemb, Cur
 	char *str = static_cast<char*>(ptr) ;
 	std::string line( str, str + size*nmemb ) ;
 	
-	// Check for error (HTTP 400 and above)
-	if ( line.substr( 0, 5 ) == "HTTP/" && line[9] >= '4' )
-		pthis->m_pimpl->error = true;
+	// Check for error (HTTP 400 and above). Only the final response counts,
+	// not an interim "100 Continue"
+	long code = StatusCode( line ) ;
+	if ( code > 0 )
+	{
+		pthis->m_pimpl->error = code >= 400 ;
+		pthis->m_pimpl->error_headers.clear() ;
+		pthis->m_pimpl->range_ignored = pthis->m_pimpl->ranged && code == 200 ;
+	}
 	
 	if ( pthis->m_pimpl->error )
 		pthis->m_pimpl->error_headers += line;
+
+	// only keep the headers of the final response, not of "100 Continue"
+	if ( code > 0 )
+		pthis->m_pimpl->headers.clear();
+	pthis->m_pimpl->headers += line;
 	
 	if ( pthis->m_log.get() )
 		pthis->m_log->Write( str, size*nmemb );
@@ -147,10 +168,16 @@ std::size_t CurlAgent::Receive( void* ptr, size_t size, size_t nmemb, CurlAgent
 	if ( pthis->m_log.get() )
 		pthis->m_log->Write( (const char*)ptr, size*nmemb );
 
-	if ( pthis->m_pimpl->error && pthis->m_pimpl->error_data.size() < 65536 )
+	// a ranged request answered with the whole content would be written at the
+	// offset of the range: stop it before anything is written
+	if ( pthis->m_pimpl->range_ignored )
+		return 0 ;
+
+	if ( pthis->m_pimpl->error )
 	{
 		// Do not feed error responses to destination stream
-		pthis->m_pimpl->error_data.append( static_cast<char*>(ptr), size * nmemb ) ;
+		if ( pthis->m_pimpl->error_data.size() < 65536 )
+			pthis->m_pimpl->error_data.append( static_cast<char*>(ptr), size * nmemb ) ;
 		return size * nmemb ;
 	}
 	return pthis->m_pimpl->dest->Write( static_cast<char*>(ptr), size * nmemb ) ;
@@ -186,6 +213,7 @@ long CurlAgent::ExecCurl(
 	::curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,	&CurlAgent::Receive ) ;
 	::curl_easy_setopt(curl, CURLOPT_WRITEDATA,		this ) ;
 	m_pimpl->dest = dest ;
+	m_pimpl->ranged = !FindHeader( hdr.Str(), "Range" ).empty() ;
 
 	struct curl_slist *slist = SetHeader( m_pimpl->curl, hdr ) ;
 
@@ -203,14 +231,15 @@ long CurlAgent::ExecCurl(
 	long http_code = 0;
 	::curl_easy_getinfo(curl,	CURLINFO_RESPONSE_CODE, &http_code);
 	Trace( "HTTP response %1%", http_code ) ;
+	CurlShare::Count( curl, m_share ) ;
 
 	// reset the curl buffer to prevent it from touching our "error" buffer
 	::curl_easy_setopt(curl,	CURLOPT_ERRORBUFFER, 	0 ) ;
 
 	m_pimpl->dest = NULL;
 
-	// only throw for libcurl errors
-	if ( curl_code != CURLE_OK )
+	// only throw for libcurl errors, not for stopping an ignored range
+	if ( curl_code != CURLE_OK && !( curl_code == CURLE_WRITE_ERROR && m_pimpl->range_ignored ) )
 	{
 		BOOST_THROW_EXCEPTION(
 			Error()
@@ -277,6 +306,11 @@ std::string CurlAgent::RedirLocation() const
 	return m_pimpl->location ;
 }
 
+std::string CurlAgent::ResponseHeader( const std::string& name ) const
+{
+	return FindHeader( m_pimpl->headers, name ) ;
+}
+
 std::string CurlAgent::Escape( const std::string& str )
 {
 	CURL *curl = m_pimpl->curl ;
@@ -32,6 +32,8 @@ class DataStream ;
 
 namespace http {
 
+class CurlShare ;
+
 /*!	\brief	agent to provide HTTP access
 	
 	This class provides functions to send HTTP request in many methods (e.g. get, post and put).
@@ -40,7 +42,7 @@ namespace http {
 class CurlAgent : public Agent
 {
 public :
-	CurlAgent() ;
+	explicit CurlAgent( CurlShare *share = 0 ) ;
 	~CurlAgent() ;
 
 	ResponseLog* GetLog() const ;
@@ -59,6 +61,7 @@ public :
 	std::string LastErrorHeaders() const ;
 	
 	std::string RedirLocation() const ;
+	std::string ResponseHeader( const std::string& name ) const ;
 	
 	std::string Escape( const std::string& str ) ;
 	std::string Unescape( const std::string& str ) ;
@@ -81,6 +84,7 @@ private :
 	std::unique_ptr<Impl> m_pimpl ;
 	std::unique_ptr<ResponseLog> m_log ;
 	Progress* m_pb ;
+	CurlShare* m_share ;
 } ;
 
 } } // end of namespace
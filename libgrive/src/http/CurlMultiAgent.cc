@@ -0,0 +1,501 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "CurlMultiAgent.hh"
+
+#include "CurlShare.hh"
+#include "Error.hh"
+#include "Header.hh"
+
+#include "util/log/Log.hh"
+#include "util/DataStream.hh"
+
+#include <boost/bind.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace gr ;
+
+std::size_t ReadFileCallback( void *ptr, std::size_t size, std::size_t nmemb, SeekStream *file )
+{
+	assert( ptr != 0 ) ;
+	assert( file != 0 ) ;
+
+	if ( size*nmemb > 0 )
+		return file->Read( static_cast<char*>(ptr), size*nmemb ) ;
+
+	return 0 ;
+}
+
+void StoreResult( long response, std::exception_ptr error, long *result, std::exception_ptr *result_error, bool *done )
+{
+	*result			= response ;
+	*result_error	= error ;
+	*done			= true ;
+}
+
+} // end of local namespace
+
+namespace gr { namespace http {
+
+/// one request in flight
+struct CurlMultiAgent::Transfer
+{
+	CurlMultiAgent		*agent ;
+	CURL				*curl ;
+	struct curl_slist	*slist ;
+	std::string			url ;
+	Header				hdr ;
+	DataStream			*dest ;
+	Callback			done ;
+
+	std::string			location ;
+	std::string			headers ;
+	bool				error ;
+	/// the request has a Range header, and the server sent the whole content
+	bool				ranged, range_ignored ;
+	std::string			error_headers ;
+	std::string			error_data ;
+	char				error_msg[CURL_ERROR_SIZE] ;
+	u64_t				total_download, total_upload ;
+} ;
+
+struct CurlMultiAgent::Impl
+{
+	CURLM							*multi ;
+	std::map<CURL*, Transfer*>		active ;
+
+	// finished easy handles are kept to reuse their connections and DNS cache
+	std::vector<CURL*>				idle ;
+
+	// the tasks of Schedule(), by the time they are due
+	std::multimap<std::chrono::steady_clock::time_point, Task>	timers ;
+
+	// the state of the most recently completed request, for LastError() etc.
+	std::string						location ;
+	std::string						headers ;
+	std::string						error_headers ;
+	std::string						error_data ;
+} ;
+
+/// Agents created with the same \a share share their DNS cache and TLS
+/// sessions, but each keeps its own connections.
+CurlMultiAgent::CurlMultiAgent( CurlShare *share ) : Agent(),
+	m_pimpl( new Impl ), m_pb( 0 ), m_share( share )
+{
+	m_pimpl->multi = ::curl_multi_init() ;
+
+	// requests in flight at the same time go over one HTTP/2 connection if possible
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	::curl_multi_setopt( m_pimpl->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX ) ;
+#endif
+}
+
+CurlMultiAgent::~CurlMultiAgent()
+{
+	for ( std::map<CURL*, Transfer*>::iterator i = m_pimpl->active.begin() ; i != m_pimpl->active.end() ; ++i )
+	{
+		::curl_multi_remove_handle( m_pimpl->multi, i->first ) ;
+		::curl_easy_cleanup( i->first ) ;
+		::curl_slist_free_all( i->second->slist ) ;
+		delete i->second ;
+	}
+	for ( std::vector<CURL*>::iterator i = m_pimpl->idle.begin() ; i != m_pimpl->idle.end() ; ++i )
+		::curl_easy_cleanup( *i ) ;
+
+	::curl_multi_cleanup( m_pimpl->multi ) ;
+}
+
+ResponseLog* CurlMultiAgent::GetLog() const
+{
+	return m_log.get();
+}
+
+void CurlMultiAgent::SetLog( ResponseLog *log )
+{
+	m_log.reset( log );
+}
+
+void CurlMultiAgent::SetProgressReporter( Progress *progress )
+{
+	m_pb = progress;
+}
+
+/// Limits the number of connections opened at the same time. Requests above the
+/// limit are queued by libcurl until a connection is free.
+void CurlMultiAgent::SetMaxConnections( unsigned count )
+{
+#if LIBCURL_VERSION_NUM >= 0x071e00
+	::curl_multi_setopt( m_pimpl->multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>( count ) ) ;
+#endif
+}
+
+std::size_t CurlMultiAgent::Pending() const
+{
+	return m_pimpl->active.size() ;
+}
+
+std::size_t CurlMultiAgent::HeaderCallback( void *ptr, size_t size, size_t nmemb, Transfer *t )
+{
+	char *str = static_cast<char*>(ptr) ;
+	std::string line( str, str + size*nmemb ) ;
+
+	// Check for error (HTTP 400 and above). Only the final response counts,
+	// not an interim "100 Continue"
+	long code = StatusCode( line ) ;
+	if ( code > 0 )
+	{
+		t->error = code >= 400 ;
+		t->error_headers.clear() ;
+		t->range_ignored = t->ranged && code == 200 ;
+	}
+
+	if ( t->error )
+		t->error_headers += line;
+
+	// only keep the headers of the final response, not of "100 Continue"
+	if ( code > 0 )
+		t->headers.clear() ;
+	t->headers += line ;
+
+	if ( t->agent->m_log.get() )
+		t->agent->m_log->Write( str, size*nmemb );
+
+	static const std::string loc = "Location: " ;
+	std::size_t pos = line.find( loc ) ;
+	if ( pos != line.npos )
+	{
+		std::size_t end_pos = line.find( "\r\n", pos ) ;
+		t->location = line.substr( pos+loc.size(), end_pos - loc.size() ) ;
+	}
+
+	return size*nmemb ;
+}
+
+std::size_t CurlMultiAgent::Receive( void* ptr, size_t size, size_t nmemb, Transfer *t )
+{
+	assert( t != 0 ) ;
+	if ( t->agent->m_log.get() )
+		t->agent->m_log->Write( (const char*)ptr, size*nmemb );
+
+	// a ranged request answered with the whole content would be written at the
+	// offset of the range: stop it before anything is written
+	if ( t->range_ignored )
+		return 0 ;
+
+	if ( t->error )
+	{
+		// Do not feed error responses to destination stream
+		if ( t->error_data.size() < 65536 )
+			t->error_data.append( static_cast<char*>(ptr), size * nmemb ) ;
+		return size * nmemb ;
+	}
+	return t->dest->Write( static_cast<char*>(ptr), size * nmemb ) ;
+}
+
+int CurlMultiAgent::ProgressCallback( Transfer *t, curl_off_t totalDownload, curl_off_t finishedDownload, curl_off_t totalUpload, curl_off_t finishedUpload )
+{
+	// a single progress bar makes no sense for many parallel transfers
+	Progress *pb = t->agent->m_pb ;
+	if ( pb && t->agent->m_pimpl->active.size() == 1 )
+	{
+		totalDownload = t->total_download;
+		if ( !totalUpload )
+			totalUpload = t->total_upload;
+		pb->reportProgress(
+			totalDownload > 0 ? totalDownload : totalUpload,
+			totalDownload > 0 ? finishedDownload : finishedUpload
+		);
+	}
+	return 0;
+}
+
+CurlMultiAgent::Transfer* CurlMultiAgent::Start(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const Header&		hdr,
+	u64_t				downloadFileBytes,
+	const Callback&		done )
+{
+	Trace("HTTP %1% \"%2%\"", method, url ) ;
+
+	CURL *curl = 0 ;
+	if ( m_pimpl->idle.empty() )
+		curl = ::curl_easy_init() ;
+	else
+	{
+		curl = m_pimpl->idle.back() ;
+		m_pimpl->idle.pop_back() ;
+		::curl_easy_reset( curl ) ;
+	}
+
+	std::unique_ptr<Transfer> t( new Transfer ) ;
+	t->agent			= this ;
+	t->curl				= curl ;
+	t->url				= url ;
+	t->hdr				= hdr ;
+	t->dest				= dest ;
+	t->done				= done ;
+	t->error			= false ;
+	t->ranged			= !FindHeader( hdr.Str(), "Range" ).empty() ;
+	t->range_ignored	= false ;
+	t->error_msg[0]		= '\0' ;
+	t->total_download	= downloadFileBytes ;
+	t->total_upload		= 0 ;
+
+	CurlShare::SetOptions( curl, m_share ) ;
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	// rather wait for a connection being set up than open another one
+	::curl_easy_setopt( curl, CURLOPT_PIPEWAIT,			1L ) ;
+#endif
+	::curl_easy_setopt( curl, CURLOPT_SSL_VERIFYPEER,	0L ) ;
+	::curl_easy_setopt( curl, CURLOPT_SSL_VERIFYHOST,	0L ) ;
+	::curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION,	&CurlMultiAgent::HeaderCallback ) ;
+	::curl_easy_setopt( curl, CURLOPT_HEADERDATA,		t.get() ) ;
+	::curl_easy_setopt( curl, CURLOPT_HEADER,			0L ) ;
+	if ( mMaxUpload > 0 )
+		::curl_easy_setopt( curl, CURLOPT_MAX_SEND_SPEED_LARGE, static_cast<curl_off_t>( mMaxUpload ) ) ;
+	if ( mMaxDownload > 0 )
+		::curl_easy_setopt( curl, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>( mMaxDownload ) ) ;
+
+	::curl_easy_setopt( curl, CURLOPT_CUSTOMREQUEST,	method.c_str() ) ;
+	if ( in )
+	{
+		::curl_easy_setopt( curl, CURLOPT_UPLOAD,			1L ) ;
+		::curl_easy_setopt( curl, CURLOPT_READFUNCTION,		&ReadFileCallback ) ;
+		::curl_easy_setopt( curl, CURLOPT_READDATA ,		in ) ;
+		::curl_easy_setopt( curl, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>( in->Size() ) ) ;
+	}
+
+	::curl_easy_setopt( curl, CURLOPT_ERRORBUFFER,		t->error_msg ) ;
+	::curl_easy_setopt( curl, CURLOPT_URL,				t->url.c_str() ) ;
+	::curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION,	&CurlMultiAgent::Receive ) ;
+	::curl_easy_setopt( curl, CURLOPT_WRITEDATA,		t.get() ) ;
+
+	t->slist = 0 ;
+	for ( Header::iterator i = hdr.begin() ; i != hdr.end() ; ++i )
+		t->slist = ::curl_slist_append( t->slist, i->c_str() ) ;
+	::curl_easy_setopt( curl, CURLOPT_HTTPHEADER, t->slist ) ;
+
+	::curl_easy_setopt( curl, CURLOPT_NOPROGRESS, 0L ) ;
+#if LIBCURL_VERSION_NUM >= 0x072000
+	::curl_easy_setopt( curl, CURLOPT_XFERINFOFUNCTION, &CurlMultiAgent::ProgressCallback ) ;
+	::curl_easy_setopt( curl, CURLOPT_XFERINFODATA, t.get() ) ;
+#endif
+
+	::curl_multi_add_handle( m_pimpl->multi, curl ) ;
+	m_pimpl->active[curl] = t.get() ;
+	return t.release() ;
+}
+
+void CurlMultiAgent::RequestAsync(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const Header&		hdr,
+	const Callback&		done )
+{
+	Start( method, url, in, dest, hdr, 0, done ) ;
+}
+
+/// Runs the event loop until the request completes. Other requests in flight
+/// progress at the same time and may complete before it.
+long CurlMultiAgent::Request(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const Header&		hdr,
+	u64_t			downloadFileBytes )
+{
+	long response = 0 ;
+	std::exception_ptr error ;
+	bool done = false ;
+
+	Start( method, url, in, dest, hdr, downloadFileBytes,
+		boost::bind( &StoreResult, _1, _2, &response, &error, &done ) ) ;
+
+	while ( !done )
+		Step() ;
+
+	if ( error )
+		std::rethrow_exception( error ) ;
+	return response ;
+}
+
+void CurlMultiAgent::Wait()
+{
+	while ( !m_pimpl->active.empty() || !m_pimpl->timers.empty() )
+		Step() ;
+}
+
+/// \a task is run by the event loop once \a seconds have passed. Wait() waits
+/// for it too.
+void CurlMultiAgent::Schedule( unsigned seconds, const Task& task )
+{
+	m_pimpl->timers.insert( std::make_pair(
+		std::chrono::steady_clock::now() + std::chrono::seconds( seconds ), task ) ) ;
+}
+
+/// Runs the tasks which are due. Returns the milliseconds until the next one,
+/// or -1 if there is none.
+int CurlMultiAgent::RunTimers()
+{
+	typedef std::chrono::steady_clock Clock ;
+	while ( !m_pimpl->timers.empty() )
+	{
+		Clock::time_point now = Clock::now() ;
+		std::multimap<Clock::time_point, Task>::iterator i = m_pimpl->timers.begin() ;
+		if ( i->first > now )
+			return std::chrono::duration_cast<std::chrono::milliseconds>( i->first - now ).count() + 1 ;
+
+		// the task may schedule another one
+		Task task = i->second ;
+		m_pimpl->timers.erase( i ) ;
+		task() ;
+	}
+	return -1 ;
+}
+
+/// Runs one iteration of the event loop: runs the scheduled tasks which are due,
+/// and transfers data on all sockets which are ready, or waits up to one second
+/// for one to become ready or for the next task.
+void CurlMultiAgent::Step()
+{
+	int next = RunTimers() ;
+
+	int running = 0 ;
+	::curl_multi_perform( m_pimpl->multi, &running ) ;
+
+	int queued = 0 ;
+	bool completed = false ;
+	while ( CURLMsg *msg = ::curl_multi_info_read( m_pimpl->multi, &queued ) )
+	{
+		if ( msg->msg == CURLMSG_DONE )
+		{
+			Complete( msg->easy_handle, msg->data.result ) ;
+			completed = true ;
+		}
+	}
+
+	int timeout = next >= 0 && next < 1000 ? next : 1000 ;
+	if ( !completed && running > 0 )
+	{
+		int numfds = 0 ;
+		::curl_multi_wait( m_pimpl->multi, 0, 0, timeout, &numfds ) ;
+	}
+	else if ( !completed && next >= 0 )
+		std::this_thread::sleep_for( std::chrono::milliseconds( timeout ) ) ;
+}
+
+void CurlMultiAgent::Complete( CURL *curl, CURLcode result )
+{
+	std::map<CURL*, Transfer*>::iterator i = m_pimpl->active.find( curl ) ;
+	assert( i != m_pimpl->active.end() ) ;
+	std::unique_ptr<Transfer> t( i->second ) ;
+	m_pimpl->active.erase( i ) ;
+
+	long http_code = 0 ;
+	::curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &http_code ) ;
+	Trace( "HTTP response %1%", http_code ) ;
+	CurlShare::Count( curl, m_share ) ;
+
+	::curl_multi_remove_handle( m_pimpl->multi, curl ) ;
+	::curl_slist_free_all( t->slist ) ;
+	::curl_easy_setopt( curl, CURLOPT_ERRORBUFFER, 0 ) ;
+	m_pimpl->idle.push_back( curl ) ;
+
+	m_pimpl->location		= t->location ;
+	m_pimpl->headers		= t->headers ;
+	m_pimpl->error_headers	= t->error_headers ;
+	m_pimpl->error_data		= t->error_data ;
+
+	// only report libcurl errors as exceptions, not stopping an ignored range
+	std::exception_ptr error ;
+	if ( result != CURLE_OK && !( result == CURLE_WRITE_ERROR && t->range_ignored ) )
+	{
+		try
+		{
+			BOOST_THROW_EXCEPTION(
+				Error()
+					<< CurlCode( result )
+					<< Url( t->url )
+					<< CurlErrMsg( t->error_msg[0] ? t->error_msg : ::curl_easy_strerror( result ) )
+					<< HttpRequestHeaders( t->hdr )
+			) ;
+		}
+		catch ( Error& )
+		{
+			error = std::current_exception() ;
+		}
+	}
+
+	t->done( http_code, error ) ;
+}
+
+std::string CurlMultiAgent::LastError() const
+{
+	return m_pimpl->error_data ;
+}
+
+std::string CurlMultiAgent::LastErrorHeaders() const
+{
+	return m_pimpl->error_headers ;
+}
+
+std::string CurlMultiAgent::RedirLocation() const
+{
+	return m_pimpl->location ;
+}
+
+std::string CurlMultiAgent::ResponseHeader( const std::string& name ) const
+{
+	return FindHeader( m_pimpl->headers, name ) ;
+}
+
+std::string CurlMultiAgent::Escape( const std::string& str )
+{
+	char *tmp = ::curl_easy_escape( 0, str.c_str(), str.size() ) ;
+	std::string result = tmp ;
+	::curl_free( tmp ) ;
+
+	return result ;
+}
+
+std::string CurlMultiAgent::Unescape( const std::string& str )
+{
+	int r ;
+	char *tmp = ::curl_easy_unescape( 0, str.c_str(), str.size(), &r ) ;
+	std::string result( tmp, r ) ;
+	::curl_free( tmp ) ;
+
+	return result ;
+}
+
+} } // end of namespace
@@ -0,0 +1,114 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Agent.hh"
+
+#include <memory>
+#include <string>
+
+#include <curl/curl.h>
+
+namespace gr {
+
+class DataStream ;
+
+namespace http {
+
+class CurlShare ;
+
+/*!	\brief	agent running many HTTP requests from one event loop
+
+	This agent is built on a curl multi handle. Requests started with RequestAsync()
+	are all in flight at the same time and progress whenever the event loop runs, i.e.
+	in Wait() or in any blocking Request(). Completion handlers are called from
+	the event loop, one at a time, in the thread running it.
+
+	The agent itself is not thread-safe.
+*/
+class CurlMultiAgent : public Agent
+{
+public :
+	explicit CurlMultiAgent( CurlShare *share = 0 ) ;
+	~CurlMultiAgent() ;
+
+	ResponseLog* GetLog() const ;
+	void SetLog( ResponseLog *log ) ;
+	void SetProgressReporter( Progress *progress ) ;
+
+	long Request(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const Header&		hdr,
+		u64_t			downloadFileBytes = 0 ) ;
+
+	void RequestAsync(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const Header&		hdr,
+		const Callback&		done ) ;
+
+	void Wait() ;
+	void Schedule( unsigned seconds, const Task& task ) ;
+
+	void SetMaxConnections( unsigned count ) ;
+	std::size_t Pending() const ;
+
+	std::string LastError() const ;
+	std::string LastErrorHeaders() const ;
+
+	std::string RedirLocation() const ;
+	std::string ResponseHeader( const std::string& name ) const ;
+
+	std::string Escape( const std::string& str ) ;
+	std::string Unescape( const std::string& str ) ;
+
+private :
+	struct Transfer ;
+
+	static std::size_t HeaderCallback( void *ptr, size_t size, size_t nmemb, Transfer *t ) ;
+	static std::size_t Receive( void* ptr, size_t size, size_t nmemb, Transfer *t ) ;
+	static int ProgressCallback( Transfer *t, curl_off_t totalDownload, curl_off_t finishedDownload, curl_off_t totalUpload, curl_off_t finishedUpload ) ;
+
+	Transfer* Start(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const Header&		hdr,
+		u64_t				downloadFileBytes,
+		const Callback&		done ) ;
+	void Step() ;
+	int RunTimers() ;
+	void Complete( CURL *curl, CURLcode result ) ;
+
+private :
+	struct Impl ;
+	std::unique_ptr<Impl> m_pimpl ;
+	std::unique_ptr<ResponseLog> m_log ;
+	Progress* m_pb ;
+	CurlShare* m_share ;
+} ;
+
+} } // end of namespace
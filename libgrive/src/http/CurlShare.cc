@@ -0,0 +1,110 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "CurlShare.hh"
+
+#include "util/log/Log.hh"
+
+namespace gr { namespace http {
+
+CurlShare::CurlShare() :
+	m_share( ::curl_share_init() ),
+	m_requests( 0 ),
+	m_reused( 0 )
+{
+	::curl_share_setopt( m_share, CURLSHOPT_LOCKFUNC,	&CurlShare::Lock ) ;
+	::curl_share_setopt( m_share, CURLSHOPT_UNLOCKFUNC,	&CurlShare::Unlock ) ;
+	::curl_share_setopt( m_share, CURLSHOPT_USERDATA,	this ) ;
+	::curl_share_setopt( m_share, CURLSHOPT_SHARE,		CURL_LOCK_DATA_DNS ) ;
+	::curl_share_setopt( m_share, CURLSHOPT_SHARE,		CURL_LOCK_DATA_SSL_SESSION ) ;
+
+	// not CURL_LOCK_DATA_CONNECT: the agents run in different threads, and
+	// libcurl doesn't support using a shared connection cache from several
+	// threads at the same time. Each agent keeps its own connections alive.
+}
+
+/// All agents using it must be destroyed before.
+CurlShare::~CurlShare()
+{
+	::curl_share_cleanup( m_share ) ;
+
+	if ( m_requests > 0 )
+		Log( "%1% HTTP requests, %2% of them reused a connection",
+			m_requests.load(), m_reused.load(), log::debug ) ;
+}
+
+/// Sets the connection options of \a curl, which have to be set again after
+/// curl_easy_reset(). Connections are kept alive, and HTTP/2 is negotiated
+/// with servers supporting it, so that concurrent requests of a multi handle
+/// can share one connection. \a share may be null.
+void CurlShare::SetOptions( CURL *curl, CurlShare *share )
+{
+	::curl_easy_setopt( curl, CURLOPT_TCP_KEEPALIVE,	1L ) ;
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	::curl_easy_setopt( curl, CURLOPT_HTTP_VERSION,		static_cast<long>( CURL_HTTP_VERSION_2TLS ) ) ;
+#endif
+	if ( share )
+		::curl_easy_setopt( curl, CURLOPT_SHARE,		share->m_share ) ;
+}
+
+/// Logs whether the request just completed by \a curl opened a new connection,
+/// and adds it to the totals of \a share, which may be null.
+void CurlShare::Count( CURL *curl, CurlShare *share )
+{
+	long connects = 0 ;
+	::curl_easy_getinfo( curl, CURLINFO_NUM_CONNECTS, &connects ) ;
+
+	long version = 0 ;
+#if LIBCURL_VERSION_NUM >= 0x073200
+	::curl_easy_getinfo( curl, CURLINFO_HTTP_VERSION, &version ) ;
+#endif
+	Trace( "HTTP/%1% over %2% connection",
+		version == CURL_HTTP_VERSION_2_0 ? "2" : version == CURL_HTTP_VERSION_1_0 ? "1.0" : "1.1",
+		connects > 0 ? "a new" : "a reused" ) ;
+
+	if ( share )
+	{
+		share->m_requests++ ;
+		if ( connects == 0 )
+			share->m_reused++ ;
+	}
+}
+
+u64_t CurlShare::Requests() const
+{
+	return m_requests ;
+}
+
+u64_t CurlShare::Reused() const
+{
+	return m_reused ;
+}
+
+void CurlShare::Lock( CURL *, curl_lock_data data, curl_lock_access, void *pthis )
+{
+	static_cast<CurlShare*>( pthis )->m_locks[data].lock() ;
+}
+
+void CurlShare::Unlock( CURL *, curl_lock_data data, void *pthis )
+{
+	static_cast<CurlShare*>( pthis )->m_locks[data].unlock() ;
+}
+
+} } // end of namespace
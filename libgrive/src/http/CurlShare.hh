@@ -0,0 +1,65 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "util/Types.hh"
+
+#include <atomic>
+#include <mutex>
+
+#include <curl/curl.h>
+
+namespace gr { namespace http {
+
+/*!	\brief	caches shared by the curl handles of several agents
+
+	The agents created with the same CurlShare share their DNS cache and TLS
+	sessions, so that a new connection can resume the TLS session of another
+	agent. The agents may run in different threads, so open connections are not
+	shared: each agent reuses its own.
+
+	It also counts the requests of the agents, and how many of them could reuse a
+	connection. The totals are written in the debug log when it is destroyed.
+*/
+class CurlShare
+{
+public :
+	CurlShare() ;
+	~CurlShare() ;
+
+	static void SetOptions( CURL *curl, CurlShare *share ) ;
+	static void Count( CURL *curl, CurlShare *share ) ;
+
+	u64_t Requests() const ;
+	u64_t Reused() const ;
+
+private :
+	static void Lock( CURL *curl, curl_lock_data data, curl_lock_access access, void *pthis ) ;
+	static void Unlock( CURL *curl, curl_lock_data data, void *pthis ) ;
+
+private :
+	CURLSH				*m_share ;
+	std::mutex			m_locks[CURL_LOCK_DATA_LAST] ;
+	std::atomic<u64_t>	m_requests ;
+	std::atomic<u64_t>	m_reused ;
+} ;
+
+} } // end of namespace
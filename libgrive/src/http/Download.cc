@@ -40,16 +40,30 @@
 namespace gr { namespace http {
 
 Download::Download( const std::string& filename ) :
-	m_file( filename, 0600 ),
+	m_own( filename, 0600 ),
+	m_file( &m_own ),
+	m_offset( 0 ),
 	m_crypt( new crypt::MD5 )
 {
 }
 
 Download::Download( const std::string& filename, NoChecksum ) :
-	m_file( filename, 0600 )
+	m_own( filename, 0600 ),
+	m_file( &m_own ),
+	m_offset( 0 )
 {
 }
 
+/// Writes into an already opened file starting at \a offset. The file is
+/// written with pwrite(), so several downloads can fill different ranges
+/// of it at the same time. No checksum is calculated.
+Download::Download( File *file, u64_t offset ) :
+	m_file( file ),
+	m_offset( offset )
+{
+	assert( file != 0 ) ;
+}
+
 Download::~Download()
 {
 }
@@ -64,6 +78,12 @@ std::string Download::Finish() const
 	return m_crypt.get() != 0 ? m_crypt->Get() : "" ;
 }
 
+/// Position in the file where the next received byte will be written.
+u64_t Download::Offset() const
+{
+	return m_offset ;
+}
+
 std::size_t Download::Write( const char *data, std::size_t count )
 {
 	assert( data != 0 ) ;
@@ -71,7 +91,9 @@ std::size_t Download::Write( const char *data, std::size_t count )
 	if ( m_crypt.get() != 0 )
 		m_crypt->Write( data, count ) ;
 	
-	return m_file.Write( data, count ) ;
+	std::size_t written = m_file->WriteAt( data, count, m_offset ) ;
+	m_offset += written ;
+	return written ;
 }
 
 
@@ -38,16 +38,20 @@ public :
 	struct NoChecksum {} ;
 	Download( const std::string& filename ) ;
 	Download( const std::string& filename, NoChecksum ) ;
+	Download( File *file, u64_t offset ) ;
 	~Download() ;
 	
 	std::string Finish() const ;
+	u64_t Offset() const ;
 	
 	void Clear() ;
 	std::size_t Write( const char *data, std::size_t count ) ;
 	std::size_t Read( char *, std::size_t ) ; 
 	
 private :
-	File						m_file ;
+	File						m_own ;
+	File						*m_file ;
+	u64_t						m_offset ;
 	std::unique_ptr<crypt::MD5>	m_crypt ;
 } ;
 
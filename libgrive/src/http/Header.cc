@@ -19,7 +19,10 @@
 
 #include "Header.hh"
 
+#include <boost/algorithm/string.hpp>
+
 #include <algorithm>
+#include <cstdlib>
 #include <iterator>
 #include <ostream>
 #include <sstream>
@@ -65,4 +68,32 @@ Header operator+( const Header& header, const std::string& str )
 	return h ;
 }
 
+/// Returns the value of a header in the raw headers of a response, or an
+/// empty string if it isn't there. Names are case-insensitive, as in HTTP/2
+/// they are all lowercase.
+std::string FindHeader( const std::string& headers, const std::string& name )
+{
+	std::istringstream s( headers ) ;
+	std::string line ;
+	while ( std::getline( s, line ) )
+	{
+		std::size_t colon = line.find( ':' ) ;
+		if ( colon != std::string::npos && boost::iequals( line.substr( 0, colon ), name ) )
+			return boost::trim_copy( line.substr( colon + 1 ) ) ;
+	}
+	return "" ;
+}
+
+/// Returns the response code of the header \a line if it is a status line, or
+/// 0. The status line of HTTP/1.x is "HTTP/1.1 206 Partial Content", and the
+/// one of HTTP/2 is "HTTP/2 206", so the code is read after the first space.
+long StatusCode( const std::string& line )
+{
+	if ( line.compare( 0, 5, "HTTP/" ) != 0 )
+		return 0 ;
+
+	std::size_t pos = line.find( ' ' ) ;
+	return pos != line.npos ? std::strtol( line.c_str() + pos + 1, 0, 10 ) : 0 ;
+}
+
 } } // end of namespace
@@ -49,4 +49,7 @@ private :
 std::ostream& operator<<( std::ostream& os, const Header& h ) ;
 Header operator+( const Header& header, const std::string& str ) ;
 
+std::string FindHeader( const std::string& headers, const std::string& name ) ;
+long StatusCode( const std::string& line ) ;
+
 }} // end of namespace
@@ -0,0 +1,451 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#include "BinaryVal.hh"
+
+#include "util/DataStream.hh"
+#include "util/MemMap.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace gr { namespace binary {
+
+namespace
+{
+	const char magic[8] = { 'G', 'R', 'I', 'V', 'E', 'I', 'D', 'X' } ;
+	const uint32_t byte_order = 0x01020304 ;
+	const uint32_t no_key = 0xffffffff ;
+
+	struct Header
+	{
+		char		magic[8] ;
+		uint32_t	version ;
+		uint32_t	byte_order ;
+		uint64_t	node_count ;
+		uint64_t	string_size ;
+	} ;
+
+	struct Range
+	{
+		uint32_t	first ;
+		uint32_t	count ;
+	} ;
+
+	/// string table with each distinct string stored once, as a 32-bit
+	/// length followed by the characters
+	class StringTable
+	{
+	public :
+		uint32_t Add( const std::string& str )
+		{
+			std::map<std::string, uint32_t>::iterator i = m_index.find( str ) ;
+			if ( i != m_index.end() )
+				return i->second ;
+
+			uint32_t offset = m_data.size() ;
+			uint32_t len = str.size() ;
+			m_data.append( reinterpret_cast<const char*>( &len ), sizeof(len) ) ;
+			m_data.append( str ) ;
+			m_index.insert( std::make_pair( str, offset ) ) ;
+			return offset ;
+		}
+
+		const std::string& Data() const
+		{
+			return m_data ;
+		}
+
+	private :
+		std::string						m_data ;
+		std::map<std::string, uint32_t>	m_index ;
+	} ;
+
+	void Expand( Val& val )
+	{
+		if ( val.Is<Val::Array>() )
+			std::for_each( val.AsArray().begin(), val.AsArray().end(), &Expand ) ;
+		else if ( val.Is<Val::Object>() )
+		{
+			Val::Object& obj = val.AsObject() ;
+			for ( Val::Object::iterator i = obj.begin() ; i != obj.end() ; ++i )
+				Expand( i->second ) ;
+		}
+	}
+}
+
+struct Node
+{
+	uint32_t	type ;
+	uint32_t	key ;
+	union
+	{
+		long long	i ;
+		double		d ;
+		uint32_t	str ;
+		Range		children ;
+	} ;
+} ;
+
+/// An image of \a size bytes at \a data, which must stay there while it's used.
+Image::Image( const char *data, std::size_t size )
+{
+	Open( data, size ) ;
+}
+
+/// An image of the first \a size bytes of \a file, mapped into memory. The
+/// file may be closed, replaced or removed, but not truncated while it's used.
+Image::Image( File& file, std::size_t size ) :
+	m_map( new MemMap( file, 0, size ) )
+{
+	Open( static_cast<const char*>( m_map->Addr() ), size ) ;
+}
+
+Image::~Image()
+{
+}
+
+void Image::Open( const char *data, std::size_t size )
+{
+	Header hdr ;
+	if ( size < sizeof(hdr) )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "truncated header" ) ) ;
+	std::memcpy( &hdr, data, sizeof(hdr) ) ;
+
+	if ( std::memcmp( hdr.magic, magic, sizeof(magic) ) != 0 || hdr.byte_order != byte_order )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "bad magic" ) ) ;
+	if ( hdr.version != version )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "unsupported version" ) ) ;
+	if ( hdr.node_count == 0 ||
+		hdr.node_count > ( size - sizeof(hdr) ) / sizeof(Node) ||
+		hdr.string_size != size - sizeof(hdr) - hdr.node_count * sizeof(Node) )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "bad size" ) ) ;
+
+	// the header is a multiple of 8 bytes, so the nodes of a mapped file are aligned
+	m_nodes			= reinterpret_cast<const Node*>( data + sizeof(hdr) ) ;
+	m_node_count	= hdr.node_count ;
+	m_strings		= data + sizeof(hdr) + hdr.node_count * sizeof(Node) ;
+	m_string_size	= hdr.string_size ;
+
+	// one pass over the nodes, without allocating anything
+	for ( uint64_t i = 0 ; i < m_node_count ; i++ )
+	{
+		const Node& n = m_nodes[i] ;
+		switch ( n.type )
+		{
+		case Val::null_type :
+		case Val::bool_type :
+		case Val::int_type :
+		case Val::double_type :
+			break ;
+
+		case Val::string_type :
+			CheckString( n.str ) ;
+			break ;
+
+		case Val::array_type :
+		case Val::object_type :
+			// children are always stored after their parent, which also rules out loops
+			if ( n.children.first <= i || n.children.first + (uint64_t)n.children.count > m_node_count )
+				BOOST_THROW_EXCEPTION( Error() << Reason( "bad child offset" ) ) ;
+			if ( n.type == Val::array_type )
+				break ;
+
+			// the keys must be sorted for Find()
+			for ( uint32_t c = 0 ; c < n.children.count ; c++ )
+			{
+				uint32_t key = m_nodes[n.children.first + c].key, len ;
+				CheckString( key ) ;
+				std::memcpy( &len, m_strings + key, sizeof(len) ) ;
+				if ( c > 0 && Compare( m_nodes[n.children.first + c - 1].key, m_strings + key + sizeof(len), len ) >= 0 )
+					BOOST_THROW_EXCEPTION( Error() << Reason( "unsorted keys" ) ) ;
+			}
+			break ;
+
+		default :
+			BOOST_THROW_EXCEPTION( Error() << Reason( "unknown node type" ) ) ;
+		}
+	}
+}
+
+void Image::CheckString( uint32_t offset ) const
+{
+	uint32_t len ;
+	if ( offset + (uint64_t)sizeof(len) > m_string_size )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "bad string offset" ) ) ;
+	std::memcpy( &len, m_strings + offset, sizeof(len) ) ;
+	if ( offset + (uint64_t)sizeof(len) + len > m_string_size )
+		BOOST_THROW_EXCEPTION( Error() << Reason( "bad string length" ) ) ;
+}
+
+/// Compares the string at \a offset with \a len characters at \a str, in the
+/// order of std::string.
+int Image::Compare( uint32_t offset, const char *str, std::size_t len ) const
+{
+	uint32_t size ;
+	std::memcpy( &size, m_strings + offset, sizeof(size) ) ;
+	int r = std::memcmp( m_strings + offset + sizeof(size), str, std::min<std::size_t>( size, len ) ) ;
+	return r != 0 ? r : ( size < len ? -1 : size > len ? 1 : 0 ) ;
+}
+
+std::string Image::String( uint32_t offset ) const
+{
+	uint32_t len ;
+	std::memcpy( &len, m_strings + offset, sizeof(len) ) ;
+	return std::string( m_strings + offset + sizeof(len), len ) ;
+}
+
+/// The root of \a image, whose arrays and objects are decoded as they are used.
+Val Image::Root( const std::shared_ptr<const Image>& image )
+{
+	return Value( image, 0 ) ;
+}
+
+/// Looks up the member \a key of the object at \a index, and returns its index
+/// in \a child.
+bool Image::Find( std::size_t index, const std::string& key, std::size_t& child ) const
+{
+	const Node& n = m_nodes[index] ;
+	assert( n.type == Val::object_type ) ;
+
+	std::size_t begin = n.children.first, end = begin + n.children.count ;
+	while ( begin < end )
+	{
+		std::size_t mid = begin + ( end - begin ) / 2 ;
+		int r = Compare( m_nodes[mid].key, key.data(), key.size() ) ;
+		if ( r == 0 )
+		{
+			child = mid ;
+			return true ;
+		}
+		if ( r < 0 )
+			begin = mid + 1 ;
+		else
+			end = mid ;
+	}
+	return false ;
+}
+
+/// The node at \a index. An array or object stays in the image.
+Val Image::Value( const std::shared_ptr<const Image>& image, std::size_t index )
+{
+	const Node& n = image->m_nodes[index] ;
+	switch ( n.type )
+	{
+	case Val::bool_type :	return Val( n.i != 0 ) ;
+	case Val::int_type :	return Val( n.i ) ;
+	case Val::double_type :	return Val( n.d ) ;
+	case Val::string_type :	return Val( image->String( n.str ) ) ;
+
+	case Val::array_type :
+	case Val::object_type :
+	{
+		Val result( static_cast<Val::TypeEnum>( n.type ) ) ;
+		if ( n.children.count > 0 )
+		{
+			new ( &result.m_node ) Val::Node ;
+			result.m_node.image	= image ;
+			result.m_node.index	= index ;
+			result.m_mapped		= true ;
+		}
+		return result ;
+	}
+
+	default :
+		return Val( Val::null_type ) ;
+	}
+}
+
+/// Fills \a dest, an empty array or object, with the children of the node at
+/// \a index.
+void Image::Decode( const std::shared_ptr<const Image>& image, std::size_t index, Val& dest )
+{
+	const Node& n = image->m_nodes[index] ;
+	if ( n.type == Val::array_type )
+	{
+		Val::Array& ar = dest.AsArray() ;
+		ar.reserve( n.children.count ) ;
+		for ( uint32_t i = 0 ; i < n.children.count ; i++ )
+			ar.push_back( Value( image, n.children.first + i ) ) ;
+	}
+	else
+	{
+		Val::Object& obj = dest.AsObject() ;
+		obj.reserve( n.children.count ) ;
+		for ( uint32_t i = 0 ; i < n.children.count ; i++ )
+		{
+			std::size_t c = n.children.first + i ;
+			obj.insert( obj.end(), std::make_pair( image->String( image->m_nodes[c].key ), Value( image, c ) ) ) ;
+		}
+	}
+}
+
+/// The image holding \a val and its index there, or null if \a val is not in one.
+const Image* Image::Source( const Val& val, std::size_t& index )
+{
+	if ( !val.m_mapped )
+		return 0 ;
+	index = val.m_node.index ;
+	return val.m_node.image.get() ;
+}
+
+bool IsBinary( const char *data, std::size_t size )
+{
+	return size >= sizeof(magic) && std::memcmp( data, magic, sizeof(magic) ) == 0 ;
+}
+
+/// Decodes all of \a data, which is not needed any more afterwards.
+Val Read( const char *data, std::size_t size )
+{
+	std::shared_ptr<const Image> image( new Image( data, size ) ) ;
+	Val result = Image::Root( image ) ;
+	Expand( result ) ;
+	return result ;
+}
+
+/// Maps the first \a size bytes of \a file, and returns the Val in it. Only the
+/// parts of it which are used are decoded.
+Val Map( File& file, std::size_t size )
+{
+	std::shared_ptr<const Image> image( new Image( file, size ) ) ;
+	return Image::Root( image ) ;
+}
+
+void Write( const Val& val, DataStream *out )
+{
+	assert( out != 0 ) ;
+
+	// a value, or a node of an image for the parts of it which were not decoded
+	struct Item
+	{
+		const Val	*val ;
+		const Image	*image ;
+		std::size_t	index ;
+		uint32_t	key ;
+	} ;
+
+	std::vector<Node> nodes ;
+	StringTable strings ;
+
+	// breadth first, so that the children of each container are adjacent
+	std::deque<Item> queue ;
+	Item root = { &val, 0, 0, no_key } ;
+	queue.push_back( root ) ;
+	while ( !queue.empty() )
+	{
+		Item item = queue.front() ;
+		queue.pop_front() ;
+		if ( item.val )
+			item.image = Image::Source( *item.val, item.index ) ;
+
+		Node n ;
+		std::memset( &n, 0, sizeof(n) ) ;
+		n.key	= item.key ;
+
+		// copied from the image as they are
+		if ( item.image )
+		{
+			const Node& src = item.image->m_nodes[item.index] ;
+			n.type = src.type ;
+			switch ( src.type )
+			{
+			case Val::bool_type :
+			case Val::int_type :	n.i = src.i ;	break ;
+			case Val::double_type :	n.d = src.d ;	break ;
+			case Val::string_type :	n.str = strings.Add( item.image->String( src.str ) ) ;	break ;
+
+			case Val::array_type :
+			case Val::object_type :
+				n.children.first = nodes.size() + 1 + queue.size() ;
+				n.children.count = src.children.count ;
+				for ( uint32_t i = 0 ; i < src.children.count ; i++ )
+				{
+					const Node& c = item.image->m_nodes[src.children.first + i] ;
+					Item child = { 0, item.image, src.children.first + i,
+						src.type == Val::object_type ? strings.Add( item.image->String( c.key ) ) : no_key } ;
+					queue.push_back( child ) ;
+				}
+				break ;
+
+			default :
+				break ;
+			}
+			nodes.push_back( n ) ;
+			continue ;
+		}
+
+		const Val& v = *item.val ;
+		n.type	= v.Type() ;
+		switch ( v.Type() )
+		{
+		case Val::bool_type :	n.i = v.Bool() ;	break ;
+		case Val::int_type :	n.i = v.As<long long>() ;	break ;
+		case Val::double_type :	n.d = v.Double() ;	break ;
+		case Val::string_type :	n.str = strings.Add( v.Str() ) ;	break ;
+
+		case Val::array_type :
+		{
+			const Val::Array& ar = v.AsArray() ;
+			n.children.first = nodes.size() + 1 + queue.size() ;
+			n.children.count = ar.size() ;
+			for ( Val::Array::const_iterator i = ar.begin() ; i != ar.end() ; ++i )
+			{
+				Item child = { &*i, 0, 0, no_key } ;
+				queue.push_back( child ) ;
+			}
+			break ;
+		}
+
+		case Val::object_type :
+		{
+			const Val::Object& obj = v.AsObject() ;
+			n.children.first = nodes.size() + 1 + queue.size() ;
+			n.children.count = obj.size() ;
+			for ( Val::Object::const_iterator i = obj.begin() ; i != obj.end() ; ++i )
+			{
+				Item child = { &i->second, 0, 0, strings.Add( i->first ) } ;
+				queue.push_back( child ) ;
+			}
+			break ;
+		}
+
+		default :
+			break ;
+		}
+		nodes.push_back( n ) ;
+	}
+
+	Header hdr ;
+	std::memcpy( hdr.magic, magic, sizeof(magic) ) ;
+	hdr.version		= version ;
+	hdr.byte_order	= byte_order ;
+	hdr.node_count	= nodes.size() ;
+	hdr.string_size	= strings.Data().size() ;
+
+	out->Write( reinterpret_cast<const char*>( &hdr ), sizeof(hdr) ) ;
+	out->Write( reinterpret_cast<const char*>( &nodes[0] ), nodes.size() * sizeof(Node) ) ;
+	out->Write( strings.Data().c_str(), strings.Data().size() ) ;
+}
+
+} } // end of namespace gr::binary
@@ -0,0 +1,106 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Val.hh"
+#include "util/Exception.hh"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+
+namespace gr {
+
+class DataStream ;
+class File ;
+class MemMap ;
+
+/*!	\brief	compact binary encoding of a Val
+
+	The encoding is designed to be read straight from a memory-mapped file. After
+	a fixed header comes a flat array of fixed-size nodes, followed by a table of
+	all distinct strings. The root is node 0 and the children of an array or object
+	are stored next to each other, so a container only records the index of its
+	first child and the number of children. Keys and string values are offsets
+	in the string table, and the members of an object are sorted by key.
+
+	All numbers are in host byte order. A file written on a machine with a different
+	byte order is rejected like any other unreadable file.
+*/
+namespace binary
+{
+	struct Error : virtual Exception {} ;
+	typedef boost::error_info<struct ReasonTag, std::string> Reason ;
+
+	const unsigned version = 1 ;
+
+	struct Node ;
+
+	/*!	\brief	the nodes of an encoded Val, e.g. of a mapped state file
+
+		The whole image is checked when it is opened, so reading it later can't
+		fail. The arrays and objects of the Vals it gives are decoded when they are
+		first used (see Val), and keep the image alive until then. Members of an
+		object are looked up with a binary search, without decoding the object.
+	*/
+	class Image
+	{
+	public :
+		Image( const char *data, std::size_t size ) ;
+		Image( File& file, std::size_t size ) ;
+		~Image() ;
+
+		static Val Root( const std::shared_ptr<const Image>& image ) ;
+
+	private :
+		friend class gr::Val ;
+		friend void Write( const Val& val, DataStream *out ) ;
+
+		Image( const Image& ) ;
+		Image& operator=( const Image& ) ;
+
+		void Open( const char *data, std::size_t size ) ;
+		void CheckString( uint32_t offset ) const ;
+		int Compare( uint32_t offset, const char *str, std::size_t len ) const ;
+		std::string String( uint32_t offset ) const ;
+
+		bool Find( std::size_t index, const std::string& key, std::size_t& child ) const ;
+		static Val Value( const std::shared_ptr<const Image>& image, std::size_t index ) ;
+		static void Decode( const std::shared_ptr<const Image>& image, std::size_t index, Val& dest ) ;
+		static const Image* Source( const Val& val, std::size_t& index ) ;
+
+	private :
+		std::unique_ptr<MemMap>	m_map ;
+		const Node				*m_nodes ;
+		uint64_t				m_node_count ;
+		const char				*m_strings ;
+		uint64_t				m_string_size ;
+	} ;
+
+	bool IsBinary( const char *data, std::size_t size ) ;
+	Val Read( const char *data, std::size_t size ) ;
+	Val Map( File& file, std::size_t size ) ;
+	void Write( const Val& val, DataStream *out ) ;
+}
+
+} // end of namespace
@@ -0,0 +1,170 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#include "ItemBuilder.hh"
+
+namespace gr {
+
+ItemBuilder::ItemBuilder( const std::string& key, const Callback& callback ) :
+	m_key		( key ),
+	m_callback	( callback ),
+	m_building	( false ),
+	m_depth		( 0 ),
+	m_in_items	( false )
+{
+}
+
+ItemBuilder::~ItemBuilder()
+{
+}
+
+/// the builder receiving the current event: the item in progress if there is one
+ValVisitor* ItemBuilder::Target()
+{
+	if ( m_building )
+		return &m_item ;
+	return &m_page ;
+}
+
+void ItemBuilder::Item( const Val& item )
+{
+	m_callback( item ) ;
+}
+
+void ItemBuilder::Visit( long long t )
+{
+	if ( m_in_items && !m_building )
+		Item( Val( t ) ) ;
+	else
+		Target()->Visit( t ) ;
+}
+
+void ItemBuilder::Visit( double t )
+{
+	if ( m_in_items && !m_building )
+		Item( Val( t ) ) ;
+	else
+		Target()->Visit( t ) ;
+}
+
+void ItemBuilder::Visit( const std::string& t )
+{
+	if ( m_in_items && !m_building )
+		Item( Val( t ) ) ;
+	else
+		Target()->Visit( t ) ;
+}
+
+void ItemBuilder::VisitChars( const char *str, std::size_t len )
+{
+	if ( m_in_items && !m_building )
+		Item( Val( std::string( str, len ) ) ) ;
+	else
+		Target()->VisitChars( str, len ) ;
+}
+
+void ItemBuilder::Visit( bool t )
+{
+	if ( m_in_items && !m_building )
+		Item( Val( t ) ) ;
+	else
+		Target()->Visit( t ) ;
+}
+
+void ItemBuilder::VisitNull()
+{
+	if ( m_in_items && !m_building )
+		Item( Val::Null() ) ;
+	else
+		Target()->VisitNull() ;
+}
+
+void ItemBuilder::VisitKey( const std::string& t )
+{
+	if ( m_depth == 1 )
+		m_last_key = t ;
+	Target()->VisitKey( t ) ;
+}
+
+void ItemBuilder::VisitKeyChars( const char *str, std::size_t len )
+{
+	if ( m_depth == 1 )
+		m_last_key.assign( str, len ) ;
+	Target()->VisitKeyChars( str, len ) ;
+}
+
+void ItemBuilder::Start()
+{
+	// a new element of the array
+	if ( m_in_items && m_depth == 2 )
+		m_building = true ;
+
+	m_depth++ ;
+}
+
+void ItemBuilder::End()
+{
+	m_depth-- ;
+
+	// the element is complete
+	if ( m_building && m_depth == 2 )
+	{
+		Val item = m_item.TakeResult() ;
+		m_building = false ;
+		Item( item ) ;
+	}
+}
+
+void ItemBuilder::StartArray()
+{
+	Start() ;
+	Target()->StartArray() ;
+
+	if ( m_depth == 2 && m_last_key == m_key )
+		m_in_items = true ;
+}
+
+void ItemBuilder::EndArray()
+{
+	if ( m_in_items && m_depth == 2 )
+		m_in_items = false ;
+
+	Target()->EndArray() ;
+	End() ;
+}
+
+void ItemBuilder::StartObject()
+{
+	Start() ;
+	Target()->StartObject() ;
+}
+
+void ItemBuilder::EndObject()
+{
+	Target()->EndObject() ;
+	End() ;
+}
+
+Val ItemBuilder::Result() const
+{
+	return m_page.Result() ;
+}
+
+} // end of namespace
@@ -0,0 +1,89 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "ValVisitor.hh"
+#include "ValBuilder.hh"
+
+#include "Val.hh"
+
+#include <boost/function.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace gr {
+
+/*!	\brief	builds the elements of a big array one at a time
+
+	This visitor hands each element of one array in the top-level object to
+	a callback as soon as the element is complete, so that the whole array
+	is never built in memory. Everything else in the document is kept and
+	returned by Result(), with the array left empty.
+*/
+class ItemBuilder : public ValVisitor
+{
+public :
+	typedef boost::function<void ( const Val& )> Callback ;
+
+public :
+	ItemBuilder( const std::string& key, const Callback& callback ) ;
+	~ItemBuilder() ;
+
+	void Visit( long long t ) ;
+	void Visit( double t ) ;
+	void Visit( const std::string& t ) ;
+	void VisitChars( const char *str, std::size_t len ) ;
+	void Visit( bool t ) ;
+	void VisitNull() ;
+
+	void StartArray() ;
+	void EndArray() ;
+	void StartObject() ;
+	void VisitKey( const std::string& t ) ;
+	void VisitKeyChars( const char *str, std::size_t len ) ;
+	void EndObject() ;
+
+	Val Result() const ;
+
+private :
+	ValVisitor* Target() ;
+	void Start() ;
+	void End() ;
+	void Item( const Val& item ) ;
+
+private :
+	std::string		m_key ;
+	Callback		m_callback ;
+
+	ValBuilder		m_page ;
+
+	// reused for all elements
+	ValBuilder		m_item ;
+	bool			m_building ;
+
+	// number of arrays and objects opened
+	int				m_depth ;
+	std::string		m_last_key ;
+	bool			m_in_items ;
+} ;
+
+} // end of namespace
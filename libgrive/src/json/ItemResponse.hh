@@ -0,0 +1,56 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "util/DataStream.hh"
+
+#include "ItemBuilder.hh"
+#include "JsonParser.hh"
+
+namespace gr
+{
+	class Val ;
+}
+
+namespace gr { namespace http {
+
+/*!	\brief	JSON response decoded while it is received
+
+	The elements of the array \a key are handed to the callback one by one
+	as soon as they arrive, see ItemBuilder.
+*/
+class ItemResponse : public DataStream
+{
+public :
+	ItemResponse( const std::string& key, const ItemBuilder::Callback& callback ) ;
+
+	std::size_t Write( const char *data, std::size_t count ) ;
+	std::size_t Read( char *data, std::size_t count ) ;
+
+	void Finish() ;
+	Val Response() const ;
+	
+private :
+	ItemBuilder	m_val ;
+	JsonParser	m_parser ;
+} ;
+
+} } // end of namespace gr::http
@@ -60,7 +60,7 @@ namespace
 	int OnStr( void *ctx, const unsigned char *str, std::size_t len )
 	{
 		ValVisitor *b = reinterpret_cast<ValVisitor*>(ctx) ;
-		b->Visit( std::string(reinterpret_cast<const char*>(str), len) ) ;
+		b->VisitChars( reinterpret_cast<const char*>(str), len ) ;
 		return true ;
 	}
 	
@@ -74,7 +74,7 @@ namespace
 	int OnMapKey( void *ctx, const unsigned char *str, std::size_t len )
 	{
 		ValVisitor *b = reinterpret_cast<ValVisitor*>(ctx) ;
-		b->VisitKey( std::string(reinterpret_cast<const char*>(str), len) ) ;
+		b->VisitKeyChars( reinterpret_cast<const char*>(str), len ) ;
 		return true ;
 	}
 	
@@ -120,7 +120,7 @@ Val ParseJson( const std::string& json )
 	JsonParser parser( &b ) ;
 	parser.Parse( json.c_str(), json.size() ) ;
 	parser.Finish() ;
-	return b.Result();
+	return b.TakeResult();
 }
 
 Val ParseJson( DataStream &in )
@@ -129,7 +129,7 @@ Val ParseJson( DataStream &in )
 	JsonParser parser( &b ) ;
 	parser.Parse( in ) ;
 	parser.Finish() ;
-	return b.Result();
+	return b.TakeResult();
 }
 
 struct JsonParser::Impl
@@ -19,6 +19,8 @@
 */
 
 #include "JsonWriter.hh"
+#include "util/BufferedStream.hh"
+#include "util/File.hh"
 #include "util/StringStream.hh"
 
 #include <yajl/yajl_gen.h>
@@ -116,4 +118,19 @@ std::string WriteJson( const Val& val )
 	return ss.Str() ;
 }
 
+/// Writes \a val to \a file in large blocks. With \a sync, it is also flushed
+/// to the disk before returning.
+void WriteJson( const Val& val, File& file, bool sync )
+{
+	BufferedStream out( &file ) ;
+	{
+		JsonWriter wr( &out ) ;
+		val.Visit( &wr ) ;
+	}
+	out.Flush() ;
+
+	if ( sync )
+		file.Sync() ;
+}
+
 } // end of namespace
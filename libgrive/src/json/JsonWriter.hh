@@ -27,6 +27,7 @@
 namespace gr {
 
 class DataStream ;
+class File ;
 
 class JsonWriter : public ValVisitor
 {
@@ -55,6 +56,7 @@ private :
 } ;
 
 std::string WriteJson( const Val& val );
+void WriteJson( const Val& val, File& file, bool sync = false ) ;
 
 } // end of namespace
 
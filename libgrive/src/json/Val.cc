@@ -19,14 +19,30 @@
 */
 
 #include "Val.hh"
+#include "BinaryVal.hh"
 #include "JsonWriter.hh"
 #include "ValVisitor.hh"
 #include "util/StdStream.hh"
 
+#include <algorithm>
 #include <iostream>
 
 namespace gr {
 
+// members are allocated in chunks of this size at most
+const std::size_t max_chunk_size	= 1024 ;
+
+// keys in a block of an object, before it is split
+const std::size_t block_size		= 128 ;
+
+namespace
+{
+	bool KeyLess( const Val::Object::value_type *v, const std::string& key )
+	{
+		return v->first < key ;
+	}
+}
+
 const Val& Val::Null()
 {
 	static const Val null( null_type ) ;
@@ -34,37 +50,193 @@ const Val& Val::Null()
 }
 
 Val::Val( ) :
-	m_base( new Impl<Object> )
+	m_type( object_type ),
+	m_mapped( false ),
+	m_object( 0 )
 {
 }
 
-Val::Val( TypeEnum type )
+Val::Val( TypeEnum type ) :
+	m_type( type ),
+	m_mapped( false )
 {
 	switch ( type )
 	{
-		case int_type:		m_base.reset( new Impl<long long> ) ;	break ;
-		case bool_type:		m_base.reset( new Impl<bool> ) ; 		break ;
-		case double_type:	m_base.reset( new Impl<double> ) ; 		break ;
-		case string_type:	m_base.reset( new Impl<std::string> ) ;	break ;
-		case array_type:	m_base.reset( new Impl<Array> ) ; break ;
-		case object_type:	m_base.reset( new Impl<Object> ) ; break ;
-		case null_type:	
-		default:			m_base.reset( new Impl<void> ) ; break ;
+		case int_type:		m_int = 0 ;						break ;
+		case bool_type:		m_bool = false ;				break ;
+		case double_type:	m_double = 0 ;					break ;
+		case string_type:	new ( &m_str ) std::string ;	break ;
+		case array_type:	m_array = 0 ;					break ;
+		case object_type:	m_object = 0 ;					break ;
+		case null_type:
+		default:			m_type = null_type ;			break ;
 	}
 }
 
 Val::Val( const Val& v ) :
-	m_base( v.m_base->Clone() )
+	m_type( v.m_type ),
+	m_mapped( v.m_mapped )
+{
+	// stays in the image
+	if ( m_mapped )
+	{
+		new ( &m_node ) Node( v.m_node ) ;
+		return ;
+	}
+
+	switch ( m_type )
+	{
+		case int_type:		m_int = v.m_int ;						break ;
+		case bool_type:		m_bool = v.m_bool ;						break ;
+		case double_type:	m_double = v.m_double ;					break ;
+		case string_type:	new ( &m_str ) std::string( v.m_str ) ;	break ;
+		case array_type:	m_array = v.m_array ? new Array( *v.m_array ) : 0 ;		break ;
+		case object_type:	m_object = v.m_object ? new Object( *v.m_object ) : 0 ;	break ;
+		case null_type:		break ;
+	}
+}
+
+Val::Val( Val&& v ) :
+	m_type( null_type ),
+	m_mapped( false )
+{
+	Take( v ) ;
+}
+
+Val::Val( std::string&& s ) :
+	m_type( string_type ),
+	m_mapped( false )
+{
+	new ( &m_str ) std::string( std::move( s ) ) ;
+}
+
+Val::Val( Array&& a ) :
+	m_type( array_type ),
+	m_mapped( false ),
+	m_array( a.empty() ? 0 : new Array( std::move( a ) ) )
+{
+}
+
+Val::Val( Object&& o ) :
+	m_type( object_type ),
+	m_mapped( false ),
+	m_object( o.empty() ? 0 : new Object( std::move( o ) ) )
 {
 }
 
 Val::~Val()
 {
+	Destroy() ;
+}
+
+/// Moves the value of \a v into this, which must hold no value. Strings stay
+/// in \a v as empty strings, arrays and objects as empty ones.
+void Val::Take( Val& v )
+{
+	m_type = v.m_type ;
+	if ( v.m_mapped )
+	{
+		new ( &m_node ) Node( std::move( v.m_node ) ) ;
+		m_mapped = true ;
+		v.Destroy() ;
+		v.m_type	= m_type ;
+		v.m_object	= 0 ;
+		return ;
+	}
+
+	switch ( m_type )
+	{
+		case int_type:		m_int = v.m_int ;			break ;
+		case bool_type:		m_bool = v.m_bool ;			break ;
+		case double_type:	m_double = v.m_double ;		break ;
+		case string_type:	new ( &m_str ) std::string( std::move( v.m_str ) ) ;	break ;
+		case array_type:	m_array = v.m_array ;	v.m_array = 0 ;		break ;
+		case object_type:	m_object = v.m_object ;	v.m_object = 0 ;	break ;
+		case null_type:		break ;
+	}
+}
+
+void Val::Destroy()
+{
+	if ( m_mapped )
+	{
+		m_node.~Node() ;
+		m_mapped = false ;
+		m_type = null_type ;
+		return ;
+	}
+
+	switch ( m_type )
+	{
+		case string_type:	m_str.~basic_string() ;	break ;
+		case array_type:	delete m_array ;		break ;
+		case object_type:	delete m_object ;		break ;
+		default:									break ;
+	}
+	m_type = null_type ;
+}
+
+void Val::Throw( TypeEnum dest ) const
+{
+	BOOST_THROW_EXCEPTION(
+		Error() << SrcType_( Type() ) << DestType_( dest )
+	) ;
+}
+
+/// Replaces an array or object still in its image with its members. This is
+/// the only change made through a const Val.
+void Val::Decode() const
+{
+	if ( !m_mapped )
+		return ;
+
+	Val *self = const_cast<Val*>( this ) ;
+	Node node( std::move( self->m_node ) ) ;
+	self->m_node.~Node() ;
+	self->m_mapped = false ;
+	self->m_object = 0 ;
+	binary::Image::Decode( node.image, node.index, *self ) ;
+}
+
+template <>
+const Val::Array& Val::Get<Val::Array>() const
+{
+	Decode() ;
+	static const Array empty ;
+	return m_array ? *m_array : empty ;
+}
+
+template <>
+const Val::Object& Val::Get<Val::Object>() const
+{
+	Decode() ;
+	static const Object empty ;
+	return m_object ? *m_object : empty ;
+}
+
+template <>
+Val::Array& Val::Get<Val::Array>()
+{
+	Decode() ;
+	if ( !m_array )
+		m_array = new Array ;
+	return *m_array ;
+}
+
+template <>
+Val::Object& Val::Get<Val::Object>()
+{
+	Decode() ;
+	if ( !m_object )
+		m_object = new Object ;
+	return *m_object ;
 }
 
 void Val::Swap( Val& val )
 {
-	std::swap( m_base, val.m_base ) ;
+	Val tmp( std::move( val ) ) ;
+	val = std::move( *this ) ;
+	*this = std::move( tmp ) ;
 }
 
 Val& Val::operator=( const Val& val )
@@ -74,9 +246,26 @@ Val& Val::operator=( const Val& val )
 	return *this ;
 }
 
+Val& Val::operator=( Val&& val )
+{
+	if ( this != &val )
+	{
+		Destroy() ;
+		Take( val ) ;
+	}
+	return *this ;
+}
+
 Val::TypeEnum Val::Type() const
 {
-	return m_base->Type() ;
+	return m_type ;
+}
+
+/// Tells if this is an array or object still in the binary image it was read
+/// from, i.e. which has not been used or changed since.
+bool Val::IsMapped() const
+{
+	return m_mapped ;
 }
 
 const Val& Val::operator[]( const std::string& key ) const
@@ -174,6 +363,10 @@ Val::Object& Val::AsObject()
 
 bool Val::Has( const std::string& key ) const
 {
+	std::size_t child ;
+	if ( m_mapped && m_type == object_type )
+		return m_node.image->Find( m_node.index, key, child ) ;
+
 	const Object& obj = As<Object>() ;
 	return obj.find(key) != obj.end() ;
 }
@@ -191,6 +384,15 @@ Val& Val::Item( const std::string& key )
 
 bool Val::Get( const std::string& key, Val& val ) const
 {
+	std::size_t child ;
+	if ( m_mapped && m_type == object_type )
+	{
+		if ( !m_node.image->Find( m_node.index, key, child ) )
+			return false ;
+		val = binary::Image::Value( m_node.image, child ) ;
+		return true ;
+	}
+
 	const Object& obj = As<Object>() ;
 	Object::const_iterator i = obj.find(key) ;
 	if ( i != obj.end() )
@@ -204,17 +406,26 @@ bool Val::Get( const std::string& key, Val& val ) const
 
 void Val::Add( const std::string& key, const Val& value )
 {
-	As<Object>().insert( std::make_pair(key, value) ) ;
+	Object& obj = As<Object>() ;
+	if ( obj.find( key ) == obj.end() )
+		obj[key] = value ;
+}
+
+void Val::Add( const std::string& key, Val&& value )
+{
+	Object& obj = As<Object>() ;
+	if ( obj.find( key ) == obj.end() )
+		obj[key] = std::move( value ) ;
 }
 
 void Val::Set( const std::string& key, const Val& value )
 {
-	Object& obj = As<Object>();
-	Object::iterator i = obj.find(key);
-	if (i == obj.end())
-		obj.insert(std::make_pair(key, value));
-	else
-		i->second = value;
+	As<Object>()[key] = value ;
+}
+
+void Val::Set( const std::string& key, Val&& value )
+{
+	As<Object>()[key] = std::move( value ) ;
 }
 
 void Val::Add( const Val& json )
@@ -222,6 +433,11 @@ void Val::Add( const Val& json )
 	As<Array>().push_back( json ) ;
 }
 
+void Val::Add( Val&& json )
+{
+	As<Array>().push_back( std::move( json ) ) ;
+}
+
 void Val::Visit( ValVisitor *visitor ) const
 {
 	switch ( Type() )
@@ -290,6 +506,234 @@ std::vector<Val> Val::Select( const std::string& key ) const
 	return result ;
 }
 
+Val::Object::Object() :
+	m_size( 0 ),
+	m_chunk_free( 0 )
+{
+}
+
+Val::Object::Object( const Object& obj ) :
+	m_size( 0 ),
+	m_chunk_free( 0 )
+{
+	reserve( obj.size() ) ;
+	for ( const_iterator i = obj.begin() ; i != obj.end() ; ++i )
+		insert( end(), value_type( *i ) ) ;
+}
+
+Val::Object::Object( Object&& obj ) :
+	m_size( 0 ),
+	m_chunk_free( 0 )
+{
+	swap( obj ) ;
+}
+
+Val::Object::~Object()
+{
+}
+
+Val::Object& Val::Object::operator=( Object obj )
+{
+	swap( obj ) ;
+	return *this ;
+}
+
+void Val::Object::swap( Object& obj )
+{
+	m_blocks.swap( obj.m_blocks ) ;
+	std::swap( m_size, obj.m_size ) ;
+	m_chunks.swap( obj.m_chunks ) ;
+	std::swap( m_chunk_free, obj.m_chunk_free ) ;
+	m_free.swap( obj.m_free ) ;
+}
+
+Val::Object::iterator Val::Object::begin()
+{
+	return iterator( this, 0, 0 ) ;
+}
+
+Val::Object::iterator Val::Object::end()
+{
+	return iterator( this, m_blocks.size(), 0 ) ;
+}
+
+Val::Object::const_iterator Val::Object::begin() const
+{
+	return const_iterator( this, 0, 0 ) ;
+}
+
+Val::Object::const_iterator Val::Object::end() const
+{
+	return const_iterator( this, m_blocks.size(), 0 ) ;
+}
+
+Val::Object::size_type Val::Object::size() const
+{
+	return m_size ;
+}
+
+bool Val::Object::empty() const
+{
+	return m_size == 0 ;
+}
+
+/// Finds the block where \a key is or would be inserted, and its position in
+/// the block. Returns true if the key is there.
+bool Val::Object::Locate( const std::string& key, std::size_t& block, std::size_t& pos ) const
+{
+	block = pos = 0 ;
+	if ( m_blocks.empty() )
+		return false ;
+
+	// the last block not starting after the key
+	std::size_t end = m_blocks.size() ;
+	while ( end - block > 1 )
+	{
+		std::size_t mid = ( block + end ) / 2 ;
+		if ( key < m_blocks[mid].front()->first )
+			end = mid ;
+		else
+			block = mid ;
+	}
+
+	const Block& b = m_blocks[block] ;
+	Block::const_iterator i = std::lower_bound( b.begin(), b.end(), key, &KeyLess ) ;
+	pos = i - b.begin() ;
+	return i != b.end() && (*i)->first == key ;
+}
+
+Val::Object::iterator Val::Object::find( const std::string& key )
+{
+	std::size_t block, pos ;
+	return Locate( key, block, pos ) ? iterator( this, block, pos ) : end() ;
+}
+
+Val::Object::const_iterator Val::Object::find( const std::string& key ) const
+{
+	std::size_t block, pos ;
+	return Locate( key, block, pos ) ? const_iterator( this, block, pos ) : end() ;
+}
+
+Val& Val::Object::operator[]( const std::string& key )
+{
+	bool added ;
+	return Insert( key, added )->second ;
+}
+
+/// Returns the member with \a key, adding a null one if there is none.
+Val::Object::value_type* Val::Object::Insert( const std::string& key, bool& added )
+{
+	std::size_t block, pos ;
+	added = !Locate( key, block, pos ) ;
+	if ( !added )
+		return m_blocks[block][pos] ;
+
+	value_type *v = NewSlot() ;
+	v->first = key ;
+	m_size++ ;
+
+	if ( m_blocks.empty() )
+		m_blocks.push_back( Block( 1, v ) ) ;
+
+	// keys in order fill up the last block and start a new one
+	else if ( block + 1 == m_blocks.size() && pos == m_blocks[block].size() && pos >= block_size )
+	{
+		m_blocks.push_back( Block() ) ;
+		m_blocks.back().reserve( block_size ) ;
+		m_blocks.back().push_back( v ) ;
+	}
+
+	else
+	{
+		Block& b = m_blocks[block] ;
+		b.insert( b.begin() + pos, v ) ;
+
+		if ( b.size() > block_size )
+		{
+			Block second( b.begin() + b.size() / 2, b.end() ) ;
+			b.resize( b.size() / 2 ) ;
+			m_blocks.insert( m_blocks.begin() + block + 1, Block() )->swap( second ) ;
+		}
+	}
+	return v ;
+}
+
+std::pair<Val::Object::iterator, bool> Val::Object::insert( const value_type& val )
+{
+	return insert( value_type( val ) ) ;
+}
+
+std::pair<Val::Object::iterator, bool> Val::Object::insert( value_type&& val )
+{
+	bool added ;
+	value_type *v = Insert( val.first, added ) ;
+	if ( added )
+		v->second = std::move( val.second ) ;
+	return std::make_pair( find( val.first ), added ) ;
+}
+
+/// Inserts \a val if its key is not there. Members inserted in order are
+/// simply appended, so the hint is not needed.
+Val::Object::iterator Val::Object::insert( const_iterator, value_type&& val )
+{
+	return insert( std::move( val ) ).first ;
+}
+
+Val::Object::size_type Val::Object::erase( const std::string& key )
+{
+	std::size_t block, pos ;
+	if ( !Locate( key, block, pos ) )
+		return 0 ;
+
+	Block& b = m_blocks[block] ;
+	value_type *v = b[pos] ;
+	b.erase( b.begin() + pos ) ;
+	if ( b.empty() )
+		m_blocks.erase( m_blocks.begin() + block ) ;
+
+	// the slot is reused by the next insert
+	v->first.clear() ;
+	v->second = Val() ;
+	m_free.push_back( v ) ;
+	m_size-- ;
+	return 1 ;
+}
+
+void Val::Object::clear()
+{
+	Object().swap( *this ) ;
+}
+
+/// Makes room for \a count more members without allocating each of them.
+void Val::Object::reserve( size_type count )
+{
+	if ( count > m_chunk_free + m_free.size() )
+		AddChunk( count - m_free.size() ) ;
+}
+
+void Val::Object::AddChunk( std::size_t count )
+{
+	m_chunks.push_back( std::unique_ptr<value_type[]>( new value_type[count] ) ) ;
+	m_chunk_free = count ;
+}
+
+Val::Object::value_type* Val::Object::NewSlot()
+{
+	if ( !m_free.empty() )
+	{
+		value_type *v = m_free.back() ;
+		m_free.pop_back() ;
+		return v ;
+	}
+
+	// chunks grow with the object, so small objects stay small
+	if ( m_chunk_free == 0 )
+		AddChunk( std::min( std::max<std::size_t>( m_size, 4 ), max_chunk_size ) ) ;
+
+	// the chunk is used from its end
+	return &m_chunks.back()[--m_chunk_free] ;
+}
+
 std::ostream& operator<<( std::ostream& os, const Val& val )
 {
 	StdStream ss( os.rdbuf() ) ;
@@ -24,15 +24,32 @@
 
 #include <cstddef>
 #include <iosfwd>
-#include <map>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace gr {
 
 class ValVisitor ;
 
+namespace binary { class Image ; }
+
+/*!	\brief	a JSON value
+
+	The value is a tagged union. Numbers, booleans and strings are stored in
+	the Val itself, so they need no allocation of their own beyond what
+	std::string does for long strings. Arrays and objects are allocated when
+	they get their first element.
+
+	Arrays and objects read from a binary::Image stay in the image until they
+	are used, and are then decoded one level at a time: their members which are
+	arrays or objects stay in the image in turn. Has() and Get() look up the
+	members of an object in the image without decoding it. Decoding changes the
+	Val even through a const reference, so like any change it must not happen
+	in two threads at once.
+*/
 class Val
 {
 public :
@@ -52,19 +69,25 @@ private :
 	struct SupportType ;
 
 public :
+	class Object ;
 	typedef std::vector<Val>			Array ;
-	typedef std::map<std::string, Val>	Object ;
 
 public :
 	Val() ;
 	Val( const Val& v ) ;
+	Val( Val&& v ) ;
 	explicit Val( TypeEnum type ) ;
+	explicit Val( std::string&& s ) ;
+	explicit Val( Array&& a ) ;
+	explicit Val( Object&& o ) ;
 	~Val() ;
 
 	static const Val& Null() ;
 
 	template <typename T>
-	explicit Val( const T& t )
+	explicit Val( const T& t ) :
+		m_type( null_type ),
+		m_mapped( false )
 	{
 		Assign(t) ;
 	}
@@ -74,6 +97,7 @@ public :
 	
 	void Swap( Val& val ) ;
 	Val& operator=( const Val& val ) ;
+	Val& operator=( Val&& val ) ;
 		
 	template <typename T>
 	Val& operator=( const T& t )
@@ -93,6 +117,7 @@ public :
 	bool Is() const ;
 
 	TypeEnum Type() const ;
+	bool IsMapped() const ;
 
 	// shortcuts for As<>()
 	std::string Str() const ;
@@ -112,12 +137,15 @@ public :
 	bool Has( const std::string& key ) const ; // check if exists
 	bool Get( const std::string& key, Val& val ) const ; // get or return false
 	void Add( const std::string& key, const Val& val ) ; // insert or do nothing
+	void Add( const std::string& key, Val&& val ) ;
 	void Set( const std::string& key, const Val& val ) ; // insert or update
+	void Set( const std::string& key, Val&& val ) ;
 	bool Del( const std::string& key ); // delete or do nothing
 	
 	// shortcuts for array (and array of objects)
 	const Val& operator[]( std::size_t index ) const ;
 	void Add( const Val& json ) ;
+	void Add( Val&& json ) ;
 	
 	std::vector<Val> Select( const std::string& key ) const ;
 	
@@ -125,17 +153,193 @@ public :
 	void Visit( ValVisitor *visitor ) const ;
 
 private :
-	struct Base ;
+	template <typename T>
+	const T& Get() const ;
 
 	template <typename T>
-	struct Impl ;
-	
-	std::unique_ptr<Base>	m_base ;
+	T& Get() ;
+
+	void Take( Val& v ) ;
+	void Destroy() ;
+	void Decode() const ;
+
+	void Throw( TypeEnum dest ) const ;
+
+private :
+	friend class binary::Image ;
+
+	/// an array or object still in a binary image
+	struct Node
+	{
+		std::shared_ptr<const binary::Image>	image ;
+		std::size_t								index ;
+	} ;
+
+	TypeEnum	m_type ;
+	bool		m_mapped ;
+	union
+	{
+		bool		m_bool ;
+		long long	m_int ;
+		double		m_double ;
+		std::string	m_str ;
+
+		// null for an empty array or object
+		Array		*m_array ;
+		Object		*m_object ;
+
+		// if m_mapped
+		Node		m_node ;
+	} ;
 
 private :
 	void Select( const Object& obj, const std::string& key, std::vector<Val>& result ) const ;
 } ;
 
+/*!	\brief	members of a JSON object, sorted by key
+
+	The keys are kept in blocks of sorted pointers, which are binary searched.
+	Objects read from JSON arrive sorted, as we write them, and are simply
+	appended to the last block. Random inserts only move the pointers of one
+	block, so large objects like the remote file list in the state stay cheap
+	to update.
+
+	The members themselves are allocated in chunks owned by the object, and
+	they don't move until they are erased, like the nodes of a std::map.
+	Resources rely on that to keep pointers to their entries in the state.
+*/
+class Val::Object
+{
+public :
+	typedef std::string						key_type ;
+	typedef Val								mapped_type ;
+	typedef std::pair<std::string, Val>		value_type ;
+	typedef std::size_t						size_type ;
+
+	template <typename V>
+	class Iterator ;
+
+	typedef Iterator<value_type>			iterator ;
+	typedef Iterator<const value_type>		const_iterator ;
+
+public :
+	Object() ;
+	Object( const Object& obj ) ;
+	Object( Object&& obj ) ;
+	~Object() ;
+
+	Object& operator=( Object obj ) ;
+	void swap( Object& obj ) ;
+
+	iterator begin() ;
+	iterator end() ;
+	const_iterator begin() const ;
+	const_iterator end() const ;
+
+	size_type size() const ;
+	bool empty() const ;
+
+	iterator find( const std::string& key ) ;
+	const_iterator find( const std::string& key ) const ;
+	Val& operator[]( const std::string& key ) ;
+
+	std::pair<iterator, bool> insert( const value_type& val ) ;
+	std::pair<iterator, bool> insert( value_type&& val ) ;
+	iterator insert( const_iterator hint, value_type&& val ) ;
+	size_type erase( const std::string& key ) ;
+	void clear() ;
+	void reserve( size_type count ) ;
+
+private :
+	typedef std::vector<value_type*> Block ;
+
+	bool Locate( const std::string& key, std::size_t& block, std::size_t& pos ) const ;
+	value_type* Insert( const std::string& key, bool& added ) ;
+	value_type* NewSlot() ;
+	void AddChunk( std::size_t count ) ;
+
+private :
+	std::vector<Block>		m_blocks ;
+	std::size_t				m_size ;
+
+	std::vector< std::unique_ptr<value_type[]> > m_chunks ;
+	std::size_t				m_chunk_free ;
+	std::vector<value_type*> m_free ;
+} ;
+
+template <typename V>
+class Val::Object::Iterator
+{
+public :
+	typedef std::forward_iterator_tag	iterator_category ;
+	typedef V							value_type ;
+	typedef std::ptrdiff_t				difference_type ;
+	typedef V*							pointer ;
+	typedef V&							reference ;
+
+public :
+	Iterator() : m_obj( 0 ), m_block( 0 ), m_pos( 0 )
+	{
+	}
+
+	// iterators convert to const_iterators
+	Iterator( const Iterator<Object::value_type>& i ) :
+		m_obj( i.m_obj ), m_block( i.m_block ), m_pos( i.m_pos )
+	{
+	}
+
+	reference operator*() const
+	{
+		return *m_obj->m_blocks[m_block][m_pos] ;
+	}
+
+	pointer operator->() const
+	{
+		return m_obj->m_blocks[m_block][m_pos] ;
+	}
+
+	Iterator& operator++()
+	{
+		if ( ++m_pos == m_obj->m_blocks[m_block].size() )
+		{
+			m_block++ ;
+			m_pos = 0 ;
+		}
+		return *this ;
+	}
+
+	Iterator operator++( int )
+	{
+		Iterator tmp( *this ) ;
+		++*this ;
+		return tmp ;
+	}
+
+	bool operator==( const Iterator& i ) const
+	{
+		return m_block == i.m_block && m_pos == i.m_pos ;
+	}
+
+	bool operator!=( const Iterator& i ) const
+	{
+		return !( *this == i ) ;
+	}
+
+private :
+	friend class Object ;
+	template <typename U> friend class Iterator ;
+
+	Iterator( const Object *obj, std::size_t block, std::size_t pos ) :
+		m_obj( obj ), m_block( block ), m_pos( pos )
+	{
+	}
+
+private :
+	const Object	*m_obj ;
+	std::size_t		m_block ;
+	std::size_t		m_pos ;
+} ;
+
 template <> struct Val::Type2Enum<void>			{ static const TypeEnum type = null_type ; } ;
 template <> struct Val::Type2Enum<long long>	{ static const TypeEnum type = int_type ;  } ;
 template <> struct Val::Type2Enum<bool>			{ static const TypeEnum type = bool_type ; } ;
@@ -160,63 +364,45 @@ template <> struct Val::SupportType<const char*>	{ typedef std::string	Type ; }
 template <> struct Val::SupportType<Val::Array>		{ typedef Val::Array	Type ; } ;
 template <> struct Val::SupportType<Val::Object>	{ typedef Val::Object	Type ; } ;
 
-struct Val::Base
-{
-	virtual ~Base() {}
-	virtual Base* Clone() const = 0 ;
-	virtual TypeEnum Type() const = 0 ;
-} ;
+template <> inline const bool&			Val::Get<bool>() const			{ return m_bool ; }
+template <> inline const long long&		Val::Get<long long>() const		{ return m_int ; }
+template <> inline const double&		Val::Get<double>() const		{ return m_double ; }
+template <> inline const std::string&	Val::Get<std::string>() const	{ return m_str ; }
 
-template <typename T>
-struct Val::Impl : public Base
-{
-	T val ;
-	Impl( ) : val() {}
-	Impl( const T& t ) : val(t) {}
-	Impl<T>* Clone() const { return new Impl<T>(val); }
-	TypeEnum Type() const { return Type2Enum<T>::type ; }
-} ;
+template <> inline bool&		Val::Get<bool>()		{ return m_bool ; }
+template <> inline long long&	Val::Get<long long>()	{ return m_int ; }
+template <> inline double&		Val::Get<double>()		{ return m_double ; }
+template <> inline std::string&	Val::Get<std::string>()	{ return m_str ; }
 
-template <>
-struct Val::Impl<void>	: public Base
-{
-	Impl<void>* Clone() const { return new Impl<void>; }
-	TypeEnum Type() const { return null_type ; }
-} ;
+template <> const Val::Array&	Val::Get<Val::Array>() const ;
+template <> const Val::Object&	Val::Get<Val::Object>() const ;
+template <> Val::Array&			Val::Get<Val::Array>() ;
+template <> Val::Object&		Val::Get<Val::Object>() ;
 
 template <typename T>
 Val& Val::Assign( const T& t )
 {
-	m_base.reset( new Impl<typename SupportType<T>::Type>(t) ) ;
-	return *this ;
+	typedef typename SupportType<T>::Type Type ;
+
+	Val tmp( Type2Enum<Type>::type ) ;
+	tmp.Get<Type>() = t ;
+	return *this = std::move( tmp ) ;
 }
 
 template <typename T>
 const T& Val::As() const
 {
-	const Impl<T> *impl = dynamic_cast<const Impl<T> *>( m_base.get() ) ;
-	if ( !impl )
-	{
-		TypeEnum dest = Type2Enum<T>::type ;
-		BOOST_THROW_EXCEPTION(
-			Error() << SrcType_( Type() ) << DestType_( dest )
-		) ;
-	}
-	return impl->val ;
+	if ( m_type != Type2Enum<T>::type )
+		Throw( Type2Enum<T>::type ) ;
+	return Get<T>() ;
 }
 
 template <typename T>
 T& Val::As()
 {
-	Impl<T> *impl = dynamic_cast<Impl<T> *>( m_base.get() ) ;
-	if ( !impl )
-	{
-		TypeEnum dest = Type2Enum<T>::type ;
-		BOOST_THROW_EXCEPTION(
-			Error() << SrcType_( Type() ) << DestType_( dest )
-		) ;
-	}
-	return impl->val ;
+	if ( m_type != Type2Enum<T>::type )
+		Throw( Type2Enum<T>::type ) ;
+	return Get<T>() ;
 }
 
 template <typename T>
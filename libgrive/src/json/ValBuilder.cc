@@ -22,7 +22,8 @@
 
 namespace gr {
 
-ValBuilder::ValBuilder( )
+ValBuilder::ValBuilder( ) :
+	m_depth( 0 )
 {
 }
 
@@ -45,6 +46,11 @@ void ValBuilder::Visit( const std::string& t )
 	Build(Val(t)) ;
 }
 
+void ValBuilder::VisitChars( const char *str, std::size_t len )
+{
+	Build( Val( std::string( str, len ) ) ) ;
+}
+
 void ValBuilder::Visit( bool t )
 {
 	Build(Val(t)) ;
@@ -57,42 +63,63 @@ void ValBuilder::VisitNull()
 
 void ValBuilder::Build( const Val& t )
 {
-	if ( m_ctx.empty() )
+	Build( Val( t ) ) ;
+}
+
+void ValBuilder::Build( Val&& t )
+{
+	if ( m_depth == 0 )
 	{
-		Level l = { Val::Null(), t } ;
-		m_ctx.push( l ) ;
+		Push( std::move( t ) ) ;
+		return ;
 	}
+
+	Level& top = m_ctx[m_depth-1] ;
+	if ( top.val.Is<Val::Array>() )
+		top.val.AsArray().push_back( std::move( t ) ) ;
 	
-	else if ( m_ctx.top().val.Is<Val::Array>() )
+	else if ( top.val.Is<Val::Object>() )
 	{
-		Val::Array& ar = m_ctx.top().val.As<Val::Array>() ;
-		ar.push_back( t ) ;
-	}
-	else if ( m_ctx.top().val.Is<Val::Object>() )
-	{
-		if ( !m_ctx.top().key.Is<std::string>() )
+		if ( !top.has_key )
 			BOOST_THROW_EXCEPTION( Error() << NoKey_(t) ) ;
 	
-		else
-		{
-			Val::Object& obj = m_ctx.top().val.As<Val::Object>() ;
-			obj.insert( std::make_pair( m_ctx.top().key.Str(), t ) ) ;
-			m_ctx.top().key = Val::Null() ;
-		}
+		// the first of duplicated keys is kept
+		Val::Object& obj = top.val.AsObject() ;
+		std::size_t count = obj.size() ;
+		Val& member = obj[top.key] ;
+		if ( obj.size() > count )
+			member = std::move( t ) ;
+		top.has_key = false ;
 	}
 	else
-		BOOST_THROW_EXCEPTION( Error() << Unexpected_(m_ctx.top().val) ) ;
+		BOOST_THROW_EXCEPTION( Error() << Unexpected_(top.val) ) ;
+}
+
+void ValBuilder::Push( Val&& val )
+{
+	if ( m_ctx.size() == m_depth )
+		m_ctx.push_back( Level() ) ;
+
+	Level& l = m_ctx[m_depth++] ;
+	l.has_key	= false ;
+	l.val		= std::move( val ) ;
 }
 
 void ValBuilder::VisitKey( const std::string& t )
 {
-	m_ctx.top().key = t ;
+	m_ctx[m_depth-1].key		= t ;
+	m_ctx[m_depth-1].has_key	= true ;
+}
+
+void ValBuilder::VisitKeyChars( const char *str, std::size_t len )
+{
+	m_ctx[m_depth-1].key.assign( str, len ) ;
+	m_ctx[m_depth-1].has_key	= true ;
 }
 
 void ValBuilder::StartArray()
 {
-	Level l = { Val::Null(), Val(Val::Array()) } ;
-	m_ctx.push(l) ;
+	Push( Val( Val::array_type ) ) ;
 }
 
 void ValBuilder::EndArray()
@@ -102,24 +129,23 @@ void ValBuilder::EndArray()
 
 void ValBuilder::End( Val::TypeEnum type )
 {
-	if ( m_ctx.top().val.Type() == type )
+	Level& top = m_ctx[m_depth-1] ;
+	if ( top.val.Type() == type )
 	{
-		if( !m_ctx.top().key.Is<void>() )
-			BOOST_THROW_EXCEPTION( Error() << Unexpected_(m_ctx.top().key) ) ;
+		if( top.has_key )
+			BOOST_THROW_EXCEPTION( Error() << Unexpected_( Val( top.key ) ) ) ;
 	
-		// get top Val from stack
-		Val current ;
-		current.Swap( m_ctx.top().val ) ;
-		m_ctx.pop() ;
+		// move the completed Val into its parent
+		Val current( std::move( top.val ) ) ;
+		m_depth-- ;
 		
-		Build(current) ;
+		Build( std::move( current ) ) ;
 	}
 }
 
 void ValBuilder::StartObject()
 {
-	Level l = { Val::Null(), Val( Val::Object() ) } ;
-	m_ctx.push(l) ;
+	Push( Val( Val::object_type ) ) ;
 }
 
 void ValBuilder::EndObject()
@@ -127,14 +153,28 @@ void ValBuilder::EndObject()
 	End( Val::object_type ) ;
 }
 
-Val ValBuilder::Result() const
+const Val& ValBuilder::Top() const
 {
-	if ( !m_ctx.size() )
+	if ( m_depth == 0 )
 		BOOST_THROW_EXCEPTION( Error() << NoKey_( Val(std::string("")) ) ) ;
-	Val r = m_ctx.top().val;
-	if ( m_ctx.size() > 1 )
-		BOOST_THROW_EXCEPTION( Error() << Unexpected_(m_ctx.top().val) ) ;
-	return r;
+	if ( m_depth > 1 )
+		BOOST_THROW_EXCEPTION( Error() << Unexpected_(m_ctx[m_depth-1].val) ) ;
+	return m_ctx[0].val ;
+}
+
+Val ValBuilder::Result() const
+{
+	return Top() ;
+}
+
+/// Moves the result out, and leaves the builder ready for the next document.
+Val ValBuilder::TakeResult()
+{
+	Top() ;
+
+	Val r( std::move( m_ctx[0].val ) ) ;
+	m_depth = 0 ;
+	return r ;
 }
 
 } // end of namespace
@@ -25,11 +25,18 @@
 #include "Val.hh"
 #include "util/Exception.hh"
 
-#include <stack>
-#include <memory>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 namespace gr {
 
+/*!	\brief	builds a Val from the events of a JsonParser
+
+	Values are moved up into their parent as soon as they are complete, so
+	nothing is copied on the way. Keys are read into a buffer kept for each
+	level of nesting, so reading them doesn't allocate either.
+*/
 class ValBuilder : public ValVisitor
 {
 public :
@@ -45,29 +52,38 @@ public :
 	void Visit( long long t ) ;
 	void Visit( double t ) ;
 	void Visit( const std::string& t ) ;
+	void VisitChars( const char *str, std::size_t len ) ;
 	void Visit( bool t ) ;
 	void VisitNull() ;
 	void Build( const Val& t ) ;
+	void Build( Val&& t ) ;
 
 	void StartArray() ;
 	void EndArray() ;
 	void StartObject() ;
 	void VisitKey( const std::string& t ) ;
+	void VisitKeyChars( const char *str, std::size_t len ) ;
 	void EndObject() ;
 
 	Val Result() const ;
+	Val TakeResult() ;
 
 private :
+	void Push( Val&& val ) ;
 	void End( Val::TypeEnum type ) ;
+	const Val& Top() const ;
 
 private :
 	struct Level
 	{
-		Val	key ;
-		Val	val ;
+		std::string	key ;
+		bool		has_key ;
+		Val			val ;
 	} ;
 
-	std::stack<Level> 	m_ctx ;
+	// levels above m_depth are kept for their key buffers
+	std::vector<Level>	m_ctx ;
+	std::size_t			m_depth ;
 } ;
 
 } // end of namespace
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace gr {
@@ -40,6 +41,18 @@ public :
 	virtual void StartObject() = 0 ;
 	virtual void VisitKey( const std::string& t ) = 0 ;
 	virtual void EndObject() = 0 ;
+
+	// strings and keys as they are in the parser's buffer, only valid during
+	// the call. by default they are copied into a std::string
+	virtual void VisitChars( const char *str, std::size_t len )
+	{
+		Visit( std::string( str, len ) ) ;
+	}
+
+	virtual void VisitKeyChars( const char *str, std::size_t len )
+	{
+		VisitKey( std::string( str, len ) ) ;
+	}
 } ;
 
 } // end of namespace
@@ -25,6 +25,8 @@
 #include "util/OS.hh"
 #include "util/File.hh"
 
+#include <boost/bind.hpp>
+
 #include <cassert>
 
 namespace gr {
@@ -78,18 +80,129 @@ long AuthAgent::Request(
 	DataStream			*dest,
 	const http::Header&	hdr,
 	u64_t			downloadFileBytes )
+{
+	return Send( method, url, in, dest, hdr, downloadFileBytes, true ) ;
+}
+
+/// Only an expired token is refreshed and the request sent again: the other
+/// errors are thrown at the first failure.
+long AuthAgent::RequestOnce(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const http::Header&	hdr )
+{
+	return Send( method, url, in, dest, hdr, 0, false ) ;
+}
+
+long AuthAgent::Send(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const http::Header&	hdr,
+	u64_t				downloadFileBytes,
+	bool				retry )
 {
 	long response;
 	Header auth;
-	m_interval = 0;
-	do
+	int interval = 0;
+	unsigned delay = 0;
+	while ( true )
 	{
 		auth = AppendHeader( hdr );
 		if ( in )
 			in->Seek( 0, 0 );
 		response = m_agent->Request( method, url, in, dest, auth, downloadFileBytes );
-	} while ( CheckRetry( response ) );
-	return CheckHttpResponse( response, url, auth );
+		if ( ( !retry && response != 401 ) || !CheckRetry( response, m_agent->LastError(), interval, delay ) )
+			break;
+		os::Sleep( delay );
+	}
+	return CheckHttpResponse( response, url, auth, m_agent->LastErrorHeaders(), m_agent->LastError() );
+}
+
+/// parameters of an asynchronous request, kept for retrying it
+struct AuthAgent::AsyncRequest
+{
+	std::string		method ;
+	std::string		url ;
+	SeekStream		*in ;
+	DataStream		*dest ;
+	http::Header	hdr ;
+	http::Header	auth ;
+	Callback		done ;
+	int				interval ;
+
+	// the error of the response, as LastError() is the one of the agent
+	std::string		error ;
+	std::string		error_headers ;
+} ;
+
+void AuthAgent::RequestAsync(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const http::Header&	hdr,
+	const Callback&		done )
+{
+	std::shared_ptr<AsyncRequest> req( new AsyncRequest ) ;
+	req->method		= method ;
+	req->url		= url ;
+	req->in			= in ;
+	req->dest		= dest ;
+	req->hdr		= hdr ;
+	req->done		= done ;
+	req->interval	= 0 ;
+	Submit( req ) ;
+}
+
+void AuthAgent::Wait()
+{
+	m_agent->Wait() ;
+}
+
+void AuthAgent::Schedule( unsigned seconds, const Task& task )
+{
+	m_agent->Schedule( seconds, task ) ;
+}
+
+void AuthAgent::Submit( const std::shared_ptr<AsyncRequest>& req )
+{
+	req->auth = AppendHeader( req->hdr ) ;
+	if ( req->in )
+		req->in->Seek( 0, 0 ) ;
+	m_agent->RequestAsync( req->method, req->url, req->in, req->dest, req->auth,
+		boost::bind( &AuthAgent::OnResponse, this, req, _1, _2 ) ) ;
+}
+
+/// Retries are scheduled in the event loop of the agent, so the other requests
+/// in flight go on while waiting.
+void AuthAgent::OnResponse( const std::shared_ptr<AsyncRequest>& req, long response, std::exception_ptr error )
+{
+	if ( !error )
+	{
+		req->error			= m_agent->LastError() ;
+		req->error_headers	= m_agent->LastErrorHeaders() ;
+		try
+		{
+			unsigned delay = 0 ;
+			if ( CheckRetry( response, req->error, req->interval, delay ) )
+			{
+				m_agent->Schedule( delay, boost::bind( &AuthAgent::Submit, this, req ) ) ;
+				return ;
+			}
+			CheckHttpResponse( response, req->url, req->auth, req->error_headers, req->error ) ;
+		}
+		catch ( ... )
+		{
+			error = std::current_exception() ;
+		}
+	}
+
+	// the handler is called outside the try block so its own exceptions propagate
+	req->done( response, error ) ;
 }
 
 std::string AuthAgent::LastError() const
@@ -107,6 +220,11 @@ std::string AuthAgent::RedirLocation() const
 	return m_agent->RedirLocation() ;
 }
 
+std::string AuthAgent::ResponseHeader( const std::string& name ) const
+{
+	return m_agent->ResponseHeader( name ) ;
+}
+
 std::string AuthAgent::Escape( const std::string& str )
 {
 	return m_agent->Escape( str ) ;
@@ -117,36 +235,38 @@ std::string AuthAgent::Unescape( const std::string& str )
 	return m_agent->Unescape( str ) ;
 }
 
-bool AuthAgent::CheckRetry( long response )
+/// Tells if the request should be sent again after \a delay seconds. \a body
+/// is the error response, and \a interval the last delay of the backoff.
+bool AuthAgent::CheckRetry( long response, const std::string& body, int& interval, unsigned& delay )
 {
 	// HTTP 500 and 503 should be temporary. just wait a bit and retry
 	if ( response == 500 || response == 503 )
 	{
 		Log( "request failed due to temporary error: %1% (body: %2%). retrying in 5 seconds",
-			response, m_agent->LastError(), log::warning ) ;
-			
-		os::Sleep( 5 ) ;
+			response, body, log::warning ) ;
+		
+		delay = 5 ;
 		return true ;
 	}
 	// HTTP 403 is the result of API rate limiting. attempt exponential backoff and try again
 	else if ( response == 429 || ( response == 403 && (
-		m_agent->LastError().find("\"reason\": \"userRateLimitExceeded\",") != std::string::npos ||
-		m_agent->LastError().find("\"reason\": \"rateLimitExceeded\",") != std::string::npos ) ) )
+		body.find("\"reason\": \"userRateLimitExceeded\",") != std::string::npos ||
+		body.find("\"reason\": \"rateLimitExceeded\",") != std::string::npos ) ) )
 	{
-		m_interval = m_interval <= 0 ? 1 : ( m_interval < 64 ? m_interval*2 : 120 );
+		interval = interval <= 0 ? 1 : ( interval < 64 ? interval*2 : 120 );
 		Log( "request failed due to rate limiting: %1% (body: %2%). retrying in %3% seconds",
-			response, m_agent->LastError(), m_interval, log::warning ) ;
-		os::Sleep( m_interval ) ;
+			response, body, interval, log::warning ) ;
+		delay = interval ;
 		return true ;
 	}
 	// HTTP 401 Unauthorized. the auth token has been expired. refresh it
 	else if ( response == 401 )
 	{
 		Log( "request failed due to auth token expired: %1% (body: %2%). refreshing token",
-			response, m_agent->LastError(), log::warning ) ;
-			
-		os::Sleep( 5 ) ;
+			response, body, log::warning ) ;
+		
 		m_auth.Refresh() ;
+		delay = 5 ;
 		return true ;
 	}
 	else
@@ -156,7 +276,9 @@ bool AuthAgent::CheckRetry( long response )
 long AuthAgent::CheckHttpResponse(
 		long 				response,
 		const std::string&	url,
-		const http::Header&	hdr  )
+		const http::Header&	hdr,
+		const std::string&	error_headers,
+		const std::string&	body )
 {
 	// throw for other HTTP errors
 	if ( response >= 400 )
@@ -164,8 +286,8 @@ long AuthAgent::CheckHttpResponse(
 		BOOST_THROW_EXCEPTION(
 			Error()
 				<< HttpResponseCode( response )
-				<< HttpResponseHeaders( m_agent->LastErrorHeaders() )
-				<< HttpResponseText( m_agent->LastError() )
+				<< HttpResponseHeaders( error_headers )
+				<< HttpResponseText( body )
 				<< Url( url )
 				<< HttpRequestHeaders( hdr ) ) ;
 	}
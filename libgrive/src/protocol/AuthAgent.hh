@@ -46,11 +46,30 @@ public :
 		DataStream			*dest,
 		const http::Header&	hdr,
 		u64_t			downloadFileBytes = 0 ) ;
+
+	long RequestOnce(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const http::Header&	hdr ) ;
+
+	void RequestAsync(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const http::Header&	hdr,
+		const Callback&		done ) ;
+
+	void Wait() ;
+	void Schedule( unsigned seconds, const Task& task ) ;
 	
 	std::string LastError() const ;
 	std::string LastErrorHeaders() const ;
 	
 	std::string RedirLocation() const ;
+	std::string ResponseHeader( const std::string& name ) const ;
 	
 	std::string Escape( const std::string& str ) ;
 	std::string Unescape( const std::string& str ) ;
@@ -61,17 +80,30 @@ public :
 	void SetProgressReporter( Progress *progress ) ;
 
 private :
+	struct AsyncRequest ;
+
 	http::Header AppendHeader( const http::Header& hdr ) const ;
-	bool CheckRetry( long response ) ;
+	long Send(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const http::Header&	hdr,
+		u64_t				downloadFileBytes,
+		bool				retry ) ;
+	void Submit( const std::shared_ptr<AsyncRequest>& req ) ;
+	void OnResponse( const std::shared_ptr<AsyncRequest>& req, long response, std::exception_ptr error ) ;
+	bool CheckRetry( long response, const std::string& body, int& interval, unsigned& delay ) ;
 	long CheckHttpResponse(
 		long 				response,
 		const std::string&	url,
-		const http::Header&	hdr  ) ;
+		const http::Header&	hdr,
+		const std::string&	error_headers,
+		const std::string&	body ) ;
 	
 private :
 	OAuth2&		m_auth ;
 	http::Agent*	m_agent ;
-	int		m_interval ;
 } ;
 
 } // end of namespace
@@ -211,6 +211,9 @@ bool OAuth2::GetCode( )
 
 void OAuth2::Refresh( )
 {
+	// several transfer workers may find the token expired at the same time
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+
 	std::string post =
 		"refresh_token="	+ m_refresh +
 		"&client_id="		+ m_client_id +
@@ -238,12 +241,13 @@ std::string OAuth2::RefreshToken( ) const
 
 std::string OAuth2::AccessToken( ) const
 {
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
 	return m_access ;
 }
 
 std::string OAuth2::HttpHeader( ) const
 {
-	return "Authorization: Bearer " + m_access ;
+	return "Authorization: Bearer " + AccessToken() ;
 }
 
 } // end of namespace
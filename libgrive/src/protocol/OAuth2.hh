@@ -23,6 +23,7 @@
 #include "util/Exception.hh"
 #include <string>
 #include <memory>
+#include <mutex>
 
 namespace gr {
 
@@ -66,6 +67,9 @@ private :
 
 	const std::string	m_client_id ;
 	const std::string	m_client_secret ;
+
+	// guards m_access, which is shared by all HTTP agents of the transfer pool
+	mutable std::mutex	m_mutex ;
 } ;
 
 } // end of namespace
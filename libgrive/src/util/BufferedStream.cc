@@ -0,0 +1,97 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "BufferedStream.hh"
+
+#include <boost/throw_exception.hpp>
+#include <boost/exception/errinfo_api_function.hpp>
+
+#include <cassert>
+#include <cstring>
+
+namespace gr {
+
+BufferedStream::BufferedStream( DataStream *out, std::size_t size ) :
+	m_out	( out ),
+	m_buf	( size ),
+	m_used	( 0 )
+{
+	assert( m_out != 0 ) ;
+	assert( size > 0 ) ;
+}
+
+BufferedStream::~BufferedStream()
+{
+	try
+	{
+		Flush() ;
+	}
+	catch ( ... )
+	{
+	}
+}
+
+/// Reading gets what is written so far, so the buffer is flushed first.
+std::size_t BufferedStream::Read( char *data, std::size_t size )
+{
+	Flush() ;
+	return m_out->Read( data, size ) ;
+}
+
+std::size_t BufferedStream::Write( const char *data, std::size_t size )
+{
+	if ( m_used + size > m_buf.size() )
+	{
+		Flush() ;
+
+		// too big to be worth copying
+		if ( size >= m_buf.size() )
+		{
+			WriteAll( data, size ) ;
+			return size ;
+		}
+	}
+
+	std::memcpy( &m_buf[m_used], data, size ) ;
+	m_used += size ;
+	return size ;
+}
+
+void BufferedStream::Flush()
+{
+	// the buffer is emptied first, so a failed write is not repeated
+	std::size_t used = m_used ;
+	m_used = 0 ;
+	WriteAll( &m_buf[0], used ) ;
+}
+
+void BufferedStream::WriteAll( const char *data, std::size_t size )
+{
+	while ( size > 0 )
+	{
+		std::size_t count = m_out->Write( data, size ) ;
+		if ( count == 0 )
+			BOOST_THROW_EXCEPTION( Error() << boost::errinfo_api_function("write") ) ;
+		data += count ;
+		size -= count ;
+	}
+}
+
+} // end of namespace
@@ -0,0 +1,63 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "DataStream.hh"
+#include "Exception.hh"
+
+#include <cstddef>
+#include <vector>
+
+namespace gr {
+
+/**	\brief	Collects small writes into blocks.
+
+	Data written is kept in a buffer and passed on to the underlying stream
+	only when the buffer is full or when Flush() is called. Writers producing
+	many small pieces, like JsonWriter, then cost one system call per block
+	instead of one per piece when the stream is a File.
+
+	Flush() must be called to see write errors. The destructor flushes what
+	is left, but ignores errors.
+*/
+class BufferedStream : public DataStream
+{
+public :
+	struct Error : virtual Exception {} ;
+
+public :
+	explicit BufferedStream( DataStream *out, std::size_t size = 64 * 1024 ) ;
+	~BufferedStream() ;
+
+	std::size_t Read( char *data, std::size_t size ) ;
+	std::size_t Write( const char *data, std::size_t size ) ;
+	void Flush() ;
+
+private :
+	void WriteAll( const char *data, std::size_t size ) ;
+
+private :
+	DataStream			*m_out ;
+	std::vector<char>	m_buf ;
+	std::size_t			m_used ;
+} ;
+
+} // end of namespace
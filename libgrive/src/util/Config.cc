@@ -77,9 +77,9 @@ const fs::path Config::Filename() const
 
 void Config::Save( )
 {
+	// synced, as it holds the refresh token
 	gr::File file( m_path.string(), 0600 ) ;
-	JsonWriter wr( &file ) ;
-	m_file.Visit( &wr ) ;
+	WriteJson( m_file, file, true ) ;
 }
 
 void Config::Set( const std::string& key, const Val& value )
@@ -92,8 +92,13 @@ std::string MD5::Get( File& file )
 	MD5 crypt ;
 	
 	u64_t size = file.Size() ;
+	file.ReadAhead( 0, read_size ) ;
 	for ( u64_t i = 0 ; i < size ; i += read_size )
 	{
+		// keep the disk busy with the next window while this one is hashed
+		if ( i + read_size < size )
+			file.ReadAhead( i + read_size, read_size ) ;
+
 		MemMap map( file, i, static_cast<std::size_t>(std::min(read_size, size-i)) ) ;
 		crypt.Write( map.Addr(), map.Length() ) ;
 	}
@@ -0,0 +1,247 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "DirScanner.hh"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace gr {
+
+namespace
+{
+	bool NameLess( const DirScanner::Node& a, const DirScanner::Node& b )
+	{
+		return a.name < b.name ;
+	}
+
+	void ThrowListError( const std::string& path, int error )
+	{
+		// the same error fs::directory_iterator would have thrown
+		throw fs::filesystem_error( "directory_iterator::directory_iterator", fs::path( path ),
+			boost::system::error_code( error, boost::system::system_category() ) ) ;
+	}
+}
+
+/// an open directory, kept open while its subdirectories are opened relative to it
+struct DirScanner::Dir
+{
+	DIR	*dir ;
+
+	explicit Dir( DIR *d ) : dir( d ) {}
+	~Dir() { ::closedir( dir ) ; }
+} ;
+
+struct DirScanner::Job
+{
+	std::shared_ptr<Dir>	parent ;
+	std::string				path ;		// full path, for opening the root and for errors
+	std::string				rel ;		// path relative to the root, for the filter
+	Node					*node ;
+} ;
+
+struct DirScanner::Impl
+{
+	std::mutex				mutex ;
+	std::condition_variable	wake ;
+	
+	// last in, first out: the scan goes depth first and only keeps a few
+	// directories open at any time
+	std::vector<Job>		jobs ;
+	std::size_t				running ;
+	std::exception_ptr		error ;
+} ;
+
+DirScanner::DirScanner( unsigned threads, const Filter& ignore ) :
+	m_threads	( std::max( threads, 1u ) ),
+	m_ignore	( ignore )
+{
+}
+
+void DirScanner::Scan( const fs::path& root, Node& result )
+{
+	Scan( root, "", result ) ;
+}
+
+/// Scans the directory \a root, which is \a rel relative to the root of the
+/// tree the filter expects, e.g. to read part of a tree scanned before again.
+void DirScanner::Scan( const fs::path& root, const std::string& rel, Node& result )
+{
+	result.name		= root.string() ;
+	result.type		= FT_DIR ;
+	result.size		= 0 ;
+	result.dev		= 0 ;
+	result.ino		= 0 ;
+	result.error	= 0 ;
+	result.ignored	= false ;
+	result.children.clear() ;
+
+	Impl impl ;
+	impl.running = 0 ;
+	
+	Job job ;
+	job.path	= root.string() ;
+	job.rel		= rel ;
+	job.node	= &result ;
+	impl.jobs.push_back( job ) ;
+
+	std::vector<std::thread> threads ;
+	for ( unsigned i = 1 ; i < m_threads ; i++ )
+		threads.push_back( std::thread( &DirScanner::Run, this, &impl ) ) ;
+	Run( &impl ) ;
+	for ( std::vector<std::thread>::iterator i = threads.begin() ; i != threads.end() ; ++i )
+		i->join() ;
+
+	if ( impl.error )
+		std::rethrow_exception( impl.error ) ;
+}
+
+void DirScanner::Run( Impl *impl )
+{
+	std::unique_lock<std::mutex> lock( impl->mutex ) ;
+	while ( true )
+	{
+		while ( impl->jobs.empty() && impl->running > 0 )
+			impl->wake.wait( lock ) ;
+
+		// all directories read, or one of them failed
+		if ( impl->jobs.empty() || impl->error )
+			break ;
+
+		Job job = impl->jobs.back() ;
+		impl->jobs.pop_back() ;
+		impl->running++ ;
+		lock.unlock() ;
+
+		std::exception_ptr error ;
+		try
+		{
+			ReadDir( impl, job ) ;
+		}
+		catch ( ... )
+		{
+			error = std::current_exception() ;
+		}
+
+		lock.lock() ;
+		impl->running-- ;
+		if ( error && !impl->error )
+		{
+			impl->error = error ;
+			impl->jobs.clear() ;
+		}
+		impl->wake.notify_all() ;
+	}
+	impl->wake.notify_all() ;
+}
+
+/// Reads the entries of one directory and queues its subdirectories.
+void DirScanner::ReadDir( Impl *impl, const Job& job )
+{
+	int fd = job.parent ?
+		::openat( ::dirfd( job.parent->dir ), job.node->name.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC ) :
+		::open( job.path.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC ) ;
+	if ( fd == -1 )
+		ThrowListError( job.path, errno ) ;
+
+	DIR *d = ::fdopendir( fd ) ;
+	if ( d == 0 )
+	{
+		int error = errno ;
+		::close( fd ) ;
+		ThrowListError( job.path, error ) ;
+	}
+	std::shared_ptr<Dir> dir( new Dir( d ) ) ;
+
+	std::vector<Node>& children = job.node->children ;
+	while ( struct dirent *de = ::readdir( d ) )
+	{
+		std::string name = de->d_name ;
+		if ( name == "." || name == ".." )
+			continue ;
+
+		Node n ;
+		n.name		= name ;
+		n.type		= FT_UNKNOWN ;
+		n.size		= 0 ;
+		n.dev		= 0 ;
+		n.ino		= 0 ;
+		n.error		= 0 ;
+		n.ignored	= m_ignore && m_ignore( job.rel.empty() ? name : job.rel + "/" + name ) ;
+
+		struct stat s ;
+		if ( !n.ignored && ::fstatat( fd, name.c_str(), &s, 0 ) != 0 )
+			n.error = errno ;
+		else if ( !n.ignored )
+		{
+#if defined __NetBSD__ || ( defined __APPLE__ && defined __DARWIN_64_BIT_INO_T )
+			n.ctime = DateTime( s.st_ctimespec.tv_sec, s.st_ctimespec.tv_nsec ) ;
+			n.mtime = DateTime( s.st_mtimespec.tv_sec, s.st_mtimespec.tv_nsec ) ;
+#else
+			n.ctime = DateTime( s.st_ctim.tv_sec, s.st_ctim.tv_nsec ) ;
+			n.mtime = DateTime( s.st_mtim.tv_sec, s.st_mtim.tv_nsec ) ;
+#endif
+			n.size	= s.st_size ;
+			n.dev	= s.st_dev ;
+			n.ino	= s.st_ino ;
+			n.type	= S_ISDIR( s.st_mode ) ? FT_DIR : ( S_ISREG( s.st_mode ) ? FT_FILE : FT_UNKNOWN ) ;
+		}
+		children.push_back( n ) ;
+	}
+
+	// the children won't move any more, so the jobs can point to them
+	std::sort( children.begin(), children.end(), &NameLess ) ;
+
+	std::vector<Job> subdirs ;
+	for ( std::vector<Node>::iterator i = children.begin() ; i != children.end() ; ++i )
+	{
+		if ( i->type == FT_DIR )
+		{
+			Job sub ;
+			sub.parent	= dir ;
+			sub.path	= job.path + "/" + i->name ;
+			sub.rel		= job.rel.empty() ? i->name : job.rel + "/" + i->name ;
+			sub.node	= &*i ;
+			subdirs.push_back( sub ) ;
+		}
+	}
+
+	if ( !subdirs.empty() )
+	{
+		std::lock_guard<std::mutex> lock( impl->mutex ) ;
+		impl->jobs.insert( impl->jobs.end(), subdirs.rbegin(), subdirs.rend() ) ;
+		impl->wake.notify_all() ;
+	}
+}
+
+} // end of namespace
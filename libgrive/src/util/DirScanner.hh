@@ -0,0 +1,89 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "DateTime.hh"
+#include "FileSystem.hh"
+#include "OS.hh"
+#include "Types.hh"
+
+#include <boost/function.hpp>
+
+#include <string>
+#include <vector>
+
+namespace gr {
+
+/*!	\brief	Reads a directory tree with several threads
+
+	Each directory is a job which any free thread can pick up. Entries are read
+	with fstatat() relative to the descriptor of their directory, and
+	subdirectories are opened with openat(), so the kernel never resolves full
+	paths again. Entries that are ignored are neither stat'ed nor descended.
+
+	The result is a tree of Node, with the children of each directory sorted by
+	name, so that it doesn't depend on the order in which the threads ran.
+*/
+class DirScanner
+{
+public :
+	struct Node
+	{
+		std::string			name ;
+		FileType			type ;
+		DateTime			ctime ;
+		DateTime			mtime ;
+		u64_t				size ;
+		
+		/// identity of the file, see HashCache
+		u64_t				dev ;
+		u64_t				ino ;
+		
+		/// errno of a failed stat(), 0 on success
+		int					error ;
+		bool				ignored ;
+		
+		/// entries of a directory, sorted by name
+		std::vector<Node>	children ;
+	} ;
+	
+	/// returns true for paths (relative to the root of the scan) which must be skipped
+	typedef boost::function<bool ( const std::string& )> Filter ;
+
+public :
+	DirScanner( unsigned threads, const Filter& ignore ) ;
+	
+	void Scan( const fs::path& root, Node& result ) ;
+	void Scan( const fs::path& root, const std::string& rel, Node& result ) ;
+
+private :
+	struct Dir ;
+	struct Job ;
+	struct Impl ;
+
+	void Run( Impl *impl ) ;
+	void ReadDir( Impl *impl, const Job& job ) ;
+
+private :
+	unsigned	m_threads ;
+	Filter		m_ignore ;
+} ;
+
+} // end of namespace
@@ -151,6 +151,35 @@ void File::OpenForWrite( const fs::path& path, int mode )
 	Open( path, flags, mode ) ;
 }
 
+/**	Opens the file for writing at its end, creating it if it does not exist.
+	\param	path	Path to the file to be opened.
+	\param	mode	Mode of the file if it is created.
+	\throw	Error	When the file cannot be opened.
+*/
+void File::OpenForAppend( const fs::path& path, int mode )
+{
+	int flags = O_CREAT|O_WRONLY|O_APPEND ;
+#ifdef WIN32
+	flags |= O_BINARY ;
+#endif
+	Open( path, flags, mode ) ;
+}
+
+/**	Opens the file for reading and writing without truncating it, creating
+	it if it does not exist.
+	\param	path	Path to the file to be opened.
+	\param	mode	Mode of the file if it is created.
+	\throw	Error	When the file cannot be opened.
+*/
+void File::OpenForUpdate( const fs::path& path, int mode )
+{
+	int flags = O_CREAT|O_RDWR ;
+#ifdef WIN32
+	flags |= O_BINARY ;
+#endif
+	Open( path, flags, mode ) ;
+}
+
 void File::Close()
 {
 	if ( IsOpened() )
@@ -198,6 +227,32 @@ std::size_t File::Write( const char *ptr, std::size_t size )
 	return count ;
 }
 
+/**	Writes bytes at the specified offset without moving the file position,
+	so that several writers can fill different parts of the same file.
+	\throw	Error	In case of any error.
+*/
+std::size_t File::WriteAt( const char *ptr, std::size_t size, off_t offset )
+{
+	assert( IsOpened() ) ;
+	std::size_t total = 0 ;
+	while ( total < size )
+	{
+		ssize_t count = ::pwrite( m_fd, ptr + total, size - total, offset + total ) ;
+		if ( count == -1 )
+		{
+			if ( errno == EINTR )
+				continue ;
+			BOOST_THROW_EXCEPTION(
+				Error()
+					<< boost::errinfo_api_function("pwrite")
+					<< boost::errinfo_errno(errno)
+			) ;
+		}
+		total += count ;
+	}
+	return total ;
+}
+
 off_t File::Seek( off_t offset, int whence )
 {
 	assert( IsOpened() ) ;
@@ -220,6 +275,22 @@ u64_t File::Size() const
 	return static_cast<uint64_t>( s.st_size ) ;
 }
 
+/**	Truncates or extends the file to the specified size.
+	\throw	Error	In case of any error.
+*/
+void File::Truncate( u64_t size )
+{
+	assert( IsOpened() ) ;
+	if ( ::ftruncate( m_fd, size ) != 0 )
+	{
+		BOOST_THROW_EXCEPTION(
+			Error()
+				<< boost::errinfo_api_function("ftruncate")
+				<< boost::errinfo_errno(errno)
+		) ;
+	}
+}
+
 void File::Chmod( int mode )
 {
 	assert( IsOpened() ) ;
@@ -235,6 +306,35 @@ void File::Chmod( int mode )
 #endif
 }
 
+/**	Flushes the content of the file to the disk.
+	\throw	Error	In case of any error.
+*/
+void File::Sync()
+{
+	assert( IsOpened() ) ;
+#ifndef WIN32
+	if ( ::fsync( m_fd ) != 0 )
+	{
+		BOOST_THROW_EXCEPTION(
+			Error()
+				<< boost::errinfo_api_function("fsync")
+				<< boost::errinfo_errno(errno)
+		) ;
+	}
+#endif
+}
+
+/// Tells the kernel that this part of the file will be read soon, so that
+/// it's read from the disk in the background. It's only a hint: errors
+/// are ignored.
+void File::ReadAhead( off_t offset, off_t length )
+{
+	assert( IsOpened() ) ;
+#if defined POSIX_FADV_WILLNEED
+	::posix_fadvise( m_fd, offset, length, POSIX_FADV_WILLNEED ) ;
+#endif
+}
+
 /// This function is not implemented in win32 yet.
 void* File::Map( off_t offset, std::size_t length )
 {
@@ -55,17 +55,23 @@ public :
 
 	void OpenForRead( const fs::path& path ) ;
 	void OpenForWrite( const fs::path& path, int mode = 0600 ) ;
+	void OpenForAppend( const fs::path& path, int mode = 0600 ) ;
+	void OpenForUpdate( const fs::path& path, int mode = 0600 ) ;
 	void Close() ;
 	bool IsOpened() const ;
 	
 	std::size_t Read( char *ptr, std::size_t size ) ;
 	std::size_t Write( const char *ptr, std::size_t size ) ;
+	std::size_t WriteAt( const char *ptr, std::size_t size, off_t offset ) ;
 
 	off_t Seek( off_t offset, int whence ) ;
 	off_t Tell() const ;
 	u64_t Size() const ;
 	
+	void Truncate( u64_t size ) ;
 	void Chmod( int mode ) ;
+	void Sync() ;
+	void ReadAhead( off_t offset, off_t length ) ;
 
 	void* Map( off_t offset, std::size_t length ) ;
 	static void UnMap( void *addr, std::size_t length ) ;
@@ -0,0 +1,217 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "IgnoreMatcher.hh"
+
+#include <algorithm>
+
+namespace gr {
+
+namespace
+{
+	bool IsGlob( const std::string& comp )
+	{
+		for ( std::size_t i = 0 ; i < comp.size() ; i++ )
+		{
+			if ( comp[i] == '\\' )
+				i++ ;
+			else if ( comp[i] == '*' || comp[i] == '?' )
+				return true ;
+		}
+		return false ;
+	}
+
+	std::string Unescape( const std::string& comp )
+	{
+		std::string result ;
+		for ( std::size_t i = 0 ; i < comp.size() ; i++ )
+		{
+			if ( comp[i] == '\\' && i+1 < comp.size() )
+				i++ ;
+			result += comp[i] ;
+		}
+		return result ;
+	}
+
+	/// "*" matches any characters and "?" a single one. The last "*" seen is
+	/// retried on a mismatch, which is enough as "*" never matches a "/".
+	bool GlobMatch( const char *p, const char *s )
+	{
+		const char *star_p = 0, *star_s = 0 ;
+		while ( *s )
+		{
+			if ( *p == '*' )
+			{
+				star_p = ++p ;
+				star_s = s ;
+				continue ;
+			}
+
+			const char *lit = ( *p == '\\' && p[1] ) ? p+1 : p ;
+			if ( *p == '?' || ( *lit != '\0' && *lit == *s ) )
+			{
+				p = lit + 1 ;
+				s++ ;
+			}
+			else if ( star_p )
+			{
+				p = star_p ;
+				s = ++star_s ;
+			}
+			else
+				return false ;
+		}
+
+		while ( *p == '*' )
+			p++ ;
+		return *p == '\0' ;
+	}
+}
+
+IgnoreMatcher::IgnoreMatcher() :
+	m_empty( true )
+{
+	NewNode() ;
+}
+
+IgnoreMatcher::Node* IgnoreMatcher::NewNode()
+{
+	m_nodes.push_back( Node() ) ;
+	Node *n = &m_nodes.back() ;
+	n->any				= 0 ;
+	n->repeat			= false ;
+	n->exclude			= false ;
+	n->include			= false ;
+	n->include_parent	= false ;
+	return n ;
+}
+
+/// Adds a pattern, already split into path components. Include patterns are
+/// the ones starting with "!" in .griveignore.
+void IgnoreMatcher::Add( const std::vector<std::string>& pattern, bool include )
+{
+	Node *n = &m_nodes.front() ;
+	for ( std::size_t i = 0 ; i < pattern.size() ; i++ )
+	{
+		const std::string& comp = pattern[i] ;
+		if ( comp == "**" )
+		{
+			if ( !n->any )
+			{
+				n->any = NewNode() ;
+				n->any->repeat = true ;
+			}
+			n = n->any ;
+		}
+		else if ( IsGlob( comp ) )
+		{
+			std::vector<std::pair<std::string, Node*> >::iterator g = n->glob.begin() ;
+			while ( g != n->glob.end() && g->first != comp )
+				++g ;
+			if ( g == n->glob.end() )
+				g = n->glob.insert( g, std::make_pair( comp, NewNode() ) ) ;
+			n = g->second ;
+		}
+		else
+		{
+			Node *&child = n->literal[Unescape( comp )] ;
+			if ( !child )
+				child = NewNode() ;
+			n = child ;
+		}
+
+		if ( include && i+1 < pattern.size() )
+			n->include_parent = true ;
+	}
+
+	if ( include )
+		n->include = true ;
+	else
+	{
+		n->exclude = true ;
+		m_empty = false ;
+	}
+}
+
+/// Tells if there is no exclude pattern, i.e. nothing is ever ignored.
+bool IgnoreMatcher::Empty() const
+{
+	return m_empty ;
+}
+
+void IgnoreMatcher::Step( const Node *n, const std::string& comp, std::vector<const Node*>& next ) const
+{
+	if ( n->repeat )
+		next.push_back( n ) ;
+
+	std::map<std::string, Node*>::const_iterator l = n->literal.find( comp ) ;
+	if ( l != n->literal.end() )
+		next.push_back( l->second ) ;
+
+	for ( std::vector<std::pair<std::string, Node*> >::const_iterator g = n->glob.begin() ; g != n->glob.end() ; ++g )
+		if ( GlobMatch( g->first.c_str(), comp.c_str() ) )
+			next.push_back( g->second ) ;
+
+	if ( n->any )
+		next.push_back( n->any ) ;
+}
+
+bool IgnoreMatcher::IsIgnored( const std::string& path ) const
+{
+	std::vector<const Node*> active( 1, &m_nodes.front() ), next ;
+	std::size_t begin = 0 ;
+	while ( true )
+	{
+		std::size_t end = path.find( '/', begin ) ;
+		if ( end == std::string::npos )
+			end = path.size() ;
+
+		std::string comp = path.substr( begin, end - begin ) ;
+		next.clear() ;
+		for ( std::vector<const Node*>::const_iterator i = active.begin() ; i != active.end() ; ++i )
+			Step( *i, comp, next ) ;
+
+		// neither this path nor anything below it matches any pattern
+		if ( next.empty() )
+			return false ;
+
+		std::sort( next.begin(), next.end() ) ;
+		next.erase( std::unique( next.begin(), next.end() ), next.end() ) ;
+
+		bool exclude = false, include = false ;
+		for ( std::vector<const Node*>::const_iterator i = next.begin() ; i != next.end() ; ++i )
+		{
+			// everything below an included path is included too
+			if ( (*i)->include )
+				return false ;
+			exclude = exclude || (*i)->exclude ;
+			include = include || (*i)->include_parent ;
+		}
+		if ( exclude && !include )
+			return true ;
+
+		if ( end == path.size() )
+			return false ;
+
+		active.swap( next ) ;
+		begin = end + 1 ;
+	}
+}
+
+} // end of namespace
@@ -0,0 +1,77 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gr {
+
+/*!	\brief	Matches relative paths against the patterns of .griveignore
+
+	The patterns are split into path components and merged into a trie, with
+	literal components looked up by name and the ones containing "*" or "?"
+	matched as globs. A "**" component matches one or more components. A path
+	is matched one component at a time, following all the patterns at once,
+	so the time is linear in the length of the path.
+
+	A path is ignored as soon as one of its leading parts is excluded, i.e.
+	an excluded directory is excluded with its whole subtree. Patterns which
+	include something below a directory ("!dir/keep") include the directory
+	itself, so that it is still read.
+*/
+class IgnoreMatcher
+{
+public :
+	IgnoreMatcher() ;
+
+	void Add( const std::vector<std::string>& pattern, bool include ) ;
+	bool Empty() const ;
+
+	bool IsIgnored( const std::string& path ) const ;
+
+private :
+	struct Node
+	{
+		std::map<std::string, Node*>				literal ;
+		std::vector<std::pair<std::string, Node*> >	glob ;
+		Node	*any ;
+
+		/// the node of a "**", which may match more components
+		bool	repeat ;
+
+		bool	exclude ;
+		bool	include ;
+		bool	include_parent ;
+	} ;
+
+	Node* NewNode() ;
+	void Step( const Node *n, const std::string& comp, std::vector<const Node*>& next ) const ;
+
+private :
+	// a deque doesn't move its elements, so nodes can point to each other
+	std::deque<Node>	m_nodes ;
+	bool				m_empty ;
+} ;
+
+} // end of namespace
@@ -0,0 +1,74 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "RangeStream.hh"
+
+#include <cassert>
+
+namespace gr {
+
+RangeStream::RangeStream( SeekStream *stream, u64_t offset, u64_t size ) :
+	m_stream( stream ), m_offset( offset ), m_size( size ), m_pos( 0 )
+{
+	assert( m_stream != 0 ) ;
+	m_stream->Seek( m_offset, 0 ) ;
+}
+
+std::size_t RangeStream::Read( char *data, std::size_t size )
+{
+	if ( size > m_size - m_pos )
+		size = m_size - m_pos ;
+
+	std::size_t done = size > 0 ? m_stream->Read( data, size ) : 0 ;
+	m_pos += done ;
+	return done ;
+}
+
+std::size_t RangeStream::Write( const char *data, std::size_t size )
+{
+	return 0 ;
+}
+
+off_t RangeStream::Seek( off_t offset, int whence )
+{
+	if ( whence == 1 )
+		offset += m_pos ;
+	else if ( whence == 2 )
+		offset += m_size ;
+	if ( offset < 0 )
+		offset = 0 ;
+	if ( (u64_t)offset > m_size )
+		offset = m_size ;
+
+	m_pos = offset ;
+	m_stream->Seek( m_offset + m_pos, 0 ) ;
+	return m_pos ;
+}
+
+off_t RangeStream::Tell() const
+{
+	return m_pos ;
+}
+
+u64_t RangeStream::Size() const
+{
+	return m_size ;
+}
+
+} // end of namespace
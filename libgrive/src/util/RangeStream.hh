@@ -0,0 +1,48 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "DataStream.hh"
+
+namespace gr {
+
+/*!	\brief	A part of another stream, seen as a stream of its own
+
+	Offsets are relative to the start of the part, so a request which is retried
+	by seeking back to 0 resends only this part.
+*/
+class RangeStream : public SeekStream
+{
+public :
+	RangeStream( SeekStream *stream, u64_t offset, u64_t size ) ;
+
+	std::size_t Read( char *data, std::size_t size ) ;
+	std::size_t Write( const char *data, std::size_t size ) ;
+
+	off_t Seek( off_t offset, int whence ) ;
+	off_t Tell() const ;
+	u64_t Size() const ;
+
+private :
+	SeekStream	*m_stream ;
+	u64_t		m_offset, m_size, m_pos ;
+} ;
+
+} // end of namespace
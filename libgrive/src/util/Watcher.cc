@@ -0,0 +1,266 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Watcher.hh"
+
+#include <boost/throw_exception.hpp>
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <boost/exception/info.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+#include <errno.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace gr {
+
+namespace
+{
+#ifdef __linux__
+	// files are reported once they are closed, not at each write, so copying a
+	// big file doesn't flood the queue
+	const uint32_t watch_mask =
+		IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_ONLYDIR | IN_DONT_FOLLOW ;
+#endif
+
+	std::string Child( const std::string& dir, const std::string& name )
+	{
+		return dir.empty() ? name : dir + "/" + name ;
+	}
+}
+
+Watcher::Watcher( const fs::path& root, const Filter& ignore ) :
+	m_root		( root ),
+	m_ignore	( ignore ),
+	m_fd		( -1 )
+{
+#ifdef __linux__
+	m_fd = ::inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) ;
+	if ( m_fd == -1 )
+	{
+		BOOST_THROW_EXCEPTION(
+			Error()
+				<< boost::errinfo_api_function("inotify_init1")
+				<< boost::errinfo_errno(errno)
+		) ;
+	}
+
+	try
+	{
+		AddTree( "" ) ;
+	}
+	catch ( ... )
+	{
+		::close( m_fd ) ;
+		throw ;
+	}
+#else
+	BOOST_THROW_EXCEPTION(
+		Error()
+			<< boost::errinfo_api_function("inotify_init1")
+			<< boost::errinfo_errno(ENOSYS)
+	) ;
+#endif
+}
+
+Watcher::~Watcher()
+{
+#ifdef __linux__
+	if ( m_fd != -1 )
+		::close( m_fd ) ;
+#endif
+}
+
+/// Waits up to \a timeout_ms for a change, then until nothing changed for
+/// \a quiet_ms, as files are often written in several steps. The directories
+/// changed are added to \a dirty. Returns false if nothing changed.
+bool Watcher::Wait( std::set<std::string>& dirty, unsigned timeout_ms, unsigned quiet_ms )
+{
+	typedef std::chrono::steady_clock Clock ;
+	Clock::time_point end = Clock::now() + std::chrono::milliseconds( timeout_ms ) ;
+
+	// changes to ignored files wake us up too
+	int changes = 0 ;
+	while ( changes == 0 )
+	{
+		long left = std::chrono::duration_cast<std::chrono::milliseconds>( end - Clock::now() ).count() ;
+		if ( left <= 0 || ( changes = Read( dirty, left ) ) < 0 )
+			return false ;
+	}
+
+	// a file written all the time must not hold back the sync for ever
+	end = Clock::now() + std::chrono::milliseconds( timeout_ms ) ;
+	while ( Clock::now() < end && Read( dirty, quiet_ms ) >= 0 )
+		;
+	return true ;
+}
+
+/// Handles the events already queued, without waiting. The directories changed
+/// are added to \a dirty. Returns false if nothing changed.
+bool Watcher::Drain( std::set<std::string>& dirty )
+{
+	return Read( dirty, 0 ) > 0 ;
+}
+
+/// Waits up to \a timeout_ms for events and handles all of them. Returns the
+/// number of changes added to \a dirty, or -1 on timeout.
+int Watcher::Read( std::set<std::string>& dirty, int timeout_ms )
+{
+#ifdef __linux__
+	struct pollfd pfd = { m_fd, POLLIN, 0 } ;
+	int r = ::poll( &pfd, 1, timeout_ms ) ;
+	if ( r == 0 || ( r == -1 && errno == EINTR ) )
+		return -1 ;
+	if ( r == -1 )
+	{
+		BOOST_THROW_EXCEPTION(
+			Error()
+				<< boost::errinfo_api_function("poll")
+				<< boost::errinfo_errno(errno)
+		) ;
+	}
+
+	int changes = 0 ;
+	std::vector<char> buf( 64 * 1024 ) ;
+	ssize_t size ;
+	while ( ( size = ::read( m_fd, &buf[0], buf.size() ) ) > 0 )
+	{
+		for ( ssize_t pos = 0 ; pos < size ; )
+		{
+			const struct inotify_event *ev = reinterpret_cast<const struct inotify_event*>( &buf[pos] ) ;
+			pos += sizeof(struct inotify_event) + ev->len ;
+
+			// events were lost, everything must be checked
+			if ( ev->mask & IN_Q_OVERFLOW )
+			{
+				dirty.insert( "" ) ;
+				changes++ ;
+				continue ;
+			}
+
+			std::map<int, std::string>::iterator d = m_paths.find( ev->wd ) ;
+			if ( d == m_paths.end() )
+				continue ;
+			std::string dir = d->second ;
+
+			// the directory was removed, or moved away and unwatched
+			if ( ev->mask & IN_IGNORED )
+			{
+				std::map<std::string, int>::iterator w = m_watches.find( dir ) ;
+				if ( w != m_watches.end() && w->second == ev->wd )
+					m_watches.erase( w ) ;
+				m_paths.erase( d ) ;
+				continue ;
+			}
+			if ( ev->len == 0 )
+				continue ;
+
+			std::string rel = Child( dir, ev->name ) ;
+			if ( m_ignore && m_ignore( rel ) )
+				continue ;
+
+			if ( ev->mask & IN_ISDIR )
+			{
+				if ( ev->mask & ( IN_DELETE | IN_MOVED_FROM ) )
+					RemoveTree( rel ) ;
+				else if ( ev->mask & ( IN_CREATE | IN_MOVED_TO ) )
+					AddTree( rel ) ;
+			}
+			dirty.insert( dir ) ;
+			changes++ ;
+		}
+	}
+	return changes ;
+#else
+	return -1 ;
+#endif
+}
+
+/// Watches the directory \a rel and all directories below it.
+void Watcher::AddTree( const std::string& rel )
+{
+#ifdef __linux__
+	fs::path path = m_root / rel ;
+	int wd = ::inotify_add_watch( m_fd, path.string().c_str(), watch_mask ) ;
+	if ( wd == -1 )
+	{
+		// gone already, its parent is reported anyway
+		if ( errno == ENOENT || errno == ENOTDIR )
+			return ;
+
+		// ENOSPC means that fs.inotify.max_user_watches is too low for the tree
+		BOOST_THROW_EXCEPTION(
+			Error()
+				<< boost::errinfo_api_function("inotify_add_watch")
+				<< boost::errinfo_errno(errno)
+				<< boost::errinfo_file_name(path.string())
+		) ;
+	}
+	m_paths[wd] = rel ;
+	m_watches[rel] = wd ;
+
+	// directories created from now on are reported, the ones already there
+	// must be looked for
+	boost::system::error_code ec ;
+	for ( fs::directory_iterator i( path, ec ), end ; !ec && i != end ; i.increment( ec ) )
+	{
+		std::string sub = Child( rel, i->path().filename().string() ) ;
+		if ( fs::is_directory( i->symlink_status() ) && !( m_ignore && m_ignore( sub ) ) )
+			AddTree( sub ) ;
+	}
+#endif
+}
+
+/// Stops watching the directory \a rel and all directories below it.
+void Watcher::RemoveTree( const std::string& rel )
+{
+#ifdef __linux__
+	std::map<std::string, int>::iterator i = m_watches.find( rel ) ;
+	if ( i != m_watches.end() )
+	{
+		::inotify_rm_watch( m_fd, i->second ) ;
+		m_paths.erase( i->second ) ;
+		m_watches.erase( i ) ;
+	}
+
+	// the directories below it sort right after rel + "/"
+	std::string prefix = rel + "/" ;
+	for ( i = m_watches.lower_bound( prefix ) ;
+		i != m_watches.end() && i->first.compare( 0, prefix.size(), prefix ) == 0 ; )
+	{
+		::inotify_rm_watch( m_fd, i->second ) ;
+		m_paths.erase( i->second ) ;
+		m_watches.erase( i++ ) ;
+	}
+#endif
+}
+
+} // end of namespace
@@ -0,0 +1,80 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#pragma once
+
+#include "Exception.hh"
+#include "FileSystem.hh"
+
+#include <boost/function.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace gr {
+
+/*!	\brief	Reports the directories changed under a tree
+
+	Every directory of the tree is watched with inotify. Watches are added for
+	the directories created or moved into the tree, and dropped for the ones
+	removed from it. Entries which are ignored are not reported, and ignored
+	directories are not watched.
+
+	Changes are reported as the paths, relative to the root, of the directories
+	whose entries changed. The root itself is "". When the kernel drops events,
+	the root is reported, so everything is checked again.
+
+	Only available on Linux. Elsewhere the constructor throws Error.
+*/
+class Watcher
+{
+public :
+	struct Error : virtual Exception {} ;
+
+	/// returns true for paths (relative to the root) which must not be reported
+	typedef boost::function<bool ( const std::string& )> Filter ;
+
+public :
+	Watcher( const fs::path& root, const Filter& ignore ) ;
+	~Watcher() ;
+
+	bool Wait( std::set<std::string>& dirty, unsigned timeout_ms, unsigned quiet_ms ) ;
+	bool Drain( std::set<std::string>& dirty ) ;
+
+private :
+	Watcher( const Watcher& ) ;
+	Watcher& operator=( const Watcher& ) ;
+
+	void AddTree( const std::string& rel ) ;
+	void RemoveTree( const std::string& rel ) ;
+	int Read( std::set<std::string>& dirty, int timeout_ms ) ;
+
+private :
+	fs::path						m_root ;
+	Filter							m_ignore ;
+	int								m_fd ;
+
+	/// watched directories by watch descriptor, and the other way round
+	std::map<int, std::string>		m_paths ;
+	std::map<std::string, int>		m_watches ;
+} ;
+
+} // end of namespace
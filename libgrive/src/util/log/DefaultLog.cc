@@ -41,6 +41,7 @@ void DefaultLog::Log( const log::Fmt& msg, log::Serverity s )
 {
 	if ( IsEnabled(s) )
 	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
 		switch ( s )
 		{
 			case log::debug:
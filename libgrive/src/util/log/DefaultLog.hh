@@ -22,6 +22,7 @@
 #include "CommonLog.hh"
 
 #include <fstream>
+#include <mutex>
 #include <string>
 
 namespace gr { namespace log {
@@ -37,6 +38,9 @@ public :
 private :
 	std::ofstream	m_file ;
 	std::ostream&	m_log ;
+	
+	// messages may come from the transfer threads
+	std::mutex		m_mutex ;
 } ;
 
 } } // end of namespace
@@ -45,14 +45,33 @@ void ResourceTest::TestRootPath()
 	GRUT_ASSERT_EQUAL( root.Path(), fs::path( rootFolder ) ) ;
 }
 
+void ResourceTest::TestFindChild()
+{
+	// enough children for the folder to index them
+	Resource root( "/home/usr/grive/grive" ) ;
+	std::vector<Resource*> children ;
+	for ( int i = 0 ; i < 100 ; i++ )
+	{
+		children.push_back( new Resource( "file" + std::to_string( i ), Resource::file_kind ) ) ;
+		root.AddChild( children.back() ) ;
+		CPPUNIT_ASSERT( root.FindChild( "file0" ) == children.front() ) ;
+	}
+	CPPUNIT_ASSERT( root.FindChild( "file42" ) == children[42] ) ;
+	CPPUNIT_ASSERT( root.FindChild( "file100" ) == 0 ) ;
+
+	for ( std::size_t i = 0 ; i < children.size() ; i++ )
+		delete children[i] ;
+}
+
 void ResourceTest::TestNormal( )
 {
-	Resource root( TEST_DATA, "folder" ) ;
-	Resource subject( "entry.xml", "file" ) ;
+	Resource root( TEST_DATA, Resource::folder_kind ) ;
+	Resource subject( "entry.xml", Resource::file_kind ) ;
 	root.AddChild( &subject ) ;
 	
 	GRUT_ASSERT_EQUAL( subject.IsRoot(), false ) ;
 	GRUT_ASSERT_EQUAL( subject.Path(), fs::path( TEST_DATA ) / "entry.xml" ) ;
+	GRUT_ASSERT_EQUAL( subject.RelPath(), fs::path( "entry.xml" ) ) ;
 	
 	Val st;
 	st.Add( "srv_time", Val( DateTime( "2012-05-09T16:13:22.401Z" ).Sec() ) );
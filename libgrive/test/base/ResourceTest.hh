@@ -33,11 +33,13 @@ public :
 	CPPUNIT_TEST_SUITE( ResourceTest ) ;
 		CPPUNIT_TEST( TestNormal ) ;
 		CPPUNIT_TEST( TestRootPath ) ;
+		CPPUNIT_TEST( TestFindChild ) ;
 	CPPUNIT_TEST_SUITE_END();
 
 private :
 	void TestNormal( ) ;
 	void TestRootPath() ;
+	void TestFindChild() ;
 } ;
 
 } // end of namespace
@@ -0,0 +1,54 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+
+namespace gr { namespace bench {
+
+/// the number of calls to operator new so far
+extern std::atomic<unsigned long long> allocations ;
+
+/// Runs \a f once and prints one line of tab-separated key=value pairs.
+/// \a f returns the number of \a what it handled, and \a bytes is the size of
+/// its input, if it has one.
+template <typename F>
+void Run( const char *name, const char *what, std::size_t bytes, F f )
+{
+	unsigned long long before = allocations ;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+	std::size_t items = f() ;
+	double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() ;
+
+	std::cout << name
+		<< "\t" << what << "=" << items
+		<< "\tallocations=" << allocations - before
+		<< "\tseconds=" << secs ;
+	if ( bytes > 0 )
+		std::cout << "\tMB/s=" << bytes / secs / 1e6 ;
+	std::cout << std::endl ;
+}
+
+void StateBench( std::size_t entries ) ;
+
+} } // end of namespace gr::bench
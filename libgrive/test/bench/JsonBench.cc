@@ -0,0 +1,220 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+// measures parsing a big file listing, as Feed2 reads it page by page and as
+// ParseJson() reads it into one document, and writing a big index as JSON.
+// StateBench.cc has the rest:
+//
+//	grive-bench [listing MB] [index entries]
+//
+// Each line is a benchmark, with its results as tab-separated key=value pairs.
+
+#include "Bench.hh"
+
+#include "json/BinaryVal.hh"
+#include "json/ItemBuilder.hh"
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "json/Val.hh"
+#include "json/ValBuilder.hh"
+#include "util/BufferedStream.hh"
+#include "util/File.hh"
+
+#include <boost/bind.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+std::atomic<unsigned long long> gr::bench::allocations( 0 ) ;
+
+void* operator new( std::size_t size )
+{
+	gr::bench::allocations++ ;
+	void *p = std::malloc( size ? size : 1 ) ;
+	if ( !p )
+		throw std::bad_alloc() ;
+	return p ;
+}
+
+void operator delete( void *p ) noexcept
+{
+	std::free( p ) ;
+}
+
+using namespace gr ;
+using namespace gr::bench ;
+
+namespace
+{
+	std::string Listing( std::size_t size )
+	{
+		std::string json = "{\"kind\":\"drive#fileList\",\"nextLink\":\"https://www.googleapis.com/drive/v2/files?pageToken=x\",\"items\":[" ;
+		char item[1024] ;
+		for ( unsigned long i = 0 ; json.size() < size ; i++ )
+		{
+			std::snprintf( item, sizeof(item),
+				"%s{\"kind\":\"drive#file\",\"id\":\"0B%030lu\",\"etag\":\"\\\"etag%lu\\\"\","
+				"\"selfLink\":\"https://www.googleapis.com/drive/v2/files/0B%030lu\","
+				"\"title\":\"file number %lu.txt\",\"mimeType\":\"text/plain\",\"editable\":true,"
+				"\"labels\":{\"trashed\":false},\"modifiedDate\":\"2015-05-01T10:20:30.123Z\","
+				"\"md5Checksum\":\"0123456789abcdef0123456789abcdef\",\"fileSize\":\"%lu\","
+				"\"downloadUrl\":\"https://doc-0s-docs.googleusercontent.com/docs/securesc/0B%030lu?e=download\","
+				"\"parents\":[{\"isRoot\":false,\"parentLink\":\"https://www.googleapis.com/drive/v2/files/0B%030lu\"}]}",
+				i ? "," : "", i, i, i, i, i * 37, i, i / 100 ) ;
+			json += item ;
+		}
+		return json + "]}" ;
+	}
+
+	void Count( const Val& item, std::size_t *count )
+	{
+		++*count ;
+	}
+
+	std::size_t ParseItems( const std::string& json )
+	{
+		std::size_t count = 0 ;
+		ItemBuilder b( "items", boost::bind( &Count, _1, &count ) ) ;
+		JsonParser parser( &b ) ;
+
+		// the size of the pieces curl gives us
+		for ( std::size_t i = 0 ; i < json.size() ; i += 16384 )
+			parser.Parse( json.data() + i, std::min<std::size_t>( 16384, json.size() - i ) ) ;
+		parser.Finish() ;
+		return count ;
+	}
+
+	std::size_t ParseDocument( const std::string& json )
+	{
+		return ParseJson( json )["items"].AsArray().size() ;
+	}
+
+	// counts the writes reaching the file, i.e. the system calls
+	class CountWrites : public DataStream
+	{
+	public :
+		explicit CountWrites( DataStream *out ) : m_out( out ), m_count( 0 )
+		{
+		}
+
+		std::size_t Read( char *data, std::size_t size )
+		{
+			return m_out->Read( data, size ) ;
+		}
+
+		std::size_t Write( const char *data, std::size_t size )
+		{
+			m_count++ ;
+			return m_out->Write( data, size ) ;
+		}
+
+		std::size_t Count() const
+		{
+			return m_count ;
+		}
+
+	private :
+		DataStream	*m_out ;
+		std::size_t	m_count ;
+	} ;
+
+	// an index like the remote file list in the state
+	Val Index( std::size_t count )
+	{
+		Val remote ;
+		char id[64] ;
+		for ( std::size_t i = 0 ; i < count ; i++ )
+		{
+			std::snprintf( id, sizeof(id), "0B%030lu", static_cast<unsigned long>( i ) ) ;
+			Val entry ;
+			entry.Add( "title",		Val( "file number " + std::to_string( i ) + ".txt" ) ) ;
+			entry.Add( "filename",	Val( "file number " + std::to_string( i ) + ".txt" ) ) ;
+			entry.Add( "dir",		Val( false ) ) ;
+			entry.Add( "id",		Val( std::string( id ) ) ) ;
+			entry.Add( "href",		Val( "https://www.googleapis.com/drive/v2/files/" + std::string( id ) ) ) ;
+			entry.Add( "editable",	Val( true ) ) ;
+			entry.Add( "mtime",		Val( 1430475630 + i ) ) ;
+			entry.Add( "mtime_ns",	Val( 123000000 ) ) ;
+			entry.Add( "md5",		Val( std::string( "0123456789abcdef0123456789abcdef" ) ) ) ;
+			entry.Add( "size",		Val( i * 37 ) ) ;
+			remote.Add( id, std::move( entry ) ) ;
+		}
+		Val st ;
+		st.Add( "remote", std::move( remote ) ) ;
+		return st ;
+	}
+
+	std::size_t WriteDirect( const Val& st, const fs::path& path )
+	{
+		File file ;
+		file.OpenForWrite( path, 0600 ) ;
+		CountWrites out( &file ) ;
+		JsonWriter wr( &out ) ;
+		st.Visit( &wr ) ;
+		return out.Count() ;
+	}
+
+	std::size_t WriteBuffered( const Val& st, const fs::path& path )
+	{
+		File file ;
+		file.OpenForWrite( path, 0600 ) ;
+		CountWrites out( &file ) ;
+		BufferedStream buf( &out ) ;
+		{
+			JsonWriter wr( &buf ) ;
+			st.Visit( &wr ) ;
+		}
+		buf.Flush() ;
+		return out.Count() ;
+	}
+
+	std::size_t WriteBinary( const Val& st, const fs::path& path )
+	{
+		File file ;
+		file.OpenForWrite( path, 0600 ) ;
+		CountWrites out( &file ) ;
+		binary::Write( st, &out ) ;
+		return out.Count() ;
+	}
+}
+
+int main( int argc, char **argv )
+{
+	std::size_t mb = argc > 1 ? std::atoi( argv[1] ) : 100 ;
+	std::string json = Listing( mb * 1000 * 1000 ) ;
+
+	Run( "items", "items", json.size(), boost::bind( &ParseItems, boost::cref( json ) ) ) ;
+	Run( "document", "items", json.size(), boost::bind( &ParseDocument, boost::cref( json ) ) ) ;
+	json.clear() ;
+
+	std::size_t entries = argc > 2 ? std::atoi( argv[2] ) : 1000000 ;
+	Val st = Index( entries ) ;
+	fs::path path = fs::temp_directory_path() / fs::unique_path() ;
+	Run( "write-direct", "writes", 0, boost::bind( &WriteDirect, boost::cref( st ), boost::cref( path ) ) ) ;
+	Run( "write-buffered", "writes", 0, boost::bind( &WriteBuffered, boost::cref( st ), boost::cref( path ) ) ) ;
+	Run( "write-binary", "writes", 0, boost::bind( &WriteBinary, boost::cref( st ), boost::cref( path ) ) ) ;
+	fs::remove( path ) ;
+	st = Val() ;
+
+	StateBench( entries ) ;
+	return 0 ;
+}
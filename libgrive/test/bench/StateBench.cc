@@ -0,0 +1,304 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+// measures the state of a big drive: reading and writing the index, building
+// the resource tree from it and looking up its resources, matching paths with
+// a .griveignore, and the MD5 of files
+
+#include "Bench.hh"
+
+#include "base/State.hh"
+#include "json/BinaryVal.hh"
+#include "json/Val.hh"
+#include "util/Crypt.hh"
+#include "util/File.hh"
+
+#include <boost/bind.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gr { namespace bench {
+
+namespace
+{
+	const std::size_t files_per_folder	= 1000 ;
+	const std::size_t md5_size			= 256 * 1024 * 1024 ;
+
+	std::string ID( char kind, std::size_t i )
+	{
+		char id[64] ;
+		std::snprintf( id, sizeof(id), "0B%c%029lu", kind, static_cast<unsigned long>( i ) ) ;
+		return id ;
+	}
+
+	std::string Href( const std::string& id )
+	{
+		return "https://www.googleapis.com/drive/v2/files/" + id ;
+	}
+
+	std::string Name( std::size_t i )
+	{
+		return "file number " + std::to_string( i ) + ".txt" ;
+	}
+
+	// as Entry::Index() writes it
+	Val Remote( const std::string& id, const std::string& title, const std::string& parent, bool dir, std::size_t i )
+	{
+		Val parents( Val::array_type ) ;
+		parents.Add( Val( parent ) ) ;
+
+		Val entry ;
+		entry.Add( "title",		Val( title ) ) ;
+		entry.Add( "filename",	Val( title ) ) ;
+		entry.Add( "dir",		Val( dir ) ) ;
+		entry.Add( "id",		Val( id ) ) ;
+		entry.Add( "href",		Val( Href( id ) ) ) ;
+		entry.Add( "editable",	Val( true ) ) ;
+		entry.Add( "mtime",		Val( 1430475630 + i ) ) ;
+		entry.Add( "mtime_ns",	Val( 123000000 ) ) ;
+		entry.Add( "parents",	parents ) ;
+		entry.Add( "etag",		Val( "\"etag" + std::to_string( i ) + "\"" ) ) ;
+		if ( !dir )
+		{
+			entry.Add( "md5",		Val( std::string( "0123456789abcdef0123456789abcdef" ) ) ) ;
+			entry.Add( "content",	Val( "https://doc-0s-docs.googleusercontent.com/docs/securesc/" + id + "?e=download" ) ) ;
+			entry.Add( "size",		Val( i * 37 ) ) ;
+		}
+		return entry ;
+	}
+
+	// as Resource::SetIndex() writes it
+	Val Local( bool dir, std::size_t i )
+	{
+		Val entry ;
+		entry.Add( "ctime",		Val( 1430475630 + i ) ) ;
+		entry.Add( "srv_time",	Val( 1430475630 + i ) ) ;
+		if ( dir )
+			entry.Add( "tree", Val( Val::object_type ) ) ;
+		else
+		{
+			entry.Add( "md5",		Val( std::string( "0123456789abcdef0123456789abcdef" ) ) ) ;
+			entry.Add( "size",		Val( i * 37 ) ) ;
+		}
+		return entry ;
+	}
+
+	/// A state file of \a count files, in folders of files_per_folder files
+	/// below the root.
+	Val Index( std::size_t count )
+	{
+		Val tree( Val::object_type ), remote( Val::object_type ) ;
+		for ( std::size_t f = 0 ; f * files_per_folder < count ; f++ )
+		{
+			std::string dir = "folder " + std::to_string( f ) ;
+			std::string dir_id = ID( 'd', f ) ;
+			remote.Add( dir_id, Remote( dir_id, dir, "root", true, f ) ) ;
+
+			Val local = Local( true, f ) ;
+			Val& files = local.Item( "tree" ) ;
+			for ( std::size_t i = f * files_per_folder ; i < count && i < ( f + 1 ) * files_per_folder ; i++ )
+			{
+				std::string id = ID( 'f', i ) ;
+				remote.Add( id, Remote( id, Name( i ), Href( dir_id ), false, i ) ) ;
+				files.Add( Name( i ), Local( false, i ) ) ;
+			}
+			tree.Add( dir, std::move( local ) ) ;
+		}
+
+		Val st ;
+		st.Add( "tree",			std::move( tree ) ) ;
+		st.Add( "remote",		std::move( remote ) ) ;
+		st.Add( "change_stamp",	Val( 12345 ) ) ;
+		return st ;
+	}
+
+	std::size_t Read( std::unique_ptr<State>& state, const fs::path& root, std::size_t entries )
+	{
+		Val options ;
+		options.Add( "path", Val( root.string() ) ) ;
+		state.reset( new State( root, options ) ) ;
+		return entries ;
+	}
+
+	std::size_t Write( State *state, std::size_t entries )
+	{
+		state->Write() ;
+		return entries ;
+	}
+
+	std::size_t Build( State *state )
+	{
+		state->FromRemoteIndex() ;
+		return std::distance( state->begin(), state->end() ) ;
+	}
+
+	std::size_t FindByHref( State *state, const std::vector<std::string>& hrefs )
+	{
+		std::size_t found = 0 ;
+		for ( std::vector<std::string>::const_iterator i = hrefs.begin() ; i != hrefs.end() ; ++i )
+			found += state->FindByHref( *i ) != 0 ;
+		return found ;
+	}
+
+	// the kind of patterns people put in .griveignore
+	const char ignore[] =
+		"# editors and OS files\n"
+		"*~\n"
+		"*.swp\n"
+		".~lock.*#\n"
+		".DS_Store\n"
+		"Thumbs.db\n"
+		"\n"
+		"# build output\n"
+		"*.o\n"
+		"*.pyc\n"
+		"**/node_modules\n"
+		"**/__pycache__\n"
+		"**/.git\n"
+		"projects/*/build\n"
+		"projects/*/dist\n"
+		".cache/**\n"
+		"tmp\n"
+		"\n"
+		"# but keep these\n"
+		"!projects/*/build/README.md\n"
+		"photos/**/*.raw\n"
+		"!photos/best/*.raw\n" ;
+
+	/// Relative paths of projects, photos and documents, about a quarter of
+	/// them ignored.
+	std::vector<std::string> Paths( std::size_t count )
+	{
+		// each one with a number in the middle
+		const char *names[][2] = {
+			{ "projects/project ", "/src/main.c" },
+			{ "projects/project ", "/src/main.o" },
+			{ "projects/project ", "/src/util/list.py" },
+			{ "projects/project ", "/src/util/__pycache__/list.pyc" },
+			{ "projects/project ", "/build/out.bin" },
+			{ "projects/project ", "/build/README.md" },
+			{ "projects/project ", "/node_modules/left-pad/index.js" },
+			{ "projects/project ", "/.git/objects/ab/cdef" },
+			{ "projects/project ", "/README.md" },
+			{ "photos/best/IMG_", ".raw" },
+			{ "photos/", "/summer/IMG_1234.raw" },
+			{ "photos/", "/summer/IMG_1234.jpg" },
+			{ "docs/", "/taxes.pdf" },
+			{ "docs/letters/letter ", ".odt" },
+			{ "docs/letters/letter ", ".odt~" },
+			{ "music/album ", "/01 - intro.flac" },
+			{ "music/album ", "/cover.jpg" },
+			{ "Thumbs", ".db" },
+			{ "tmp/", ".txt" },
+			{ "notes ", ".txt" },
+		} ;
+		const std::size_t n = sizeof(names) / sizeof(names[0]) ;
+
+		std::vector<std::string> paths ;
+		paths.reserve( count ) ;
+		for ( std::size_t i = 0 ; i < count ; i++ )
+			paths.push_back( names[i % n][0] + std::to_string( i / n % 1000 ) + names[i % n][1] ) ;
+		return paths ;
+	}
+
+	std::size_t Ignored( State *state, const std::vector<std::string>& paths )
+	{
+		std::size_t ignored = 0 ;
+		for ( std::vector<std::string>::const_iterator i = paths.begin() ; i != paths.end() ; ++i )
+			ignored += state->IsIgnore( *i ) ;
+		return ignored ;
+	}
+
+	std::size_t MD5Memory( const std::string& data )
+	{
+		// the size of the pieces curl gives us
+		crypt::MD5 md5 ;
+		for ( std::size_t i = 0 ; i < data.size() ; i += 16384 )
+			md5.Write( data.data() + i, std::min<std::size_t>( 16384, data.size() - i ) ) ;
+		return md5.Get().size() ;
+	}
+
+	std::size_t MD5File( const fs::path& path )
+	{
+		return crypt::MD5::Get( path ).size() ;
+	}
+}
+
+void StateBench( std::size_t entries )
+{
+	fs::path root = fs::temp_directory_path() / fs::unique_path( "grive-bench-%%%%%%%%" ) ;
+	fs::create_directories( root ) ;
+
+	std::size_t bytes ;
+	{
+		Val st = Index( entries ) ;
+		File file ;
+		file.OpenForWrite( root / ".grive_state", 0600 ) ;
+		binary::Write( st, &file ) ;
+		bytes = file.Size() ;
+	}
+
+	// the index is read when the state is made
+	std::unique_ptr<State> state ;
+	Run( "state-read", "entries", bytes, boost::bind( &Read, boost::ref( state ), boost::cref( root ), entries ) ) ;
+	Run( "state-write", "entries", 0, boost::bind( &Write, state.get(), entries ) ) ;
+	Run( "tree-build", "resources", 0, boost::bind( &Build, state.get() ) ) ;
+
+	std::vector<std::string> hrefs ;
+	for ( std::size_t i = 0 ; i < entries ; i++ )
+		hrefs.push_back( Href( ID( 'f', i ) ) ) ;
+	Run( "tree-find", "found", 0, boost::bind( &FindByHref, state.get(), boost::cref( hrefs ) ) ) ;
+	hrefs.clear() ;
+	state.reset() ;
+	fs::remove( root / ".grive_state" ) ;
+
+	{
+		File file ;
+		file.OpenForWrite( root / ".griveignore", 0600 ) ;
+		file.Write( ignore, sizeof(ignore) - 1 ) ;
+	}
+	Val options ;
+	options.Add( "path", Val( root.string() ) ) ;
+	state.reset( new State( root, options ) ) ;
+	std::vector<std::string> paths = Paths( entries ) ;
+	Run( "ignore", "ignored", 0, boost::bind( &Ignored, state.get(), boost::cref( paths ) ) ) ;
+	paths.clear() ;
+	state.reset() ;
+
+	std::string data( md5_size, 0 ) ;
+	for ( std::size_t i = 0 ; i < data.size() ; i++ )
+		data[i] = static_cast<char>( i * 2654435761u >> 24 ) ;
+	Run( "md5-memory", "digits", data.size(), boost::bind( &MD5Memory, boost::cref( data ) ) ) ;
+	{
+		File file ;
+		file.OpenForWrite( root / "md5", 0600 ) ;
+		file.Write( data.data(), data.size() ) ;
+	}
+	Run( "md5-file", "digits", data.size(), boost::bind( &MD5File, root / "md5" ) ) ;
+
+	fs::remove_all( root ) ;
+}
+
+} } // end of namespace gr::bench
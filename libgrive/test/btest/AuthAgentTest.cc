@@ -0,0 +1,173 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "drive2/FakeDrive.hh"
+
+#include "http/Error.hh"
+#include "protocol/AuthAgent.hh"
+#include "protocol/OAuth2.hh"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace gr ;
+
+namespace
+{
+	/// Completes the asynchronous requests in Wait(), with the responses queued
+	/// for their URL, like an event loop would.
+	class FakeAgent : public http::Agent
+	{
+	public :
+		FakeAgent() : requests( 0 ) {}
+
+		http::ResponseLog* GetLog() const { return 0 ; }
+		void SetLog( http::ResponseLog* ) {}
+		void SetProgressReporter( Progress* ) {}
+
+		long Request( const std::string&, const std::string& url, SeekStream*, DataStream*,
+			const http::Header&, u64_t )
+		{
+			requests++ ;
+			std::pair<long, std::string> r = Next( url ) ;
+			error = r.second ;
+			return r.first ;
+		}
+
+		void RequestAsync( const std::string&, const std::string& url, SeekStream*, DataStream*,
+			const http::Header&, const Callback& done )
+		{
+			pending.push_back( std::make_pair( url, done ) ) ;
+		}
+
+		void Wait()
+		{
+			while ( !pending.empty() || !tasks.empty() )
+			{
+				// everything in flight completes before the tasks are due
+				std::deque< std::pair<std::string, Callback> > now ;
+				now.swap( pending ) ;
+				for ( std::size_t i = 0 ; i < now.size() ; i++ )
+				{
+					std::pair<long, std::string> r = Next( now[i].first ) ;
+					error = r.second ;
+					now[i].second( r.first, std::exception_ptr() ) ;
+				}
+
+				std::vector<Task> due ;
+				due.swap( tasks ) ;
+				for ( std::size_t i = 0 ; i < due.size() ; i++ )
+					due[i]() ;
+			}
+		}
+
+		void Schedule( unsigned seconds, const Task& task )
+		{
+			delays.push_back( seconds ) ;
+			tasks.push_back( task ) ;
+		}
+
+		// the response queued for \a url, or 200
+		std::pair<long, std::string> Next( const std::string& url )
+		{
+			std::pair<long, std::string> r( 200, "" ) ;
+			std::deque< std::pair<long, std::string> >& q = responses[url] ;
+			if ( !q.empty() )
+			{
+				r = q.front() ;
+				q.pop_front() ;
+			}
+			return r ;
+		}
+
+		std::string LastError() const { return error ; }
+		std::string LastErrorHeaders() const { return "" ; }
+		std::string RedirLocation() const { return "" ; }
+		std::string ResponseHeader( const std::string& ) const { return "" ; }
+		std::string Escape( const std::string& str ) { return str ; }
+		std::string Unescape( const std::string& str ) { return str ; }
+
+		std::map< std::string, std::deque< std::pair<long, std::string> > >	responses ;
+		std::deque< std::pair<std::string, Callback> >	pending ;
+		std::vector<Task>		tasks ;
+		std::vector<unsigned>	delays ;
+		std::string				error ;
+		unsigned				requests ;
+	} ;
+
+	void Done( long *result, long response, std::exception_ptr error )
+	{
+		*result = error ? -1 : response ;
+	}
+
+	struct F
+	{
+		v2::FakeDrive		drive ;
+		v2::FakeDriveAgent	token_http ;
+		OAuth2				token ;
+		FakeAgent			http ;
+		AuthAgent			subject ;
+
+		F() :
+			token_http( &drive ),
+			token( &token_http, "refresh", "id", "secret" ),
+			subject( token, &http )
+		{
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( AuthAgentTest, F )
+
+BOOST_AUTO_TEST_CASE( TestAsyncRetry )
+{
+	http.responses["a"].push_back( std::make_pair( 503L, std::string( "backend" ) ) ) ;
+	http.responses["b"].push_back( std::make_pair( 403L, std::string(
+		"{\"error\": {\"errors\": [{\"reason\": \"rateLimitExceeded\", \"message\": \"\"}]}}" ) ) ) ;
+	http.responses["c"].push_back( std::make_pair( 403L, std::string( "forbidden" ) ) ) ;
+
+	long a = 0, b = 0, c = 0 ;
+	subject.RequestAsync( "GET", "a", 0, 0, http::Header(), boost::bind( &Done, &a, _1, _2 ) ) ;
+	subject.RequestAsync( "GET", "b", 0, 0, http::Header(), boost::bind( &Done, &b, _1, _2 ) ) ;
+	subject.RequestAsync( "GET", "c", 0, 0, http::Header(), boost::bind( &Done, &c, _1, _2 ) ) ;
+	subject.Wait() ;
+
+	// each one is judged by its own error, and the retries are left to the agent
+	BOOST_CHECK_EQUAL( a, 200 ) ;
+	BOOST_CHECK_EQUAL( b, 200 ) ;
+	BOOST_CHECK_EQUAL( c, -1 ) ;
+	BOOST_REQUIRE_EQUAL( http.delays.size(), 2u ) ;
+	BOOST_CHECK_EQUAL( http.delays[0], 5u ) ;
+	BOOST_CHECK_EQUAL( http.delays[1], 1u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestRequestOnce )
+{
+	http.responses["a"].push_back( std::make_pair( 503L, std::string( "backend" ) ) ) ;
+	BOOST_CHECK_THROW( subject.RequestOnce( "PUT", "a", 0, 0, http::Header() ), http::Error ) ;
+	// not sent again, unlike with Request()
+	BOOST_CHECK_EQUAL( http.requests, 1u ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,142 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "drive2/Batch.hh"
+
+#include "http/Agent.hh"
+#include "http/Error.hh"
+#include "util/DataStream.hh"
+
+#include <boost/bind.hpp>
+#include <boost/exception/get_error_info.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+using namespace gr::v2 ;
+
+namespace
+{
+	const std::string response =
+		"--batch_x\r\n"
+		"Content-Type: application/http\r\n"
+		"Content-ID: <response-item1>\r\n\r\n"
+		"HTTP/1.1 404 Not Found\r\n"
+		"Content-Type: application/json\r\n\r\n"
+		"{\"error\": {\"code\": 404}}\r\n"
+		"--batch_x\r\n"
+		"Content-Type: application/http\r\n"
+		"Content-ID: <response-item0>\r\n\r\n"
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/json; charset=UTF-8\r\n\r\n"
+		"{\"id\": \"abc\"}\r\n"
+		"--batch_x--\r\n" ;
+
+	/// answers every request with the batch response above
+	class FakeAgent : public http::Agent
+	{
+	public :
+		FakeAgent() : requests( 0 ) {}
+
+		http::ResponseLog* GetLog() const { return 0 ; }
+		void SetLog( http::ResponseLog* ) {}
+		void SetProgressReporter( Progress* ) {}
+
+		long Request( const std::string&, const std::string&, SeekStream *in, DataStream *dest,
+			const http::Header&, u64_t )
+		{
+			char buf[4096] ;
+			std::size_t count ;
+			while ( in && ( count = in->Read( buf, sizeof(buf) ) ) > 0 )
+				body.append( buf, count ) ;
+			dest->Write( response.c_str(), response.size() ) ;
+			requests++ ;
+			return 200 ;
+		}
+
+		std::string LastError() const { return "" ; }
+		std::string LastErrorHeaders() const { return "" ; }
+		std::string RedirLocation() const { return "" ; }
+		std::string ResponseHeader( const std::string& ) const { return "multipart/mixed; boundary=batch_x" ; }
+		std::string Escape( const std::string& str ) { return str ; }
+		std::string Unescape( const std::string& str ) { return str ; }
+
+		int			requests ;
+		std::string	body ;
+	} ;
+
+	struct F
+	{
+		Val			result[2] ;
+		int			code[2] ;
+
+		void Done( int i, const Val& val, std::exception_ptr error )
+		{
+			result[i] = val ;
+			code[i] = 0 ;
+			try
+			{
+				if ( error )
+					std::rethrow_exception( error ) ;
+			}
+			catch ( http::Error& e )
+			{
+				code[i] = *boost::get_error_info<http::HttpResponseCode>( e ) ;
+			}
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( BatchTest, F )
+
+BOOST_AUTO_TEST_CASE( TestParse )
+{
+	BOOST_CHECK_EQUAL( Batch::Boundary( "multipart/mixed; boundary=\"batch_x\"" ), "batch_x" ) ;
+
+	std::vector<Batch::Response> parts = Batch::Parse( response, "batch_x" ) ;
+	BOOST_REQUIRE_EQUAL( parts.size(), 2u ) ;
+	BOOST_CHECK_EQUAL( parts[0].id, "response-item1" ) ;
+	BOOST_CHECK_EQUAL( parts[0].code, 404 ) ;
+	BOOST_CHECK_EQUAL( parts[1].id, "response-item0" ) ;
+	BOOST_CHECK_EQUAL( parts[1].code, 200 ) ;
+	BOOST_CHECK_EQUAL( parts[1].body, "{\"id\": \"abc\"}" ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestFlush )
+{
+	FakeAgent agent ;
+	Batch subject( &agent ) ;
+	subject.Add( "POST", "https://www.googleapis.com/drive/v2/files", "{}", http::Header(),
+		boost::bind( &F::Done, this, 0, _1, _2 ) ) ;
+	subject.Add( "POST", "https://www.googleapis.com/drive/v2/files/xyz/trash", "", http::Header() + "If-Match: e",
+		boost::bind( &F::Done, this, 1, _1, _2 ) ) ;
+	BOOST_CHECK_EQUAL( agent.requests, 0 ) ;
+
+	subject.Flush() ;
+	BOOST_CHECK_EQUAL( agent.requests, 1 ) ;
+	BOOST_CHECK( agent.body.find( "POST /drive/v2/files/xyz/trash HTTP/1.1\r\nIf-Match: e\r\n" ) != std::string::npos ) ;
+
+	// the responses are matched by their ID, not by their order
+	BOOST_CHECK_EQUAL( code[0], 0 ) ;
+	BOOST_CHECK_EQUAL( result[0]["id"].Str(), "abc" ) ;
+	BOOST_CHECK_EQUAL( code[1], 404 ) ;
+	BOOST_CHECK_EQUAL( subject.Size(), 0u ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,126 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2013 Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+	MA  02110-1301, USA.
+*/
+
+#include "json/BinaryVal.hh"
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "util/StringStream.hh"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( BinaryValTest, F )
+
+BOOST_AUTO_TEST_CASE( TestRoundTrip )
+{
+	std::string json = "{\"change_stamp\":1234,\"ignore_regexp\":\"\",\"tree\":{"
+		"\"a\":{\"ctime\":1400000000,\"md5\":\"0123456789abcdef0123456789abcdef\",\"size\":42,\"srv_time\":1400000001},"
+		"\"b\":{\"ctime\":1400000002,\"tree\":{\"c\":{\"ctime\":1,\"size\":0}}}},"
+		"\"list\":[1,2.5,true,\"x\",[]]}" ;
+	Val val = ParseJson( json ) ;
+	
+	StringStream ss ;
+	binary::Write( val, &ss ) ;
+	
+	BOOST_CHECK( binary::IsBinary( ss.Str().c_str(), ss.Str().size() ) ) ;
+	BOOST_CHECK( !binary::IsBinary( json.c_str(), json.size() ) ) ;
+	
+	Val result = binary::Read( ss.Str().c_str(), ss.Str().size() ) ;
+	BOOST_CHECK_EQUAL( WriteJson( result ), WriteJson( val ) ) ;
+	BOOST_CHECK_EQUAL( result["tree"]["b"]["tree"]["c"]["ctime"].U64(), 1u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestCorrupt )
+{
+	StringStream ss ;
+	binary::Write( ParseJson( "{\"tree\":{\"a\":{\"md5\":\"x\"}}}" ), &ss ) ;
+	std::string data = ss.Str() ;
+	
+	// truncated
+	BOOST_CHECK_THROW( binary::Read( data.c_str(), data.size() - 1 ), binary::Error ) ;
+	
+	// key of the first child (after the 32-byte header and 16-byte root node)
+	// pointing outside of the string table
+	std::string bad = data ;
+	bad.replace( 32+16+4, 4, "\x7f\x7f\x7f\x7f" ) ;
+	BOOST_CHECK_THROW( binary::Read( bad.c_str(), bad.size() ), binary::Error ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestLazy )
+{
+	StringStream ss ;
+	binary::Write( ParseJson( "{\"tree\":{"
+		"\"a\":{\"ctime\":1,\"md5\":\"x\"},"
+		"\"b\":{\"ctime\":2,\"md5\":\"y\"}}}" ), &ss ) ;
+	std::string data = ss.Str() ;
+	
+	std::shared_ptr<const binary::Image> image(
+		new binary::Image( data.c_str(), data.size() ) ) ;
+	Val root = binary::Image::Root( image ) ;
+	BOOST_CHECK( root.IsMapped() ) ;
+	
+	// looking up members leaves the object in the image
+	Val v ;
+	BOOST_CHECK( root.Has( "tree" ) ) ;
+	BOOST_CHECK( !root.Has( "list" ) ) ;
+	BOOST_CHECK( root.Get( "tree", v ) ) ;
+	BOOST_CHECK( root.IsMapped() ) ;
+	BOOST_CHECK( v.IsMapped() ) ;
+	
+	// changing it decodes one level
+	Val& tree = root["tree"] ;
+	BOOST_CHECK( !root.IsMapped() ) ;
+	BOOST_CHECK( tree.IsMapped() ) ;
+	tree["b"].Set( "md5", Val( std::string( "z" ) ) ) ;
+	BOOST_CHECK( !tree.IsMapped() ) ;
+	BOOST_CHECK( tree["a"].IsMapped() ) ;
+	BOOST_CHECK( !tree["b"].IsMapped() ) ;
+	
+	// the unchanged parts are copied from the image
+	StringStream out ;
+	binary::Write( root, &out ) ;
+	Val result = binary::Read( out.Str().c_str(), out.Str().size() ) ;
+	BOOST_CHECK_EQUAL( WriteJson( result ), WriteJson( ParseJson( "{\"tree\":{"
+		"\"a\":{\"ctime\":1,\"md5\":\"x\"},"
+		"\"b\":{\"ctime\":2,\"md5\":\"z\"}}}" ) ) ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestUnsorted )
+{
+	StringStream ss ;
+	binary::Write( ParseJson( "{\"a\":1,\"b\":2}" ), &ss ) ;
+	std::string data = ss.Str() ;
+	
+	// swap the keys of the two members, after the header and the root node
+	std::string bad = data ;
+	bad.replace( 32+16+4, 4, data, 32+32+4, 4 ) ;
+	bad.replace( 32+32+4, 4, data, 32+16+4, 4 ) ;
+	BOOST_CHECK_THROW( binary::Read( bad.c_str(), bad.size() ), binary::Error ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "util/BufferedStream.hh"
+#include "util/StringStream.hh"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	// counts the writes reaching the stream below
+	class CountWrites : public StringStream
+	{
+	public :
+		CountWrites() : count( 0 )
+		{
+		}
+
+		std::size_t Write( const char *data, std::size_t size )
+		{
+			count++ ;
+			return StringStream::Write( data, size ) ;
+		}
+
+		std::size_t count ;
+	} ;
+}
+
+BOOST_AUTO_TEST_SUITE( BufferedStreamTest )
+
+BOOST_AUTO_TEST_CASE( TestSmallWrites )
+{
+	CountWrites base ;
+	BufferedStream subject( &base, 8 ) ;
+
+	for ( int i = 0 ; i < 10 ; i++ )
+		subject.Write( "ab", 2 ) ;
+
+	// two full blocks of four pieces each
+	BOOST_CHECK_EQUAL( base.count, 2u ) ;
+	BOOST_CHECK_EQUAL( base.Str(), "abababababababab" ) ;
+
+	subject.Flush() ;
+	BOOST_CHECK_EQUAL( base.count, 3u ) ;
+	BOOST_CHECK_EQUAL( base.Str(), "abababababababababab" ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestLargeWrite )
+{
+	CountWrites base ;
+	BufferedStream subject( &base, 8 ) ;
+
+	subject.Write( "xy", 2 ) ;
+	subject.Write( "0123456789abcdef", 16 ) ;
+
+	// the buffered part goes first, the big one is not copied
+	BOOST_CHECK_EQUAL( base.count, 2u ) ;
+	BOOST_CHECK_EQUAL( base.Str(), "xy0123456789abcdef" ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,111 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "util/DirScanner.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path root ;
+
+		F() : root( fs::temp_directory_path() / fs::unique_path( "grive-scan-%%%%%%%%" ) )
+		{
+			// 20 directories of 20 files each, plus some special cases
+			for ( int d = 0 ; d < 20 ; d++ )
+			{
+				fs::path dir = root / ( "dir" + std::to_string( d ) ) ;
+				fs::create_directories( dir / "sub" ) ;
+				for ( int f = 19 ; f >= 0 ; f-- )
+					std::ofstream( ( dir / ( "f" + std::to_string( f ) ) ).string().c_str() ) << "data" << f ;
+			}
+			fs::create_directories( root / "skip" / "deep" ) ;
+			fs::create_symlink( root / "nowhere", root / "dangling" ) ;
+		}
+
+		~F()
+		{
+			fs::remove_all( root ) ;
+		}
+	} ;
+
+	bool Ignore( const std::string& path )
+	{
+		return path == "skip" || path == "dir3/f7" ;
+	}
+
+	const DirScanner::Node* Find( const DirScanner::Node& dir, const std::string& name )
+	{
+		for ( std::vector<DirScanner::Node>::const_iterator i = dir.children.begin() ; i != dir.children.end() ; ++i )
+			if ( i->name == name )
+				return &*i ;
+		return 0 ;
+	}
+}
+
+BOOST_FIXTURE_TEST_SUITE( DirScannerTest, F )
+
+BOOST_AUTO_TEST_CASE( TestScan )
+{
+	DirScanner::Node result ;
+	DirScanner scanner( 4, &Ignore ) ;
+	scanner.Scan( root, result ) ;
+
+	BOOST_CHECK_EQUAL( result.children.size(), 22u ) ;
+	for ( std::size_t i = 1 ; i < result.children.size() ; i++ )
+		BOOST_CHECK( result.children[i-1].name < result.children[i].name ) ;
+
+	const DirScanner::Node *dir3 = Find( result, "dir3" ) ;
+	BOOST_REQUIRE( dir3 != 0 ) ;
+	BOOST_CHECK_EQUAL( dir3->type, FT_DIR ) ;
+	BOOST_CHECK_EQUAL( dir3->children.size(), 21u ) ;
+
+	const DirScanner::Node *f12 = Find( *dir3, "f12" ) ;
+	BOOST_REQUIRE( f12 != 0 ) ;
+	BOOST_CHECK_EQUAL( f12->type, FT_FILE ) ;
+	BOOST_CHECK_EQUAL( f12->size, 6u ) ;
+	BOOST_CHECK( !f12->ignored ) ;
+	BOOST_CHECK( Find( *dir3, "f7" )->ignored ) ;
+
+	// ignored directories are not descended
+	const DirScanner::Node *skip = Find( result, "skip" ) ;
+	BOOST_REQUIRE( skip != 0 ) ;
+	BOOST_CHECK( skip->ignored ) ;
+	BOOST_CHECK( skip->children.empty() ) ;
+
+	const DirScanner::Node *dangling = Find( result, "dangling" ) ;
+	BOOST_REQUIRE( dangling != 0 ) ;
+	BOOST_CHECK_EQUAL( dangling->error, ENOENT ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestMissingRoot )
+{
+	DirScanner::Node result ;
+	DirScanner scanner( 4, DirScanner::Filter() ) ;
+	BOOST_CHECK_THROW( scanner.Scan( root / "missing", result ), fs::filesystem_error ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,91 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "http/Download.hh"
+#include "util/File.hh"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <iterator>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path file ;
+
+		F() : file( fs::temp_directory_path() / fs::unique_path( "grive-download-%%%%%%%%" ) )
+		{
+		}
+
+		~F()
+		{
+			fs::remove( file ) ;
+		}
+
+		std::string Content() const
+		{
+			std::ifstream in( file.string().c_str() ) ;
+			return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() ) ;
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( DownloadTest, F )
+
+BOOST_AUTO_TEST_CASE( TestRanges )
+{
+	File f( file, 0600 ) ;
+	f.Truncate( 10 ) ;
+
+	// ranges may arrive in any order
+	http::Download second( &f, 5 ) ;
+	http::Download first( &f, 0 ) ;
+	BOOST_CHECK_EQUAL( second.Write( "567", 3 ), 3u ) ;
+	BOOST_CHECK_EQUAL( first.Write( "01234", 5 ), 5u ) ;
+	BOOST_CHECK_EQUAL( second.Write( "89", 2 ), 2u ) ;
+
+	BOOST_CHECK_EQUAL( first.Offset(), 5u ) ;
+	BOOST_CHECK_EQUAL( second.Offset(), 10u ) ;
+	BOOST_CHECK_EQUAL( f.Tell(), 0 ) ;
+	BOOST_CHECK_EQUAL( Content(), "0123456789" ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestResume )
+{
+	{
+		File f( file, 0600 ) ;
+		http::Download dl( &f, 0 ) ;
+		dl.Write( "abc", 3 ) ;
+	}
+
+	// opening for update keeps what was downloaded before
+	File f ;
+	f.OpenForUpdate( file ) ;
+	BOOST_CHECK_EQUAL( f.Size(), 3u ) ;
+	http::Download dl( &f, f.Size() ) ;
+	dl.Write( "def", 3 ) ;
+	BOOST_CHECK_EQUAL( Content(), "abcdef" ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
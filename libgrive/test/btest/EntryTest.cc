@@ -0,0 +1,92 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "base/Entry.hh"
+#include "drive2/Entry2.hh"
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "json/Val.hh"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( EntryTest, F )
+
+BOOST_AUTO_TEST_CASE( TestIndex )
+{
+	Val file = ParseJson(
+		"{\"kind\":\"drive#file\",\"id\":\"abc\",\"etag\":\"\\\"e1\\\"\",\"title\":\"a.txt\","
+		"\"selfLink\":\"https://www.googleapis.com/drive/v2/files/abc\","
+		"\"modifiedDate\":\"2015-05-01T10:20:30.123Z\",\"mimeType\":\"text/plain\",\"editable\":true,"
+		"\"labels\":{\"trashed\":false},\"md5Checksum\":\"0123456789ABCDEF0123456789ABCDEF\","
+		"\"fileSize\":\"42\",\"downloadUrl\":\"https://example.com/abc\","
+		"\"parents\":[{\"isRoot\":false,\"parentLink\":\"https://www.googleapis.com/drive/v2/files/p1\"}]}" ) ;
+	v2::Entry2 remote( file ) ;
+
+	// the index goes through the state file as JSON
+	Entry subject( ParseJson( WriteJson( remote.Index() ) ) ) ;
+
+	BOOST_CHECK_EQUAL( subject.Name(),			remote.Name() ) ;
+	BOOST_CHECK_EQUAL( subject.ResourceID(),	"abc" ) ;
+	BOOST_CHECK_EQUAL( subject.ETag(),			remote.ETag() ) ;
+	BOOST_CHECK_EQUAL( subject.SelfHref(),		remote.SelfHref() ) ;
+	BOOST_CHECK_EQUAL( subject.ParentHref(),	"https://www.googleapis.com/drive/v2/files/p1" ) ;
+	BOOST_CHECK_EQUAL( subject.ContentSrc(),	remote.ContentSrc() ) ;
+	BOOST_CHECK_EQUAL( subject.MD5(),			"0123456789abcdef0123456789abcdef" ) ;
+	BOOST_CHECK_EQUAL( subject.Size(),			42u ) ;
+	BOOST_CHECK( subject.MTime() == remote.MTime() ) ;
+	BOOST_CHECK( subject.IsEditable() ) ;
+	BOOST_CHECK( !subject.IsDir() ) ;
+	BOOST_CHECK( !subject.IsChange() ) ;
+	BOOST_CHECK( !subject.IsRemoved() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestFields )
+{
+	// a change with only the fields requested from the changes feed
+	Val change = ParseJson(
+		"{\"kind\":\"drive#change\",\"id\":\"7\",\"deleted\":false,\"fileId\":\"abc\",\"file\":"
+		"{\"kind\":\"drive#file\",\"id\":\"abc\",\"etag\":\"e1\",\"title\":\"a.txt\","
+		"\"selfLink\":\"https://www.googleapis.com/drive/v2/files/abc\","
+		"\"modifiedDate\":\"2015-05-01T10:20:30.123Z\",\"mimeType\":\"text/plain\",\"editable\":true,"
+		"\"labels\":{\"trashed\":false},\"md5Checksum\":\"0123456789abcdef0123456789abcdef\","
+		"\"fileSize\":\"42\",\"downloadUrl\":\"https://example.com/abc\","
+		"\"parents\":[{\"isRoot\":true,\"parentLink\":\"https://www.googleapis.com/drive/v2/files/r\"}]}}" ) ;
+	v2::Entry2 subject( change ) ;
+
+	BOOST_CHECK_EQUAL( subject.ChangeStamp(),	7 ) ;
+	BOOST_CHECK_EQUAL( subject.ResourceID(),	"abc" ) ;
+	BOOST_CHECK_EQUAL( subject.Size(),			42u ) ;
+	BOOST_CHECK_EQUAL( subject.ParentHref(),	"root" ) ;
+	BOOST_CHECK( !subject.IsRemoved() ) ;
+
+	const Val::Object& file = change["file"].AsObject() ;
+	for ( Val::Object::const_iterator i = file.begin() ; i != file.end() ; ++i )
+		BOOST_CHECK( v2::Entry2::FileFields().find( i->first ) != std::string::npos ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+#include "base/FeedPrefetcher.hh"
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+	} ;
+
+	// pages of \a size empty entries, failing after \a fail_at pages if not 0
+	class FakeFeed : public Feed
+	{
+	public :
+		FakeFeed( std::size_t size, int pages, int fail_at = 0 ) :
+			Feed( "" ), m_size( size ), m_pages( pages ), m_fail_at( fail_at ), m_count( 0 )
+		{
+		}
+
+		bool GetNext( http::Agent *http )
+		{
+			if ( m_fail_at > 0 && m_count == m_fail_at )
+				throw std::runtime_error( "listing failed" ) ;
+			if ( m_count == m_pages )
+				return false ;
+
+			m_count++ ;
+			m_entries.assign( m_size, Entry() ) ;
+			return true ;
+		}
+
+	private :
+		std::size_t	m_size ;
+		int			m_pages ;
+		int			m_fail_at ;
+		int			m_count ;
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( FeedPrefetcherTest, F )
+
+BOOST_AUTO_TEST_CASE( TestParts )
+{
+	std::vector< std::unique_ptr<Feed> > feeds ;
+	for ( std::size_t i = 1 ; i <= 10 ; i++ )
+		feeds.push_back( std::unique_ptr<Feed>( new FakeFeed( i, 20 ) ) ) ;
+
+	FeedPrefetcher subject( std::move( feeds ), std::vector<http::Agent*>( 3, (http::Agent*)0 ) ) ;
+
+	Feed::Entries page ;
+	std::size_t pages = 0, entries = 0 ;
+	while ( subject.GetNext( page ) )
+	{
+		pages++ ;
+		entries += page.size() ;
+	}
+	BOOST_CHECK_EQUAL( pages, 200u ) ;
+	BOOST_CHECK_EQUAL( entries, 20u * 55u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestError )
+{
+	std::vector< std::unique_ptr<Feed> > feeds ;
+	feeds.push_back( std::unique_ptr<Feed>( new FakeFeed( 1, 100, 3 ) ) ) ;
+
+	FeedPrefetcher subject( std::move( feeds ), std::vector<http::Agent*>( 1, (http::Agent*)0 ) ) ;
+
+	Feed::Entries page ;
+	int pages = 0 ;
+	BOOST_CHECK_THROW( while ( subject.GetNext( page ) ) pages++, std::runtime_error ) ;
+	BOOST_CHECK_EQUAL( pages, 3 ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "base/HashCache.hh"
+#include "util/Crypt.hh"
+#include "json/Val.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path root ;
+
+		F() : root( fs::temp_directory_path() / fs::unique_path( "grive-hash-%%%%%%%%" ) )
+		{
+			fs::create_directories( root ) ;
+			std::ofstream( ( root / "a" ).string().c_str() ) << "some data" ;
+		}
+
+		~F()
+		{
+			fs::remove_all( root ) ;
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( HashCacheTest, F )
+
+BOOST_AUTO_TEST_CASE( TestGet )
+{
+	HashCache subject ;
+	std::string md5 = crypt::MD5::Get( root / "a" ) ;
+
+	BOOST_CHECK_EQUAL( subject.Get( root / "a" ), md5 ) ;
+	BOOST_CHECK_EQUAL( subject.Misses(), 1u ) ;
+
+	// neither a change of permissions nor a rename reads the file again
+	fs::permissions( root / "a", fs::owner_read ) ;
+	fs::rename( root / "a", root / "b" ) ;
+	BOOST_CHECK_EQUAL( subject.Get( root / "b" ), md5 ) ;
+	BOOST_CHECK_EQUAL( subject.Hits(), 1u ) ;
+
+	fs::permissions( root / "b", fs::owner_read | fs::owner_write ) ;
+	std::ofstream( ( root / "b" ).string().c_str(), std::ios::app ) << " and more" ;
+	BOOST_CHECK_EQUAL( subject.Get( root / "b" ), crypt::MD5::Get( root / "b" ) ) ;
+	BOOST_CHECK_EQUAL( subject.Misses(), 2u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestReadWrite )
+{
+	HashCache first ;
+	std::string md5 = first.Get( root / "a" ) ;
+
+	HashCache second ;
+	second.Read( first.Write() ) ;
+	BOOST_CHECK_EQUAL( second.Get( root / "a" ), md5 ) ;
+	BOOST_CHECK_EQUAL( second.Hits(), 1u ) ;
+	BOOST_CHECK_EQUAL( second.Misses(), 0u ) ;
+
+	// entries which weren't used are not saved again
+	HashCache third ;
+	third.Read( first.Write() ) ;
+	BOOST_CHECK( third.Write().AsObject().empty() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestAsync )
+{
+	HashCache subject ;
+	std::vector<std::shared_future<std::string> > results ;
+	for ( int i = 0 ; i < 20 ; i++ )
+	{
+		std::ofstream( ( root / std::to_string( i ) ).string().c_str() ) << "file " << i ;
+		results.push_back( subject.Async( root / std::to_string( i ) ) ) ;
+	}
+
+	for ( int i = 0 ; i < 20 ; i++ )
+		BOOST_CHECK_EQUAL( results[i].get(), crypt::MD5::Get( root / std::to_string( i ) ) ) ;
+
+	// Get() takes the result of Async() instead of reading the file again
+	BOOST_CHECK_EQUAL( subject.Get( root / "7" ), results[7].get() ) ;
+	BOOST_CHECK_EQUAL( subject.Misses(), 20u ) ;
+	BOOST_CHECK_EQUAL( subject.Hits(), 0u ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,42 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "http/Header.hh"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace gr::http ;
+
+BOOST_AUTO_TEST_SUITE( HeaderTest )
+
+BOOST_AUTO_TEST_CASE( TestStatusCode )
+{
+	BOOST_CHECK_EQUAL( StatusCode( "HTTP/1.1 206 Partial Content\r\n" ), 206 ) ;
+	BOOST_CHECK_EQUAL( StatusCode( "HTTP/1.0 503 Service Unavailable\r\n" ), 503 ) ;
+
+	// HTTP/2 has no reason phrase, and a shorter version
+	BOOST_CHECK_EQUAL( StatusCode( "HTTP/2 206\r\n" ), 206 ) ;
+	BOOST_CHECK_EQUAL( StatusCode( "HTTP/2 502\r\n" ), 502 ) ;
+	BOOST_CHECK_EQUAL( StatusCode( "HTTP/2 308 \r\n" ), 308 ) ;
+
+	BOOST_CHECK_EQUAL( StatusCode( "Content-Type: text/html\r\n" ), 0 ) ;
+	BOOST_CHECK_EQUAL( StatusCode( "\r\n" ), 0 ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
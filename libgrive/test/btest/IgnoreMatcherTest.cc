@@ -0,0 +1,94 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "util/IgnoreMatcher.hh"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		IgnoreMatcher subject ;
+
+		void Add( const std::string& pattern )
+		{
+			bool include = pattern[0] == '!' ;
+			std::vector<std::string> parts ;
+			boost::split( parts, include ? pattern.substr( 1 ) : pattern, boost::is_any_of( "/" ) ) ;
+			subject.Add( parts, include ) ;
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( IgnoreMatcherTest, F )
+
+BOOST_AUTO_TEST_CASE( TestGlob )
+{
+	Add( "build" ) ;
+	Add( "*.o" ) ;
+	Add( "doc/??.txt" ) ;
+	Add( "a\\*b" ) ;
+
+	BOOST_CHECK( !subject.Empty() ) ;
+	BOOST_CHECK( subject.IsIgnored( "build" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "build/deep/file" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "main.o" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "doc/ab.txt" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "a*b" ) ) ;
+
+	BOOST_CHECK( !subject.IsIgnored( "builds" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "src/main.o" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "main.c" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "doc/abc.txt" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "axxb" ) ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestAnyDepth )
+{
+	Add( "**/cache" ) ;
+	Add( "tmp/**" ) ;
+
+	BOOST_CHECK( subject.IsIgnored( "a/cache" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "a/b/c/cache" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "tmp/x" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "tmp/x/y" ) ) ;
+
+	BOOST_CHECK( !subject.IsIgnored( "cache" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "a/cached" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "tmp" ) ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestInclude )
+{
+	Add( "*" ) ;
+	Add( "!docs/keep/*.txt" ) ;
+
+	// the parents of included files must still be read
+	BOOST_CHECK( !subject.IsIgnored( "docs" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "docs/keep" ) ) ;
+	BOOST_CHECK( !subject.IsIgnored( "docs/keep/a.txt" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "music" ) ) ;
+	BOOST_CHECK( subject.IsIgnored( "music/song.mp3" ) ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
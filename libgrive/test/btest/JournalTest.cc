@@ -0,0 +1,90 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "base/Journal.hh"
+#include "json/JsonParser.hh"
+#include "json/Val.hh"
+#include "util/File.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path file ;
+
+		F() : file( fs::temp_directory_path() / fs::unique_path( "grive-journal-%%%%%%%%" ) )
+		{
+		}
+
+		~F()
+		{
+			fs::remove( file ) ;
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( JournalTest, F )
+
+BOOST_AUTO_TEST_CASE( TestReplay )
+{
+	Val st = ParseJson(
+		"{\"change_stamp\":5,\"tree\":{"
+		"\"dir\":{\"ctime\":1,\"tree\":{\"old\":{\"ctime\":2,\"md5\":\"a\",\"size\":1}}},"
+		"\"gone\":{\"ctime\":3,\"md5\":\"b\",\"size\":2}}}" ) ;
+	{
+		Val file_index = ParseJson( "{\"ctime\":4,\"md5\":\"c\",\"size\":3,\"srv_time\":9}" ) ;
+		Val dir_index = ParseJson( "{\"ctime\":7,\"srv_time\":8,\"tree\":{\"ignored\":{}}}" ) ;
+		
+		Journal journal( file ) ;
+		journal.Record( fs::path( "dir" ) / "new", &file_index ) ;
+		journal.Record( "gone", NULL ) ;
+		
+		// a folder keeps its children
+		journal.Record( "dir", &dir_index ) ;
+	}
+	
+	// a record cut short by a crash, which is dropped
+	{
+		File out ;
+		out.OpenForAppend( file ) ;
+		out.Write( "{\"path\":[\"x\"", 12 ) ;
+	}
+	
+	Journal journal( file ) ;
+	BOOST_CHECK_EQUAL( journal.Replay( st ), 3u ) ;
+	
+	BOOST_CHECK_EQUAL( st["change_stamp"].Int(), 5 ) ;
+	BOOST_CHECK( !st["tree"].Has( "gone" ) ) ;
+	BOOST_CHECK( !st["tree"].Has( "x" ) ) ;
+	BOOST_CHECK_EQUAL( st["tree"]["dir"]["ctime"].Int(), 7 ) ;
+	BOOST_CHECK_EQUAL( st["tree"]["dir"]["tree"]["old"]["md5"].Str(), "a" ) ;
+	BOOST_CHECK( !st["tree"]["dir"]["tree"].Has( "ignored" ) ) ;
+	BOOST_CHECK_EQUAL( st["tree"]["dir"]["tree"]["new"]["md5"].Str(), "c" ) ;
+	BOOST_CHECK_EQUAL( st["tree"]["dir"]["tree"]["new"]["srv_time"].Int(), 9 ) ;
+	
+	journal.Clear() ;
+	BOOST_CHECK( !fs::exists( file ) ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -21,8 +21,10 @@
 #include "json/Val.hh"
 #include "json/ValBuilder.hh"
 #include "json/JsonWriter.hh"
+#include "json/ItemBuilder.hh"
 #include "util/StringStream.hh"
 
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 using namespace gr ;
@@ -32,6 +34,11 @@ namespace
 	struct F
 	{
 	} ;
+	
+	void Collect( std::vector<Val> *items, const Val& item )
+	{
+		items->push_back( item ) ;
+	}
 }
 
 BOOST_FIXTURE_TEST_SUITE( JsonValTest, F )
@@ -52,4 +59,48 @@ BOOST_AUTO_TEST_CASE( Test )
 //	std::cout << ss.Str() << std::endl ;
 }
 
+BOOST_AUTO_TEST_CASE( TestItems )
+{
+	std::vector<Val> items ;
+	ItemBuilder b( "items", boost::bind( &Collect, &items, _1 ) ) ;
+	JsonParser parser( &b ) ;
+	
+	// feed the text in small pieces, as it would arrive from the network
+	std::string json = "{\"kind\":\"list\",\"items\":[{\"id\":\"a\",\"parents\":[{\"id\":\"p\"}]},"
+		"{\"id\":\"b\",\"parents\":[]},7],\"nextLink\":\"next\"}" ;
+	for ( std::size_t i = 0 ; i < json.size() ; i += 5 )
+		parser.Parse( json.c_str() + i, std::min<std::size_t>( 5, json.size() - i ) ) ;
+	parser.Finish() ;
+	
+	BOOST_REQUIRE_EQUAL( items.size(), 3u ) ;
+	BOOST_CHECK_EQUAL( items[0]["id"].Str(), "a" ) ;
+	BOOST_CHECK_EQUAL( items[0]["parents"].AsArray()[0]["id"].Str(), "p" ) ;
+	BOOST_CHECK_EQUAL( items[1]["id"].Str(), "b" ) ;
+	BOOST_CHECK_EQUAL( items[2].As<long long>(), 7 ) ;
+	
+	Val page = b.Result() ;
+	BOOST_CHECK_EQUAL( page["kind"].Str(), "list" ) ;
+	BOOST_CHECK_EQUAL( page["nextLink"].Str(), "next" ) ;
+	BOOST_CHECK( page["items"].AsArray().empty() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestBuilder )
+{
+	ValBuilder b ;
+	JsonParser first( &b ) ;
+	std::string json = "{\"kind\":\"a\",\"kind\":\"b\",\"list\":[1,{\"id\":\"x\"}]}" ;
+	first.Parse( json.c_str(), json.size() ) ;
+	first.Finish() ;
+
+	Val doc = b.TakeResult() ;
+	BOOST_CHECK_EQUAL( doc["kind"].Str(), "a" ) ;
+	BOOST_CHECK_EQUAL( doc["list"].AsArray()[1]["id"].Str(), "x" ) ;
+
+	// the builder is ready for the next document
+	JsonParser second( &b ) ;
+	second.Parse( "[true]", 6 ) ;
+	second.Finish() ;
+	BOOST_CHECK( b.Result().AsArray()[0].Bool() ) ;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,58 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "util/RangeStream.hh"
+#include "util/StringStream.hh"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		StringStream base ;
+
+		F() : base( "0123456789abcdef" )
+		{
+		}
+	} ;
+}
+
+BOOST_FIXTURE_TEST_SUITE( RangeStreamTest, F )
+
+BOOST_AUTO_TEST_CASE( TestRead )
+{
+	RangeStream subject( &base, 4, 8 ) ;
+	BOOST_CHECK_EQUAL( subject.Size(), 8u ) ;
+
+	char buf[16] = {} ;
+	BOOST_CHECK_EQUAL( subject.Read( buf, sizeof(buf) ), 8u ) ;
+	BOOST_CHECK_EQUAL( std::string( buf, 8 ), "456789ab" ) ;
+	BOOST_CHECK_EQUAL( subject.Read( buf, sizeof(buf) ), 0u ) ;
+
+	// a retried request starts again at the beginning of the range
+	BOOST_CHECK_EQUAL( subject.Seek( 0, 0 ), 0 ) ;
+	BOOST_CHECK_EQUAL( subject.Read( buf, 3 ), 3u ) ;
+	BOOST_CHECK_EQUAL( std::string( buf, 3 ), "456" ) ;
+	BOOST_CHECK_EQUAL( subject.Tell(), 3 ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
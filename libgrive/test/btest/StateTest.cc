@@ -0,0 +1,105 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "base/Resource.hh"
+#include "base/State.hh"
+#include "drive2/Entry2.hh"
+#include "json/JsonParser.hh"
+#include "json/Val.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path root ;
+		Val options ;
+
+		F() : root( fs::temp_directory_path() / fs::unique_path( "grive-state-%%%%%%%%" ) )
+		{
+			fs::create_directories( root ) ;
+			options.Add( "path", Val( root.string() ) ) ;
+		}
+
+		~F()
+		{
+			fs::remove_all( root ) ;
+		}
+	} ;
+
+	std::string Href( const std::string& id )
+	{
+		return "https://www.googleapis.com/drive/v2/files/" + id ;
+	}
+
+	v2::Entry2 Folder( const std::string& id, const std::string& parent )
+	{
+		std::string link = parent == "root" ?
+			"{\"isRoot\":true}" : "{\"isRoot\":false,\"parentLink\":\"" + Href( parent ) + "\"}" ;
+		return v2::Entry2( ParseJson(
+			"{\"kind\":\"drive#file\",\"id\":\"" + id + "\",\"title\":\"" + id + "\",\"etag\":\"\\\"1\\\"\","
+			"\"selfLink\":\"" + Href( id ) + "\",\"modifiedDate\":\"2015-05-01T10:20:30.123Z\","
+			"\"mimeType\":\"application/vnd.google-apps.folder\",\"editable\":true,"
+			"\"labels\":{\"trashed\":false},\"parents\":[" + link + "]}" ) ) ;
+	}
+}
+
+BOOST_FIXTURE_TEST_SUITE( StateTest, F )
+
+BOOST_AUTO_TEST_CASE( TestChildrenBeforeParents )
+{
+	State subject( root, options ) ;
+	subject.FromLocal( root ) ;
+
+	subject.FromRemote( Folder( "c", "b" ) ) ;
+	subject.FromRemote( Folder( "orphan", "nowhere" ) ) ;
+	subject.FromRemote( Folder( "b2", "a" ) ) ;
+	subject.FromRemote( Folder( "b", "a" ) ) ;
+	BOOST_CHECK( subject.FindByHref( Href( "c" ) ) == 0 ) ;
+
+	// resolves the whole chain at once
+	subject.FromRemote( Folder( "a", "root" ) ) ;
+	Resource *c = subject.FindByHref( Href( "c" ) ) ;
+	BOOST_REQUIRE( c != 0 ) ;
+	BOOST_CHECK_EQUAL( c->RelPath().string(), "a/b/c" ) ;
+	BOOST_CHECK( subject.FindByHref( Href( "b2" ) ) != 0 ) ;
+
+	BOOST_CHECK_EQUAL( subject.ResolveEntry(), 1u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestClearRemote )
+{
+	State subject( root, options ) ;
+	Val remote( Val::object_type ) ;
+	State::UpdateRemote( remote, Folder( "a", "root" ) ) ;
+	subject.SetRemote( std::move( remote ) ) ;
+	BOOST_CHECK( subject.HasRemote() ) ;
+
+	// a full listing which fails leaves no list behind, not an empty one
+	subject.ClearRemote() ;
+	BOOST_CHECK( !subject.HasRemote() ) ;
+	subject.Write() ;
+	BOOST_CHECK( !State( root, options ).HasRemote() ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
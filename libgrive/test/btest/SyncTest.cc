@@ -0,0 +1,148 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "drive2/FakeDrive.hh"
+
+#include "base/Drive.hh"
+#include "drive2/Syncer2.hh"
+#include "json/Val.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <iterator>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path			root ;
+		v2::FakeDrive		drive ;
+		v2::FakeDriveAgent	agent ;
+		v2::Syncer2			syncer ;
+
+		F() :
+			root( fs::temp_directory_path() / fs::unique_path( "grive-sync-%%%%%%%%" ) ),
+			agent( &drive ),
+			syncer( &agent )
+		{
+		}
+
+		~F()
+		{
+			fs::remove_all( root ) ;
+		}
+
+		// one run of grive in \a dir
+		void Sync( const fs::path& dir )
+		{
+			fs::create_directories( dir ) ;
+			// the options Config gives without any on the command line
+			Val options ;
+			options.Add( "path",				Val( dir.string() ) ) ;
+			options.Add( "new-rev",				Val( false ) ) ;
+			options.Add( "no-remote-new",		Val( false ) ) ;
+			options.Add( "upload-only",			Val( false ) ) ;
+			options.Add( "no-delete-remote",	Val( false ) ) ;
+
+			Drive d( &syncer, options ) ;
+			d.DetectChanges() ;
+			d.Update() ;
+			d.SaveState() ;
+		}
+
+		std::string Remote( const std::string& path )
+		{
+			std::string content ;
+			drive.Content( drive.Find( path ), content ) ;
+			return content ;
+		}
+	} ;
+
+	void WriteFile( const fs::path& path, const std::string& content )
+	{
+		fs::create_directories( path.parent_path() ) ;
+		fs::ofstream( path, std::ios::binary ) << content ;
+	}
+
+	std::string ReadFile( const fs::path& path )
+	{
+		fs::ifstream in( path, std::ios::binary ) ;
+		return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() ) ;
+	}
+}
+
+BOOST_FIXTURE_TEST_SUITE( SyncTest, F )
+
+BOOST_AUTO_TEST_CASE( TestUploadAndDownload )
+{
+	WriteFile( root / "a" / "a.txt", "local a" ) ;
+	WriteFile( root / "a" / "b" / "b.txt", "local b" ) ;
+	WriteFile( root / "c.txt", "" ) ;
+
+	Sync( root / "a" ) ;
+	BOOST_CHECK_EQUAL( drive.Count(), 3u ) ;
+	BOOST_CHECK_EQUAL( Remote( "a.txt" ), "local a" ) ;
+	BOOST_CHECK_EQUAL( Remote( "b/b.txt" ), "local b" ) ;
+
+	// a new copy gets everything
+	Sync( root / "copy" ) ;
+	BOOST_CHECK_EQUAL( ReadFile( root / "copy" / "b" / "b.txt" ), "local b" ) ;
+
+	// and the first one gets the changes from the feed
+	drive.AddFile( drive.Find( "b" ), "new.txt", "remote" ) ;
+	drive.ResetStats() ;
+	Sync( root / "a" ) ;
+	BOOST_CHECK_EQUAL( ReadFile( root / "a" / "b" / "new.txt" ), "remote" ) ;
+	BOOST_CHECK_EQUAL( drive.GetStats().errors, 0u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestDeleteAndMove )
+{
+	WriteFile( root / "a" / "gone.txt", "x" ) ;
+	WriteFile( root / "a" / "moved.txt", "y" ) ;
+	fs::create_directories( root / "a" / "dir" ) ;
+	Sync( root / "a" ) ;
+	std::string moved = drive.Find( "moved.txt" ) ;
+
+	fs::remove( root / "a" / "gone.txt" ) ;
+	fs::rename( root / "a" / "moved.txt", root / "a" / "dir" / "moved.txt" ) ;
+	Sync( root / "a" ) ;
+
+	BOOST_CHECK_EQUAL( drive.Find( "gone.txt" ), "" ) ;
+	BOOST_CHECK_EQUAL( drive.Find( "dir/moved.txt" ), moved ) ;
+	BOOST_CHECK_EQUAL( drive.Count(), 2u ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestResumeWithoutRanges )
+{
+	drive.AddFile( "root", "a.txt", "remote a" ) ;
+	// left by a failed download of an older revision
+	WriteFile( root / "a" / ".a.txt.grive_part", "old" ) ;
+	drive.SetRanges( false ) ;
+
+	Sync( root / "a" ) ;
+	BOOST_CHECK_EQUAL( ReadFile( root / "a" / "a.txt" ), "remote a" ) ;
+	BOOST_CHECK( !fs::exists( root / "a" / ".a.txt.grive_part" ) ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,97 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "base/TransferPool.hh"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <thread>
+
+using namespace gr ;
+
+namespace
+{
+	struct Fixture
+	{
+	} ;
+
+	bool Work( Syncer *syncer, int n )
+	{
+		return n % 2 == 0 ;
+	}
+
+	void Count( bool result, int *ok, int *failed, std::thread::id *id )
+	{
+		*id = std::this_thread::get_id() ;
+		++*( result ? ok : failed ) ;
+	}
+
+	bool Throw( Syncer *syncer )
+	{
+		throw std::runtime_error( "transfer failed" ) ;
+	}
+
+	void Ignore( bool result )
+	{
+	}
+}
+
+BOOST_FIXTURE_TEST_SUITE( TransferPoolTest, Fixture )
+
+BOOST_AUTO_TEST_CASE( TestInline )
+{
+	TransferPool pool( (std::vector<Syncer*>()) ) ;
+	BOOST_CHECK_EQUAL( pool.Size(), 0u ) ;
+
+	int ok = 0, failed = 0 ;
+	std::thread::id id ;
+	pool.Push( 0, boost::bind( &Work, _1, 2 ), boost::bind( &Count, _1, &ok, &failed, &id ) ) ;
+
+	// completion has already run
+	BOOST_CHECK_EQUAL( ok, 1 ) ;
+	BOOST_CHECK( id == std::this_thread::get_id() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestParallel )
+{
+	TransferPool pool( std::vector<Syncer*>( 4, (Syncer*)0 ) ) ;
+	BOOST_CHECK_EQUAL( pool.Size(), 4u ) ;
+
+	int ok = 0, failed = 0 ;
+	std::thread::id id ;
+	for ( int i = 0 ; i < 100 ; i++ )
+		pool.Push( 0, boost::bind( &Work, _1, i ), boost::bind( &Count, _1, &ok, &failed, &id ) ) ;
+	pool.Finish() ;
+
+	BOOST_CHECK_EQUAL( ok, 50 ) ;
+	BOOST_CHECK_EQUAL( failed, 50 ) ;
+	BOOST_CHECK( id == std::this_thread::get_id() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestError )
+{
+	// the error is raised by whichever call runs the completions first: Push()
+	// already does if the job is fast enough
+	TransferPool pool( std::vector<Syncer*>( 2, (Syncer*)0 ) ) ;
+	BOOST_CHECK_THROW( { pool.Push( 0, &Throw, &Ignore ) ; pool.Finish() ; }, std::runtime_error ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
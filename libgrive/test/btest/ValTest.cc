@@ -19,6 +19,9 @@
 
 #include "json/Val.hh"
 #include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 
 using namespace gr ;
@@ -51,4 +54,49 @@ BOOST_AUTO_TEST_CASE( TestMap )
 	BOOST_CHECK_EQUAL( obj["key"].As<std::string>(), "value" ) ;
 }
 
+BOOST_AUTO_TEST_CASE( TestLargeObject )
+{
+	Val obj ;
+	Val& first = obj.Item( "k0500" ) ;
+	first = Val( 500 ) ;
+
+	// out of order, so blocks are split
+	for ( int i = 0 ; i < 1000 ; i++ )
+	{
+		char key[16] ;
+		std::sprintf( key, "k%04d", ( i * 337 ) % 1000 ) ;
+		obj.Add( key, Val( ( i * 337 ) % 1000 ) ) ;
+	}
+	BOOST_CHECK( obj.Del( "k0001" ) ) ;
+	BOOST_CHECK( !obj.Del( "k0001" ) ) ;
+
+	const Val::Object& members = obj.AsObject() ;
+	BOOST_CHECK_EQUAL( members.size(), 999u ) ;
+
+	// members don't move when others are added
+	BOOST_CHECK_EQUAL( &obj["k0500"], &first ) ;
+
+	std::string prev ;
+	for ( Val::Object::const_iterator i = members.begin() ; i != members.end() ; ++i )
+	{
+		BOOST_CHECK( prev < i->first ) ;
+		BOOST_CHECK_EQUAL( i->second.Int(), std::atoi( i->first.c_str() + 1 ) ) ;
+		prev = i->first ;
+	}
+}
+
+BOOST_AUTO_TEST_CASE( TestMove )
+{
+	Val str( std::string( "a string too long for the small string buffer" ) ) ;
+	Val moved( std::move( str ) ) ;
+	BOOST_CHECK_EQUAL( moved.Str(), "a string too long for the small string buffer" ) ;
+
+	Val arr( Val::array_type ) ;
+	arr.Add( std::move( moved ) ) ;
+	Val copy( arr ) ;
+	Val other( std::move( arr ) ) ;
+	BOOST_CHECK( arr.AsArray().empty() ) ;
+	BOOST_CHECK_EQUAL( other.AsArray()[0].Str(), copy.AsArray()[0].Str() ) ;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,121 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "util/Watcher.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+using namespace gr ;
+
+namespace
+{
+	struct F
+	{
+		fs::path root ;
+
+		F() : root( fs::temp_directory_path() / fs::unique_path( "grive-watch-%%%%%%%%" ) )
+		{
+			fs::create_directories( root / "a" / "b" ) ;
+			fs::create_directories( root / "a-b" ) ;
+		}
+
+		~F()
+		{
+			fs::remove_all( root ) ;
+		}
+
+		void Write( const std::string& rel )
+		{
+			std::ofstream( ( root / rel ).string().c_str() ) << "data" ;
+		}
+	} ;
+
+	bool Ignore( const std::string& path )
+	{
+		return path == ".grive_state" ;
+	}
+}
+
+BOOST_FIXTURE_TEST_SUITE( WatcherTest, F )
+
+BOOST_AUTO_TEST_CASE( TestChanges )
+{
+	Watcher subject( root, &Ignore ) ;
+	std::set<std::string> dirty ;
+
+	Write( "a/b/f" ) ;
+	Write( ".grive_state" ) ;
+	BOOST_CHECK( subject.Wait( dirty, 1000, 50 ) ) ;
+	BOOST_CHECK_EQUAL( dirty.size(), 1u ) ;
+	BOOST_CHECK_EQUAL( *dirty.begin(), "a/b" ) ;
+
+	// only ignored files changed
+	dirty.clear() ;
+	Write( ".grive_state" ) ;
+	BOOST_CHECK( !subject.Wait( dirty, 100, 50 ) ) ;
+	BOOST_CHECK( dirty.empty() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestDrain )
+{
+	Watcher subject( root, &Ignore ) ;
+	std::set<std::string> dirty ;
+	BOOST_CHECK( !subject.Drain( dirty ) ) ;
+
+	Write( "a/f" ) ;
+	BOOST_CHECK( subject.Drain( dirty ) ) ;
+	BOOST_CHECK( dirty.count( "a" ) ) ;
+
+	// nothing left to wait for
+	dirty.clear() ;
+	BOOST_CHECK( !subject.Wait( dirty, 100, 50 ) ) ;
+	BOOST_CHECK( dirty.empty() ) ;
+}
+
+BOOST_AUTO_TEST_CASE( TestNewAndMovedDirs )
+{
+	Watcher subject( root, &Ignore ) ;
+	std::set<std::string> dirty ;
+
+	fs::create_directories( root / "a" / "new" ) ;
+	BOOST_CHECK( subject.Wait( dirty, 1000, 50 ) ) ;
+	BOOST_CHECK( dirty.count( "a" ) ) ;
+
+	// the new directory is watched
+	dirty.clear() ;
+	Write( "a/new/f" ) ;
+	BOOST_CHECK( subject.Wait( dirty, 1000, 50 ) ) ;
+	BOOST_CHECK( dirty.count( "a/new" ) ) ;
+
+	// a moved directory is watched under its new name only
+	fs::rename( root / "a", root / "z" ) ;
+	BOOST_CHECK( subject.Wait( dirty, 1000, 50 ) ) ;
+	dirty.clear() ;
+	Write( "z/b/f" ) ;
+	Write( "a-b/f" ) ;
+	BOOST_CHECK( subject.Wait( dirty, 1000, 50 ) ) ;
+	BOOST_CHECK_EQUAL( dirty.size(), 2u ) ;
+	BOOST_CHECK( dirty.count( "z/b" ) ) ;
+	BOOST_CHECK( dirty.count( "a-b" ) ) ;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
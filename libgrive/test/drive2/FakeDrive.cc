@@ -0,0 +1,908 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "FakeDrive.hh"
+
+#include "drive2/Batch.hh"
+#include "drive2/CommonUri.hh"
+#include "http/Error.hh"
+#include "http/Header.hh"
+#include "json/JsonParser.hh"
+#include "json/JsonWriter.hh"
+#include "json/Val.hh"
+#include "util/Crypt.hh"
+#include "util/DataStream.hh"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/exception/all.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace gr { namespace v2 {
+
+namespace
+{
+	const std::string api			= "https://www.googleapis.com" ;
+	const std::string batch_path	= "/batch/drive/v2" ;
+	const std::string token_url		= "https://accounts.google.com/o/oauth2/token" ;
+	const std::string boundary		= "batch_fake" ;
+	const std::string json_type		= "Content-Type: application/json; charset=UTF-8\r\n" ;
+
+	// the Drive doesn't list more in one page, whatever maxResults is
+	const long max_page_size		= 1000 ;
+
+	std::string Unescape( const std::string& str )
+	{
+		std::string result ;
+		for ( std::size_t i = 0 ; i < str.size() ; i++ )
+		{
+			if ( str[i] == '%' && i + 2 < str.size() )
+			{
+				result += static_cast<char>( std::strtol( str.substr( i + 1, 2 ).c_str(), 0, 16 ) ) ;
+				i += 2 ;
+			}
+			else
+				result += str[i] == '+' ? ' ' : str[i] ;
+		}
+		return result ;
+	}
+
+	/// The unescaped value of the parameter \a name in the query of \a url.
+	std::string Param( const std::string& url, const std::string& name )
+	{
+		std::size_t query = url.find( '?' ) ;
+		if ( query == std::string::npos )
+			return "" ;
+
+		std::vector<std::string> params ;
+		boost::split( params, url.substr( query + 1 ), boost::is_any_of( "&" ) ) ;
+		for ( std::vector<std::string>::iterator i = params.begin() ; i != params.end() ; ++i )
+		{
+			if ( boost::starts_with( *i, name + "=" ) )
+				return Unescape( i->substr( name.size() + 1 ) ) ;
+		}
+		return "" ;
+	}
+
+	/// \a url with its page token replaced by \a token. It is always the last parameter.
+	std::string NextLink( const std::string& url, const std::string& token )
+	{
+		return url.substr( 0, url.find( "&pageToken=" ) ) + "&pageToken=" + token ;
+	}
+
+	std::string HeaderValue( const http::Header& hdr, const std::string& name )
+	{
+		for ( http::Header::iterator i = hdr.begin() ; i != hdr.end() ; ++i )
+		{
+			if ( boost::istarts_with( *i, name + ":" ) )
+				return boost::trim_copy( i->substr( name.size() + 1 ) ) ;
+		}
+		return "" ;
+	}
+
+	/// Splits a MIME part or an HTTP message into its headers and body.
+	void SplitHead( const std::string& msg, std::string& head, std::string& body )
+	{
+		std::size_t end = msg.find( "\r\n\r\n" ) ;
+		head = msg.substr( 0, end ) ;
+		body = end == std::string::npos ? "" : msg.substr( end + 4 ) ;
+	}
+
+	std::size_t PageSize( const std::string& url )
+	{
+		return std::min( std::max( std::atol( Param( url, "maxResults" ).c_str() ), 1l ), max_page_size ) ;
+	}
+
+	std::string Reason( long code )
+	{
+		switch ( code )
+		{
+		case 200 :	return "OK" ;
+		case 206 :	return "Partial Content" ;
+		case 308 :	return "Resume Incomplete" ;
+		case 400 :	return "Bad Request" ;
+		case 404 :	return "Not Found" ;
+		case 412 :	return "Precondition Failed" ;
+		default :	return "Error" ;
+		}
+	}
+
+	FakeDrive::Response Reply( long code, const std::string& body, const std::string& headers = json_type )
+	{
+		FakeDrive::Response resp ;
+		resp.code		= code ;
+		resp.body		= body ;
+		resp.headers	= headers ;
+		return resp ;
+	}
+
+	FakeDrive::Response Error( long code, const std::string& reason )
+	{
+		return Reply( code,
+			"{\"error\": {\"errors\": [{\"reason\": \"" + reason + "\", \"message\": \"" + Reason( code ) + "\"}], "
+			"\"code\": " + std::to_string( code ) + "}}" ) ;
+	}
+}
+
+FakeDrive::Stats::Stats() :
+	requests( 0 ),
+	bytes_in( 0 ),
+	bytes_out( 0 ),
+	errors( 0 )
+{
+}
+
+FakeDrive::Response::Response() :
+	code( 0 )
+{
+}
+
+FakeDrive::FakeDrive() :
+	m_cstamp( 0 ),
+	m_next_id( 0 ),
+	m_next_upload( 0 ),
+	m_latency( 0 ),
+	m_bandwidth( 0 ),
+	m_error_rate( 0 ),
+	m_error_code( 503 ),
+	m_ranges( true )
+{
+	Item& root = m_items["root"] ;
+	root.title		= "My Drive" ;
+	root.folder		= true ;
+	root.trashed	= false ;
+	root.version	= 1 ;
+	root.mtime		= DateTime::Now() ;
+}
+
+/// Every request takes at least \a ms milliseconds, like the round trip to the server.
+void FakeDrive::SetLatency( unsigned ms )
+{
+	m_latency = ms ;
+}
+
+/// Limits the speed of the requests and responses. 0 is unlimited.
+void FakeDrive::SetBandwidth( u64_t bytes_per_sec )
+{
+	m_bandwidth = bytes_per_sec ;
+}
+
+/// Makes requests fail with the HTTP status \a code, at the given \a rate between
+/// 0 and 1. The failures are the same from one run to the next with the same \a seed.
+void FakeDrive::SetErrors( double rate, long code, unsigned seed )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	m_error_rate	= rate ;
+	m_error_code	= code ;
+	m_random.seed( seed ) ;
+}
+
+/// With \a ranges false, Range headers are ignored and downloads answer 200 with
+/// the whole content, like some proxies do.
+void FakeDrive::SetRanges( bool ranges )
+{
+	m_ranges = ranges ;
+}
+
+/// Adds a folder to the folder \a parent, which is "root" for the root folder.
+/// Returns its ID.
+std::string FakeDrive::AddFolder( const std::string& parent, const std::string& title )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	std::string id = NewItem( parent, title, true ) ;
+	Changed( id ) ;
+	return id ;
+}
+
+std::string FakeDrive::AddFile( const std::string& parent, const std::string& title, const std::string& content )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	std::string id = NewItem( parent, title, false ) ;
+	SetContent( m_items[id], content ) ;
+	Changed( id ) ;
+	return id ;
+}
+
+/// The ID of the item at \a path, e.g. "folder/file", or an empty string.
+std::string FakeDrive::Find( const std::string& path ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+
+	std::vector<std::string> names ;
+	boost::split( names, path, boost::is_any_of( "/" ) ) ;
+
+	std::string id = "root" ;
+	for ( std::vector<std::string>::iterator n = names.begin() ; n != names.end() ; ++n )
+	{
+		std::map<std::string, std::set<std::string> >::const_iterator c = m_children.find( id ) ;
+		if ( c == m_children.end() )
+			return "" ;
+
+		id.clear() ;
+		for ( std::set<std::string>::const_iterator i = c->second.begin() ; i != c->second.end() && id.empty() ; ++i )
+		{
+			const Item& item = m_items.find( *i )->second ;
+			if ( !item.trashed && item.title == *n )
+				id = *i ;
+		}
+		if ( id.empty() )
+			return "" ;
+	}
+	return id ;
+}
+
+bool FakeDrive::Content( const std::string& id, std::string& content ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	Items::const_iterator i = m_items.find( id ) ;
+	if ( i == m_items.end() || i->second.folder )
+		return false ;
+	content = i->second.content ;
+	return true ;
+}
+
+/// The number of files and folders which are not trashed.
+std::size_t FakeDrive::Count() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	std::size_t count = 0 ;
+	for ( Items::const_iterator i = m_items.begin() ; i != m_items.end() ; ++i )
+		count += !i->second.trashed && i->first != "root" ;
+	return count ;
+}
+
+FakeDrive::Stats FakeDrive::GetStats() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	return m_stats ;
+}
+
+void FakeDrive::ResetStats()
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	m_stats = Stats() ;
+}
+
+/// Counts a request, and waits for as long as it would take over the network.
+void FakeDrive::Transfer( u64_t in, u64_t out )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex ) ;
+		m_stats.requests++ ;
+		m_stats.bytes_in	+= in ;
+		m_stats.bytes_out	+= out ;
+	}
+
+	u64_t us = m_latency * 1000ull ;
+	if ( m_bandwidth > 0 )
+		us += ( in + out ) * 1000000ull / m_bandwidth ;
+	if ( us > 0 )
+		std::this_thread::sleep_for( std::chrono::microseconds( us ) ) ;
+}
+
+/// Decides if a request is made to fail, and with which \a code.
+bool FakeDrive::Fail( long& code )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	if ( m_error_rate <= 0 || std::uniform_real_distribution<double>()( m_random ) >= m_error_rate )
+		return false ;
+
+	m_stats.errors++ ;
+	code = m_error_code ;
+	return true ;
+}
+
+FakeDrive::Response FakeDrive::Handle( const std::string& method, const std::string& url,
+	const std::string& body, const http::Header& hdr )
+{
+	std::lock_guard<std::mutex> lock( m_mutex ) ;
+	return Dispatch( method, url, body, hdr ) ;
+}
+
+FakeDrive::Response FakeDrive::Dispatch( const std::string& method, const std::string& url,
+	const std::string& body, const http::Header& hdr )
+{
+	std::string path = url.substr( 0, url.find( '?' ) ) ;
+	std::string query = path.size() < url.size() ? url.substr( path.size() + 1 ) : "" ;
+
+	if ( path == token_url && method == "POST" )
+		return Reply( 200, "{\"access_token\": \"fake\", \"token_type\": \"Bearer\", \"expires_in\": 3600}" ) ;
+	else if ( path == api + batch_path && method == "POST" )
+		return Batch( body, hdr ) ;
+	else if ( path == feeds::changes && method == "GET" )
+		return Changes( url ) ;
+	else if ( path == feeds::files )
+	{
+		if ( method == "GET" )
+			return List( url ) ;
+		else if ( method == "POST" )
+			return Create( body, "", false ) ;
+	}
+	else if ( boost::starts_with( path, feeds::files + "/" ) )
+	{
+		std::string id = path.substr( feeds::files.size() + 1 ) ;
+		if ( boost::ends_with( id, "/trash" ) && method == "POST" )
+			return Trash( id.substr( 0, id.size() - 6 ), hdr ) ;
+		else if ( method == "GET" )
+			return Param( url, "alt" ) == "media" ? Download( id, hdr ) : Metadata( id ) ;
+		else if ( method == "PUT" || method == "PATCH" )
+			return Update( id, query, body, NULL, hdr ) ;
+	}
+	else if ( path == upload_base || boost::starts_with( path, upload_base + "/" ) )
+	{
+		std::string id = path.size() > upload_base.size() ? path.substr( upload_base.size() + 1 ) : "" ;
+		std::string type = Param( url, "uploadType" ) ;
+		if ( !Param( url, "upload_id" ).empty() && method == "PUT" )
+			return ContinueUpload( Param( url, "upload_id" ), body, hdr ) ;
+		else if ( type == "multipart" )
+			return Multipart( id, body, hdr ) ;
+		else if ( type == "resumable" )
+			return StartUpload( id, body, hdr ) ;
+	}
+	return Error( 404, "notFound" ) ;
+}
+
+/// files.list, with the queries of Syncer2: all the files, only the folders, or
+/// the files in some folders. Items are listed in the order of their IDs, which
+/// is also the page token.
+FakeDrive::Response FakeDrive::List( const std::string& url )
+{
+	std::string q = Param( url, "q" ) ;
+	std::string token = Param( url, "pageToken" ) ;
+	std::size_t max = PageSize( url ) ;
+
+	bool not_trashed	= q.find( "trashed=false" ) != std::string::npos ;
+	bool only_folders	= q.find( "mimeType='" + mime_types::folder + "'" ) != std::string::npos ;
+
+	std::vector<std::string> parents ;
+	for ( std::size_t pos = q.find( "' in parents" ) ; pos != std::string::npos ; pos = q.find( "' in parents", pos + 1 ) )
+	{
+		std::size_t start = q.rfind( '\'', pos - 1 ) ;
+		parents.push_back( q.substr( start + 1, pos - start - 1 ) ) ;
+	}
+
+	// the IDs following the page token, at most one more than the page
+	std::set<std::string> ids ;
+	if ( parents.empty() )
+	{
+		for ( Items::iterator i = m_items.upper_bound( token ) ; i != m_items.end() && ids.size() <= max ; ++i )
+		{
+			if ( Listed( i->first, i->second, not_trashed, only_folders ) )
+				ids.insert( i->first ) ;
+		}
+	}
+	for ( std::vector<std::string>::iterator p = parents.begin() ; p != parents.end() ; ++p )
+	{
+		const std::set<std::string>& children = m_children[*p] ;
+		std::size_t count = 0 ;
+		for ( std::set<std::string>::const_iterator i = children.upper_bound( token ) ; i != children.end() && count <= max ; ++i )
+		{
+			if ( Listed( *i, m_items[*i], not_trashed, only_folders ) )
+			{
+				ids.insert( *i ) ;
+				count++ ;
+			}
+		}
+	}
+
+	Val::Array items ;
+	std::string last ;
+	for ( std::set<std::string>::iterator i = ids.begin() ; i != ids.end() && items.size() < max ; ++i )
+	{
+		items.push_back( Json( *i, m_items[*i] ) ) ;
+		last = *i ;
+	}
+
+	Val page ;
+	page.Add( "kind", Val( std::string( "drive#fileList" ) ) ) ;
+	if ( ids.size() > max )
+		page.Add( "nextLink", Val( NextLink( url, last ) ) ) ;
+	page.Add( "items", Val( std::move( items ) ) ) ;
+	return Reply( 200, WriteJson( page ) ) ;
+}
+
+/// changes.list. Only the latest change of each item is listed, like the Drive
+/// does. The page token is the next change ID.
+FakeDrive::Response FakeDrive::Changes( const std::string& url )
+{
+	std::string token = Param( url, "pageToken" ) ;
+	long start = std::atol( ( token.empty() ? Param( url, "startChangeId" ) : token ).c_str() ) ;
+	std::size_t max = PageSize( url ) ;
+
+	Val::Array items ;
+	std::map<long, std::string>::iterator i = m_changes.lower_bound( start ) ;
+	for ( ; i != m_changes.end() && items.size() < max ; ++i )
+	{
+		Val change ;
+		change.Add( "kind",		Val( std::string( "drive#change" ) ) ) ;
+		change.Add( "id",		Val( std::to_string( i->first ) ) ) ;
+		change.Add( "fileId",	Val( i->second ) ) ;
+		change.Add( "deleted",	Val( false ) ) ;
+		change.Add( "file",		Json( i->second, m_items[i->second] ) ) ;
+		items.push_back( change ) ;
+	}
+
+	Val page ;
+	page.Add( "kind", Val( std::string( "drive#changeList" ) ) ) ;
+	page.Add( "largestChangeId", Val( std::to_string( m_cstamp ) ) ) ;
+	if ( i != m_changes.end() )
+		page.Add( "nextLink", Val( NextLink( url, std::to_string( i->first ) ) ) ) ;
+	page.Add( "items", Val( std::move( items ) ) ) ;
+	return Reply( 200, WriteJson( page ) ) ;
+}
+
+/// Creates a file or a folder from its JSON metadata. Files are only created
+/// with their content, by an upload.
+FakeDrive::Response FakeDrive::Create( const std::string& meta, const std::string& content, bool has_content )
+{
+	Val val = ParseJson( meta ) ;
+
+	std::string parent = "root" ;
+	Val parents ;
+	if ( val.Get( "parents", parents ) && !parents.AsArray().empty() )
+		parent = parents.AsArray().front()["id"].Str() ;
+
+	Items::iterator p = m_items.find( parent ) ;
+	if ( p == m_items.end() || !p->second.folder )
+		return Error( 404, "notFound" ) ;
+
+	Val type ;
+	bool folder = val.Get( "mimeType", type ) && type.Str() == mime_types::folder ;
+	std::string id = NewItem( parent, val["title"].Str(), folder ) ;
+	if ( has_content )
+		SetContent( m_items[id], content ) ;
+	Changed( id ) ;
+	return Metadata( id ) ;
+}
+
+/// Updates the metadata and the content of \a id. The parents are changed with
+/// the addParents and removeParents parameters in \a query.
+FakeDrive::Response FakeDrive::Update( const std::string& id, const std::string& query,
+	const std::string& meta, const std::string *content, const http::Header& hdr )
+{
+	Items::iterator i = m_items.find( id ) ;
+	if ( i == m_items.end() || id == "root" )
+		return Error( 404, "notFound" ) ;
+	Item& item = i->second ;
+	if ( !Matches( item, hdr ) )
+		return Error( 412, "conditionNotMet" ) ;
+
+	if ( !meta.empty() )
+	{
+		Val val = ParseJson( meta ) ;
+		Val title ;
+		if ( val.Get( "title", title ) )
+			item.title = title.Str() ;
+	}
+
+	std::string url = "?" + query ;
+	std::vector<std::string> ids ;
+	std::string remove = Param( url, "removeParents" ) ;
+	if ( !remove.empty() )
+	{
+		boost::split( ids, remove, boost::is_any_of( "," ) ) ;
+		for ( std::vector<std::string>::iterator p = ids.begin() ; p != ids.end() ; ++p )
+		{
+			item.parents.erase( std::remove( item.parents.begin(), item.parents.end(), *p ), item.parents.end() ) ;
+			m_children[*p].erase( id ) ;
+		}
+	}
+	std::string add = Param( url, "addParents" ) ;
+	if ( !add.empty() )
+	{
+		boost::split( ids, add, boost::is_any_of( "," ) ) ;
+		for ( std::vector<std::string>::iterator p = ids.begin() ; p != ids.end() ; ++p )
+		{
+			item.parents.push_back( *p ) ;
+			m_children[*p].insert( id ) ;
+		}
+	}
+
+	if ( content )
+		SetContent( item, *content ) ;
+	item.version++ ;
+	if ( Param( url, "modifiedDateBehavior" ) != "noChange" )
+		item.mtime = DateTime::Now() ;
+	Changed( id ) ;
+	return Metadata( id ) ;
+}
+
+/// Trashes \a id, and everything in it if it is a folder.
+FakeDrive::Response FakeDrive::Trash( const std::string& id, const http::Header& hdr )
+{
+	Items::iterator i = m_items.find( id ) ;
+	if ( i == m_items.end() || id == "root" )
+		return Error( 404, "notFound" ) ;
+	if ( !Matches( i->second, hdr ) )
+		return Error( 412, "conditionNotMet" ) ;
+
+	std::vector<std::string> stack( 1, id ) ;
+	while ( !stack.empty() )
+	{
+		std::string cur = stack.back() ;
+		stack.pop_back() ;
+
+		Item& item = m_items[cur] ;
+		if ( item.trashed )
+			continue ;
+		item.trashed = true ;
+		item.version++ ;
+		Changed( cur ) ;
+
+		const std::set<std::string>& children = m_children[cur] ;
+		stack.insert( stack.end(), children.begin(), children.end() ) ;
+	}
+	return Metadata( id ) ;
+}
+
+/// The content of \a id, or the part of it in the Range header.
+FakeDrive::Response FakeDrive::Download( const std::string& id, const http::Header& hdr )
+{
+	Items::iterator i = m_items.find( id ) ;
+	if ( i == m_items.end() || i->second.folder )
+		return Error( 404, "notFound" ) ;
+	const std::string& content = i->second.content ;
+
+	std::string range = HeaderValue( hdr, "Range" ) ;
+	if ( !m_ranges || !boost::starts_with( range, "bytes=" ) )
+		return Reply( 200, content, "Content-Type: application/octet-stream\r\n" ) ;
+
+	u64_t begin = std::strtoull( range.c_str() + 6, 0, 10 ) ;
+	std::size_t dash = range.find( '-' ) ;
+	u64_t end = dash + 1 < range.size() ? std::strtoull( range.c_str() + dash + 1, 0, 10 ) + 1 : content.size() ;
+	end = std::min<u64_t>( end, content.size() ) ;
+	if ( begin >= end )
+		return Error( 416, "requestedRangeNotSatisfiable" ) ;
+
+	return Reply( 206, content.substr( begin, end - begin ),
+		"Content-Type: application/octet-stream\r\n"
+		"Content-Range: bytes " + std::to_string( begin ) + "-" + std::to_string( end - 1 ) + "/" +
+			std::to_string( content.size() ) + "\r\n" ) ;
+}
+
+/// An upload of the metadata and the content of a file in one multipart/related
+/// request. \a id is empty for new files.
+FakeDrive::Response FakeDrive::Multipart( const std::string& id, const std::string& body, const http::Header& hdr )
+{
+	std::string delim = "--" + v2::Batch::Boundary( HeaderValue( hdr, "Content-Type" ) ) ;
+
+	std::size_t meta_head	= body.find( "\r\n\r\n", body.find( delim ) ) ;
+	std::size_t meta_end	= body.find( "\r\n" + delim, meta_head ) ;
+	std::size_t data_head	= body.find( "\r\n\r\n", meta_end + 2 ) ;
+	std::size_t data_end	= body.rfind( "\r\n" + delim + "--" ) ;
+	if ( delim == "--" || meta_head == std::string::npos || meta_end == std::string::npos ||
+		data_head == std::string::npos || data_end == std::string::npos || data_end < data_head + 4 )
+		return Error( 400, "badContent" ) ;
+
+	std::string meta	= body.substr( meta_head + 4, meta_end - meta_head - 4 ) ;
+	std::string content	= body.substr( data_head + 4, data_end - data_head - 4 ) ;
+	return id.empty() ? Create( meta, content, true ) : Update( id, "", meta, &content, hdr ) ;
+}
+
+/// Starts a resumable upload. The URI of the session is in the Location header.
+FakeDrive::Response FakeDrive::StartUpload( const std::string& id, const std::string& meta, const http::Header& hdr )
+{
+	if ( !id.empty() )
+	{
+		Items::iterator i = m_items.find( id ) ;
+		if ( i == m_items.end() )
+			return Error( 404, "notFound" ) ;
+		if ( !Matches( i->second, hdr ) )
+			return Error( 412, "conditionNotMet" ) ;
+	}
+
+	std::string session = std::to_string( ++m_next_upload ) ;
+	Upload& up = m_uploads[session] ;
+	up.id	= id ;
+	up.meta	= meta ;
+	up.size	= std::strtoull( HeaderValue( hdr, "X-Upload-Content-Length" ).c_str(), 0, 10 ) ;
+
+	return Reply( 200, "", "Location: " + upload_base + ( id.empty() ? "" : "/" + id ) +
+		"?uploadType=resumable&upload_id=" + session + "\r\n" ) ;
+}
+
+/// A chunk of a resumable upload, or the query of how much of it was received,
+/// depending on its Content-Range.
+FakeDrive::Response FakeDrive::ContinueUpload( const std::string& session, const std::string& body, const http::Header& hdr )
+{
+	std::map<std::string, Upload>::iterator s = m_uploads.find( session ) ;
+	if ( s == m_uploads.end() )
+		return Error( 404, "notFound" ) ;
+	Upload& up = s->second ;
+
+	std::string range = HeaderValue( hdr, "Content-Range" ) ;
+	if ( up.result.empty() && !boost::starts_with( range, "bytes */" ) )
+	{
+		// a chunk overlapping what we have replaces the end of it
+		u64_t begin = std::strtoull( range.c_str() + 6, 0, 10 ) ;
+		if ( begin > up.received.size() )
+			return Error( 400, "badContentRange" ) ;
+		up.received.resize( begin ) ;
+		up.received += body ;
+
+		if ( up.received.size() >= up.size )
+		{
+			Response resp = up.id.empty() ?
+				Create( up.meta, up.received, true ) :
+				Update( up.id, "", up.meta, &up.received, hdr ) ;
+			up.result = resp.body ;
+			up.received.clear() ;
+			return resp ;
+		}
+	}
+
+	if ( !up.result.empty() )
+		return Reply( 200, up.result ) ;
+	return Reply( 308, "", up.received.empty() ? "" :
+		"Range: bytes=0-" + std::to_string( up.received.size() - 1 ) + "\r\n" ) ;
+}
+
+/// Runs the requests of a multipart/mixed batch, and answers them in one
+/// multipart/mixed response.
+FakeDrive::Response FakeDrive::Batch( const std::string& body, const http::Header& hdr )
+{
+	std::string delim = "--" + v2::Batch::Boundary( HeaderValue( hdr, "Content-Type" ) ) ;
+	if ( delim == "--" )
+		return Error( 400, "badContent" ) ;
+
+	std::string result ;
+	std::size_t pos = body.find( delim ) ;
+	while ( pos != std::string::npos && body.compare( pos + delim.size(), 2, "--" ) != 0 )
+	{
+		pos += delim.size() ;
+		std::size_t next = body.find( delim, pos ) ;
+		std::string part = body.substr( pos, next == std::string::npos ? std::string::npos : next - pos ) ;
+		pos = next ;
+
+		std::string part_head, msg, head, content ;
+		SplitHead( boost::trim_left_copy( part ), part_head, msg ) ;
+		SplitHead( msg, head, content ) ;
+		if ( boost::ends_with( content, "\r\n" ) )
+			content.erase( content.size() - 2 ) ;
+
+		// the request line, then its headers
+		std::vector<std::string> lines ;
+		boost::split( lines, head, boost::is_any_of( "\n" ) ) ;
+		std::vector<std::string> request ;
+		boost::split( request, boost::trim_copy( lines[0] ), boost::is_any_of( " " ) ) ;
+		http::Header sub ;
+		for ( std::size_t i = 1 ; i < lines.size() ; i++ )
+			sub.Add( boost::trim_copy( lines[i] ) ) ;
+
+		Response resp = request.size() < 2 ?
+			Error( 400, "badRequest" ) :
+			Dispatch( request[0], api + request[1], content, sub ) ;
+
+		std::string id = boost::trim_copy_if( http::FindHeader( part_head, "Content-ID" ), boost::is_any_of( "<>" ) ) ;
+		result += "--" + boundary + "\r\n"
+			"Content-Type: application/http\r\n"
+			"Content-ID: <response-" + id + ">\r\n\r\n"
+			"HTTP/1.1 " + std::to_string( resp.code ) + " " + Reason( resp.code ) + "\r\n" +
+			resp.headers + "\r\n" + resp.body + "\r\n" ;
+	}
+	result += "--" + boundary + "--\r\n" ;
+
+	return Reply( 200, result, "Content-Type: multipart/mixed; boundary=" + boundary + "\r\n" ) ;
+}
+
+std::string FakeDrive::NewItem( const std::string& parent, const std::string& title, bool folder )
+{
+	// zero-padded, so that the IDs are sorted in the order of creation
+	char id[32] ;
+	std::snprintf( id, sizeof(id), "fake%012lu", ++m_next_id ) ;
+
+	Item& item = m_items[id] ;
+	item.title		= title ;
+	item.folder		= folder ;
+	item.trashed	= false ;
+	item.parents.push_back( parent ) ;
+	item.version	= 1 ;
+	item.mtime		= DateTime::Now() ;
+	m_children[parent].insert( id ) ;
+	return id ;
+}
+
+void FakeDrive::SetContent( Item& item, const std::string& content )
+{
+	crypt::MD5 md5 ;
+	md5.Write( content.data(), content.size() ) ;
+	item.content	= content ;
+	item.md5		= md5.Get() ;
+}
+
+void FakeDrive::Changed( const std::string& id )
+{
+	std::map<std::string, long>::iterator c = m_change_of.find( id ) ;
+	if ( c != m_change_of.end() )
+		m_changes.erase( c->second ) ;
+	m_change_of[id] = ++m_cstamp ;
+	m_changes[m_cstamp] = id ;
+}
+
+/// Checks if \a item is in a listing with the filters of its query.
+bool FakeDrive::Listed( const std::string& id, const Item& item, bool not_trashed, bool only_folders )
+{
+	return id != "root" && !( not_trashed && item.trashed ) && !( only_folders && !item.folder ) ;
+}
+
+/// Checks the If-Match header of a request, if it has one.
+bool FakeDrive::Matches( const Item& item, const http::Header& hdr ) const
+{
+	std::string etag = HeaderValue( hdr, "If-Match" ) ;
+	return etag.empty() || etag == "\"" + std::to_string( item.version ) + "\"" ;
+}
+
+/// The file resource of \a item, with the fields Entry2 reads.
+Val FakeDrive::Json( const std::string& id, const Item& item ) const
+{
+	Val::Array parents ;
+	for ( std::vector<std::string>::const_iterator p = item.parents.begin() ; p != item.parents.end() ; ++p )
+	{
+		Val parent ;
+		parent.Add( "id",			Val( *p ) ) ;
+		parent.Add( "isRoot",		Val( *p == "root" ) ) ;
+		parent.Add( "parentLink",	Val( feeds::files + "/" + *p ) ) ;
+		parents.push_back( parent ) ;
+	}
+
+	Val labels ;
+	labels.Add( "trashed", Val( item.trashed ) ) ;
+
+	Val file ;
+	file.Add( "kind",			Val( std::string( "drive#file" ) ) ) ;
+	file.Add( "id",				Val( id ) ) ;
+	file.Add( "etag",			Val( "\"" + std::to_string( item.version ) + "\"" ) ) ;
+	file.Add( "selfLink",		Val( feeds::files + "/" + id ) ) ;
+	file.Add( "title",			Val( item.title ) ) ;
+	file.Add( "mimeType",		Val( item.folder ? mime_types::folder : std::string( "application/octet-stream" ) ) ) ;
+	file.Add( "editable",		Val( true ) ) ;
+	file.Add( "labels",			labels ) ;
+	file.Add( "modifiedDate",	Val( item.mtime.ToString() ) ) ;
+	file.Add( "parents",		Val( std::move( parents ) ) ) ;
+	if ( !item.folder )
+	{
+		file.Add( "md5Checksum",	Val( item.md5 ) ) ;
+		file.Add( "fileSize",		Val( std::to_string( item.content.size() ) ) ) ;
+		file.Add( "downloadUrl",	Val( feeds::files + "/" + id + "?alt=media&v=" + std::to_string( item.version ) ) ) ;
+	}
+	return file ;
+}
+
+FakeDrive::Response FakeDrive::Metadata( const std::string& id ) const
+{
+	Items::const_iterator i = m_items.find( id ) ;
+	if ( i == m_items.end() )
+		return Error( 404, "notFound" ) ;
+	return Reply( 200, WriteJson( Json( id, i->second ) ) ) ;
+}
+
+FakeDriveAgent::FakeDriveAgent( FakeDrive *drive, bool throw_errors ) :
+	m_drive( drive ),
+	m_throw( throw_errors )
+{
+}
+
+http::ResponseLog* FakeDriveAgent::GetLog() const
+{
+	return 0 ;
+}
+
+void FakeDriveAgent::SetLog( http::ResponseLog* )
+{
+}
+
+void FakeDriveAgent::SetProgressReporter( Progress* )
+{
+}
+
+long FakeDriveAgent::Request(
+	const std::string&	method,
+	const std::string&	url,
+	SeekStream			*in,
+	DataStream			*dest,
+	const http::Header&	hdr,
+	u64_t )
+{
+	std::string body ;
+	char buf[65536] ;
+	std::size_t count ;
+	while ( in && ( count = in->Read( buf, sizeof(buf) ) ) > 0 )
+		body.append( buf, count ) ;
+
+	long code ;
+	FakeDrive::Response resp ;
+	if ( m_drive->Fail( code ) )
+		resp = Error( code, code == 403 ? "rateLimitExceeded" : "backendError" ) ;
+	else
+		resp = m_drive->Handle( method, url, body, hdr ) ;
+	m_drive->Transfer( body.size(), resp.body.size() ) ;
+
+	m_headers = resp.headers ;
+	m_error.clear() ;
+	if ( resp.code < 400 )
+	{
+		// an ignored range is not written, as the curl agents do
+		bool range_ignored = resp.code == 200 && !HeaderValue( hdr, "Range" ).empty() ;
+		if ( dest && !resp.body.empty() && !range_ignored )
+			dest->Write( resp.body.data(), resp.body.size() ) ;
+		return resp.code ;
+	}
+
+	m_error = resp.body ;
+	if ( m_throw )
+	{
+		BOOST_THROW_EXCEPTION(
+			http::Error()
+				<< http::HttpResponseCode( resp.code )
+				<< http::HttpResponseHeaders( resp.headers )
+				<< http::HttpResponseText( resp.body )
+				<< http::Url( url )
+				<< http::HttpRequestHeaders( hdr ) ) ;
+	}
+	return resp.code ;
+}
+
+std::string FakeDriveAgent::LastError() const
+{
+	return m_error ;
+}
+
+std::string FakeDriveAgent::LastErrorHeaders() const
+{
+	return m_error.empty() ? "" : m_headers ;
+}
+
+std::string FakeDriveAgent::RedirLocation() const
+{
+	return "" ;
+}
+
+std::string FakeDriveAgent::ResponseHeader( const std::string& name ) const
+{
+	return http::FindHeader( m_headers, name ) ;
+}
+
+std::string FakeDriveAgent::Escape( const std::string& str )
+{
+	std::string result ;
+	char hex[4] ;
+	for ( std::string::const_iterator i = str.begin() ; i != str.end() ; ++i )
+	{
+		if ( std::isalnum( static_cast<unsigned char>( *i ) ) || *i == '-' || *i == '_' || *i == '.' || *i == '~' )
+			result += *i ;
+		else
+		{
+			std::snprintf( hex, sizeof(hex), "%%%02X", static_cast<unsigned char>( *i ) ) ;
+			result += hex ;
+		}
+	}
+	return result ;
+}
+
+std::string FakeDriveAgent::Unescape( const std::string& str )
+{
+	return v2::Unescape( str ) ;
+}
+
+} } // end of namespace gr::v2
@@ -0,0 +1,213 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "http/Agent.hh"
+#include "util/DateTime.hh"
+#include "util/Types.hh"
+
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gr {
+
+class Val ;
+
+namespace http
+{
+	class Header ;
+}
+
+namespace v2 {
+
+/*!	\brief	An in-memory Drive, answering the requests of Syncer2 and Feed2
+
+	It understands the parts of the Drive v2 REST API grive uses: file listings
+	with the queries of Syncer2, the changes feed, metadata updates, trash,
+	multipart and resumable uploads, downloads with ranges, batches and the
+	refresh of the auth token. Files are kept in memory, so the trees it holds
+	should have small files.
+
+	Requests are answered through FakeDriveAgent, which can add latency, limit
+	the bandwidth and make some of the requests fail. Several agents may use the
+	same FakeDrive at the same time.
+*/
+class FakeDrive
+{
+public :
+	/// what the agents have sent and received
+	struct Stats
+	{
+		Stats() ;
+
+		u64_t	requests ;
+		u64_t	bytes_in ;
+		u64_t	bytes_out ;
+		u64_t	errors ;
+	} ;
+
+	struct Response
+	{
+		Response() ;
+
+		long		code ;
+		std::string	headers ;
+		std::string	body ;
+	} ;
+
+public :
+	FakeDrive() ;
+
+	void SetLatency( unsigned ms ) ;
+	void SetBandwidth( u64_t bytes_per_sec ) ;
+	void SetErrors( double rate, long code = 503, unsigned seed = 1 ) ;
+	void SetRanges( bool ranges ) ;
+
+	std::string AddFolder( const std::string& parent, const std::string& title ) ;
+	std::string AddFile( const std::string& parent, const std::string& title, const std::string& content ) ;
+	std::string Find( const std::string& path ) const ;
+	bool Content( const std::string& id, std::string& content ) const ;
+	std::size_t Count() const ;
+
+	Stats GetStats() const ;
+	void ResetStats() ;
+
+	Response Handle( const std::string& method, const std::string& url,
+		const std::string& body, const http::Header& hdr ) ;
+
+	// called by FakeDriveAgent
+	void Transfer( u64_t in, u64_t out ) ;
+	bool Fail( long& code ) ;
+
+private :
+	struct Item
+	{
+		std::string					title ;
+		bool						folder ;
+		bool						trashed ;
+		std::vector<std::string>	parents ;
+		std::string					content ;
+		std::string					md5 ;
+		long						version ;
+		DateTime					mtime ;
+	} ;
+
+	struct Upload
+	{
+		std::string	id ;
+		std::string	meta ;
+		u64_t		size ;
+		std::string	received ;
+		std::string	result ;
+	} ;
+
+	typedef std::map<std::string, Item> Items ;
+
+private :
+	Response Dispatch( const std::string& method, const std::string& url,
+		const std::string& body, const http::Header& hdr ) ;
+	Response List( const std::string& url ) ;
+	Response Changes( const std::string& url ) ;
+	Response Create( const std::string& meta, const std::string& content, bool has_content ) ;
+	Response Update( const std::string& id, const std::string& query,
+		const std::string& meta, const std::string *content, const http::Header& hdr ) ;
+	Response Trash( const std::string& id, const http::Header& hdr ) ;
+	Response Download( const std::string& id, const http::Header& hdr ) ;
+	Response Multipart( const std::string& id, const std::string& body, const http::Header& hdr ) ;
+	Response StartUpload( const std::string& id, const std::string& meta, const http::Header& hdr ) ;
+	Response ContinueUpload( const std::string& session, const std::string& body, const http::Header& hdr ) ;
+	Response Batch( const std::string& body, const http::Header& hdr ) ;
+
+	std::string NewItem( const std::string& parent, const std::string& title, bool folder ) ;
+	void SetContent( Item& item, const std::string& content ) ;
+	void Changed( const std::string& id ) ;
+	bool Matches( const Item& item, const http::Header& hdr ) const ;
+	static bool Listed( const std::string& id, const Item& item, bool not_trashed, bool only_folders ) ;
+	Val Json( const std::string& id, const Item& item ) const ;
+	Response Metadata( const std::string& id ) const ;
+
+private :
+	mutable std::mutex					m_mutex ;
+
+	Items								m_items ;
+	/// the IDs of the children of each folder, including the trashed ones
+	std::map<std::string, std::set<std::string> >	m_children ;
+	/// the latest change of each item, and the item of each change
+	std::map<std::string, long>			m_change_of ;
+	std::map<long, std::string>			m_changes ;
+	long								m_cstamp ;
+	unsigned long						m_next_id ;
+
+	std::map<std::string, Upload>		m_uploads ;
+	unsigned long						m_next_upload ;
+
+	unsigned							m_latency ;
+	u64_t								m_bandwidth ;
+	double								m_error_rate ;
+	long								m_error_code ;
+	bool								m_ranges ;
+	std::mt19937						m_random ;
+
+	Stats								m_stats ;
+} ;
+
+/*!	\brief	A connection to a FakeDrive
+
+	HTTP errors are thrown as http::Error, like AuthAgent does, so that this
+	agent can be used by Syncer2 directly. Put it behind an AuthAgent instead to
+	have temporary errors retried.
+*/
+class FakeDriveAgent : public http::Agent
+{
+public :
+	explicit FakeDriveAgent( FakeDrive *drive, bool throw_errors = true ) ;
+
+	http::ResponseLog* GetLog() const ;
+	void SetLog( http::ResponseLog* ) ;
+	void SetProgressReporter( Progress* ) ;
+
+	long Request(
+		const std::string&	method,
+		const std::string&	url,
+		SeekStream			*in,
+		DataStream			*dest,
+		const http::Header&	hdr,
+		u64_t				downloadFileBytes = 0 ) ;
+
+	std::string LastError() const ;
+	std::string LastErrorHeaders() const ;
+	std::string RedirLocation() const ;
+	std::string ResponseHeader( const std::string& name ) const ;
+
+	std::string Escape( const std::string& str ) ;
+	std::string Unescape( const std::string& str ) ;
+
+private :
+	FakeDrive	*m_drive ;
+	bool		m_throw ;
+	std::string	m_headers ;
+	std::string	m_error ;
+} ;
+
+} } // end of namespace gr::v2
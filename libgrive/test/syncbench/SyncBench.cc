@@ -0,0 +1,207 @@
+/*
+	grive: an GPL program to sync a local directory with Google Drive
+	Copyright (C) 2012  Wan Wai Ho
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation version 2
+	of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+
+// measures whole syncs of a synthetic tree against FakeDrive, through the same
+// AuthAgent and Syncer2 as grive:
+//
+//	grive-sync-bench [files] [flat|deep] [latency ms] [bandwidth KB/s] [error rate] [jobs]
+//
+// "flat" puts all the files in one folder. "deep" puts 10 of them in each folder,
+// with two subfolders each, so 1M files are 17 levels deep. Each phase is a new
+// run of grive:
+//
+//	upload		the tree is uploaded to an empty drive
+//	noop		nothing changed since the upload
+//	download	the tree is downloaded into an empty folder
+//	changes		1% more files are added remotely, and downloaded from the feed
+//
+// peak_rss_kb is the peak of the process so far, including the files FakeDrive
+// keeps in memory.
+
+#include "drive2/FakeDrive.hh"
+
+#include "base/Drive.hh"
+#include "drive2/Syncer2.hh"
+#include "json/Val.hh"
+#include "protocol/AuthAgent.hh"
+#include "protocol/OAuth2.hh"
+#include "util/File.hh"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace gr ;
+
+namespace
+{
+	const std::size_t files_per_folder	= 10 ;
+	const std::size_t file_size			= 100 ;
+
+	std::string Content( std::size_t i )
+	{
+		std::string content = "file " + std::to_string( i ) + "\n" ;
+		content.resize( file_size, '.' ) ;
+		return content ;
+	}
+
+	std::string Name( std::size_t i )
+	{
+		char name[32] ;
+		std::snprintf( name, sizeof(name), "file%07lu.txt", static_cast<unsigned long>( i ) ) ;
+		return name ;
+	}
+
+	void WriteFile( const fs::path& path, const std::string& content )
+	{
+		File file( path, 0644 ) ;
+		file.Write( content.data(), content.size() ) ;
+	}
+
+	/// Creates \a count files under \a root, as described at the top.
+	void MakeTree( const fs::path& root, std::size_t count, bool deep )
+	{
+		fs::create_directories( root ) ;
+		if ( !deep )
+		{
+			for ( std::size_t i = 0 ; i < count ; i++ )
+				WriteFile( root / Name( i ), Content( i ) ) ;
+			return ;
+		}
+
+		// breadth first, so the tree is balanced
+		std::vector<fs::path> folders( 1, root ) ;
+		for ( std::size_t f = 0, i = 0 ; i < count ; f++ )
+		{
+			for ( std::size_t j = 0 ; j < files_per_folder && i < count ; j++, i++ )
+				WriteFile( folders[f] / Name( i ), Content( i ) ) ;
+			for ( int k = 0 ; k < 2 && i < count ; k++ )
+			{
+				folders.push_back( folders[f] / ( "dir" + std::to_string( k ) ) ) ;
+				fs::create_directory( folders.back() ) ;
+			}
+		}
+	}
+
+	/// grive with \a jobs transfers in parallel, each with its own connection
+	struct Client
+	{
+		Client( v2::FakeDrive *drive, unsigned jobs ) :
+			http( drive, false ),
+			token_http( drive, false ),
+			token( &token_http, "refresh", "id", "secret" ),
+			agent( token, &http ),
+			syncer( &agent )
+		{
+			for ( unsigned i = 0 ; jobs > 1 && i < jobs ; i++ )
+			{
+				worker_http.push_back( std::shared_ptr<http::Agent>( new v2::FakeDriveAgent( drive, false ) ) ) ;
+				worker_http.push_back( std::shared_ptr<http::Agent>( new AuthAgent( token, worker_http.back().get() ) ) ) ;
+				worker_syncers.push_back( std::shared_ptr<Syncer>( new v2::Syncer2( worker_http.back().get() ) ) ) ;
+				workers.push_back( worker_syncers.back().get() ) ;
+			}
+		}
+
+		v2::FakeDriveAgent	http ;
+		v2::FakeDriveAgent	token_http ;
+		OAuth2				token ;
+		AuthAgent			agent ;
+		v2::Syncer2			syncer ;
+
+		std::vector< std::shared_ptr<http::Agent> >	worker_http ;
+		std::vector< std::shared_ptr<Syncer> >		worker_syncers ;
+		std::vector<Syncer*>						workers ;
+	} ;
+
+	void Run( const char *name, Client& client, v2::FakeDrive& drive, const fs::path& root )
+	{
+		Val options ;
+		options.Add( "path",				Val( root.string() ) ) ;
+		options.Add( "new-rev",				Val( false ) ) ;
+		options.Add( "no-remote-new",		Val( false ) ) ;
+		options.Add( "upload-only",			Val( false ) ) ;
+		options.Add( "no-delete-remote",	Val( false ) ) ;
+
+		drive.ResetStats() ;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now() ;
+		{
+			Drive d( &client.syncer, options, client.workers ) ;
+			d.DetectChanges() ;
+			d.Update() ;
+			d.SaveState() ;
+		}
+		double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() ;
+
+		struct rusage usage ;
+		::getrusage( RUSAGE_SELF, &usage ) ;
+
+		v2::FakeDrive::Stats stats = drive.GetStats() ;
+		std::cout << name
+			<< "\tseconds=" << secs
+			<< "\trequests=" << stats.requests
+			<< "\tsent=" << stats.bytes_in
+			<< "\treceived=" << stats.bytes_out
+			<< "\terrors=" << stats.errors
+			<< "\tpeak_rss_kb=" << usage.ru_maxrss
+			<< std::endl ;
+	}
+}
+
+int main( int argc, char **argv )
+{
+	std::size_t count	= argc > 1 ? std::atol( argv[1] ) : 1000 ;
+	bool deep			= argc > 2 && std::string( argv[2] ) == "deep" ;
+	unsigned latency	= argc > 3 ? std::atoi( argv[3] ) : 0 ;
+	u64_t bandwidth		= argc > 4 ? std::atol( argv[4] ) * 1000ull : 0 ;
+	double error_rate	= argc > 5 ? std::atof( argv[5] ) : 0 ;
+	unsigned jobs		= argc > 6 ? std::max( std::atoi( argv[6] ), 1 ) : 1 ;
+
+	std::cout << "files=" << count << "\tshape=" << ( deep ? "deep" : "flat" )
+		<< "\tlatency_ms=" << latency << "\tbandwidth=" << bandwidth
+		<< "\terror_rate=" << error_rate << "\tjobs=" << jobs << std::endl ;
+
+	fs::path tmp = fs::temp_directory_path() / fs::unique_path( "grive-sync-bench-%%%%%%%%" ) ;
+	MakeTree( tmp / "up", count, deep ) ;
+
+	v2::FakeDrive drive ;
+	drive.SetLatency( latency ) ;
+	drive.SetBandwidth( bandwidth ) ;
+	drive.SetErrors( error_rate ) ;
+	Client client( &drive, jobs ) ;
+
+	Run( "upload", client, drive, tmp / "up" ) ;
+	Run( "noop", client, drive, tmp / "up" ) ;
+
+	fs::create_directories( tmp / "down" ) ;
+	Run( "download", client, drive, tmp / "down" ) ;
+
+	for ( std::size_t i = 0 ; i < ( count + 99 ) / 100 ; i++ )
+		drive.AddFile( "root", "new-" + Name( i ), Content( i ) ) ;
+	Run( "changes", client, drive, tmp / "down" ) ;
+
+	fs::remove_all( tmp ) ;
+	return 0 ;
+}